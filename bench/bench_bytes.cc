@@ -0,0 +1,142 @@
+// Micro benchmark of ByteData construction cost on the map output path.
+// This compares ByteData with a reference using std::vector<char> storage,
+// which is the layout used before small buffer optimization was introduced.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_utils.h"
+
+#include "simplemapreduce/data/batch.h"
+#include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/queue.h"
+#include "simplemapreduce/data/type.h"
+
+using namespace mapreduce::data;
+using namespace mapreduce::type;
+
+/// Reference implementation holding data in std::vector<char>
+struct VectorByteData {
+  explicit VectorByteData(Long value) {
+    char* buff = reinterpret_cast<char*>(&value);
+    data = std::vector<char>(buff, buff + sizeof(Long));
+  }
+  explicit VectorByteData(String&& value) : data(value.begin(), value.end()) {}
+
+  std::vector<char> data;
+};
+
+/** Create words emitted by word count mapper. */
+std::vector<String> make_words(size_t n) {
+  const std::vector<String> vocab{"the", "mapreduce", "a", "cluster", "and", "shuffle", "of", "reducer"};
+  std::vector<String> words;
+  words.reserve(n);
+  for (size_t i = 0; i < n; ++i)
+    words.emplace_back(vocab[i % vocab.size()].c_str());
+  return words;
+}
+
+int main() {
+  constexpr size_t n_records = 1000000;
+
+  std::printf("records: %zu, inline capacity: %zu bytes\n\n", n_records, ByteBuffer::kInlineCapacity);
+
+  {
+    bench::Timer timer;
+    for (size_t i = 0; i < n_records; ++i) {
+      VectorByteData value{Long(i)};
+      bench::do_not_optimize(value.data.data());
+    }
+    timer.report("vector<char>: Long", n_records);
+  }
+
+  {
+    bench::Timer timer;
+    for (size_t i = 0; i < n_records; ++i) {
+      ByteData value{Long(i)};
+      bench::do_not_optimize(value.get_byte());
+    }
+    timer.report("ByteData: Long", n_records);
+  }
+
+  {
+    auto words = make_words(n_records);
+    bench::Timer timer;
+    for (auto& word: words) {
+      VectorByteData key{std::move(word)};
+      bench::do_not_optimize(key.data.data());
+    }
+    timer.report("vector<char>: String", n_records);
+  }
+
+  {
+    auto words = make_words(n_records);
+    bench::Timer timer;
+    for (auto& word: words) {
+      ByteData key{std::move(word)};
+      bench::do_not_optimize(key.get_byte());
+    }
+    timer.report("ByteData: String", n_records);
+  }
+
+  {
+    /// Map output path: Context::write -> MessageQueue -> Shuffle
+    auto words = make_words(n_records);
+    MessageQueue mq;
+    bench::Timer timer;
+    for (auto& word: words)
+      mq.send(ByteData{std::move(word)}, ByteData{Long(1)});
+    mq.end();
+
+    for (auto data = mq.receive(); !data.first.empty(); data = mq.receive())
+      bench::do_not_optimize(data.second.get_byte());
+    timer.report("MessageQueue: String/Long", n_records);
+  }
+
+  {
+    /// Same path with records packed into RecordBatch as MQWriter does
+    auto words = make_words(n_records);
+    MessageQueue mq;
+    bench::Timer timer;
+    RecordBatch batch;
+    for (auto& word: words) {
+      batch.append(ByteData{std::move(word)}, ByteData{Long(1)});
+      if (batch.bytes() >= RecordBatch::kDefaultCapacity) {
+        mq.send_batch(std::move(batch));
+        batch = RecordBatch();
+      }
+    }
+    mq.send_batch(std::move(batch));
+    mq.end();
+
+    for (auto data = mq.receive_batch(); !data.empty(); data = mq.receive_batch())
+      for (size_t i = 0; i < data.size(); ++i)
+        bench::do_not_optimize(data.value(i).data());
+    timer.report("MessageQueue batch: String/Long", n_records);
+  }
+
+  {
+    /// Same path without encoding as TypedMQWriter does
+    auto words = make_words(n_records);
+    MessageQueue mq;
+    bench::Timer timer;
+    RecordBatch batch;
+    for (auto& word: words) {
+      batch.emplace_back(std::move(word), Long(1));
+      if (batch.bytes() >= RecordBatch::kDefaultCapacity) {
+        mq.send_batch(std::move(batch));
+        batch = RecordBatch();
+      }
+    }
+    mq.send_batch(std::move(batch));
+    mq.end();
+
+    for (auto data = mq.receive_batch(); !data.empty(); data = mq.receive_batch())
+      for (auto& [key, value]: *data.typed<String, Long>())
+        bench::do_not_optimize(value);
+    timer.report("MessageQueue typed batch: String/Long", n_records);
+  }
+
+  return 0;
+}
\ No newline at end of file
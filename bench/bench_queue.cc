@@ -0,0 +1,147 @@
+// Contention benchmark of MessageQueue between a producer and a consumer thread,
+// which is the handoff between Mapper, Combiner and Shuffle.
+// This compares MessageQueue with a reference using std::deque guarded by a mutex,
+// which is the implementation used before the lock-free ring was introduced.
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bench_utils.h"
+
+#include "simplemapreduce/data/batch.h"
+#include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/queue.h"
+#include "simplemapreduce/data/type.h"
+
+using namespace mapreduce::data;
+using namespace mapreduce::type;
+
+/// Reference implementation taking a lock and notifying on every record
+class DequeQueue {
+ public:
+  BytePair receive() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    cond_.wait(lock, [this] { return !queue_.empty(); });
+
+    BytePair data = std::move(queue_.front());
+    queue_.pop_front();
+    return data;
+  }
+
+  void send(ByteData&& key, ByteData&& value) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    queue_.emplace_back(std::move(key), std::move(value));
+    cond_.notify_one();
+  }
+
+  void end() { send(ByteData(), ByteData()); }
+
+ private:
+  std::deque<BytePair> queue_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+/** Create words emitted by word count mapper. */
+std::vector<String> make_words(size_t n) {
+  const std::vector<String> vocab{"the", "mapreduce", "a", "cluster", "and", "shuffle", "of", "reducer"};
+  std::vector<String> words;
+  words.reserve(n);
+  for (size_t i = 0; i < n; ++i)
+    words.emplace_back(vocab[i % vocab.size()].c_str());
+  return words;
+}
+
+/**
+ * Run a producer thread and consume the records on the calling thread.
+ *
+ *  @param label    name of the measured section
+ *  @param words    keys to send
+ *  @param produce  function sending all words and the end signal
+ *  @param consume  function receiving records until the end and returning the count
+ */
+template <typename Producer, typename Consumer>
+void run(const char* label, std::vector<String> words, Producer produce, Consumer consume) {
+  auto n_records = words.size();
+  bench::Timer timer;
+
+  std::thread producer([&] { produce(words); });
+  size_t count = consume();
+  producer.join();
+
+  timer.report(label, n_records);
+  if (count != n_records)
+    std::printf("  unexpected record count: %zu\n", count);
+}
+
+int main() {
+  constexpr size_t n_records = 1000000;
+
+  std::printf("records: %zu, threads: producer + consumer\n\n", n_records);
+
+  {
+    DequeQueue mq;
+    run("deque+mutex: record", make_words(n_records),
+      [&](std::vector<String>& words) {
+        for (auto& word: words)
+          mq.send(ByteData{std::move(word)}, ByteData{Long(1)});
+        mq.end();
+      },
+      [&] {
+        size_t count = 0;
+        for (auto data = mq.receive(); !data.first.empty(); data = mq.receive())
+          ++count;
+        return count;
+      });
+  }
+
+  {
+    MessageQueue mq;
+    run("MessageQueue: record", make_words(n_records),
+      [&](std::vector<String>& words) {
+        for (auto& word: words)
+          mq.send(ByteData{std::move(word)}, ByteData{Long(1)});
+        mq.end();
+      },
+      [&] {
+        size_t count = 0;
+        for (auto data = mq.receive(); !data.first.empty(); data = mq.receive())
+          ++count;
+        return count;
+      });
+  }
+
+  for (size_t max_bytes: {size_t(0), RecordBatch::kDefaultCapacity * 4}) {
+    /// Records packed by MQWriter as in Mapper and Combiner contexts.
+    /// With memory limit, batches the consumer cannot catch up are spilled to files.
+    MessageQueue mq;
+    mq.set_max_bytes(max_bytes, std::filesystem::temp_directory_path() / "bench_queue");
+    run(max_bytes == 0 ? "MessageQueue: batch" : "MessageQueue: batch, 256KB limit", make_words(n_records),
+      [&](std::vector<String>& words) {
+        RecordBatch batch;
+        for (auto& word: words) {
+          batch.append(ByteData{std::move(word)}, ByteData{Long(1)});
+          if (batch.bytes() >= RecordBatch::kDefaultCapacity) {
+            mq.send_batch(std::move(batch));
+            batch = RecordBatch();
+          }
+        }
+        mq.send_batch(std::move(batch));
+        mq.end();
+      },
+      [&] {
+        size_t count = 0;
+        for (auto batch = mq.receive_batch(); !batch.empty(); batch = mq.receive_batch())
+          count += batch.size();
+        return count;
+      });
+  }
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef BENCH_BENCH_UTILS_H_
+#define BENCH_BENCH_UTILS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Helpers shared by micro benchmarks.
+ *
+ * Including this header replaces global operator new/delete
+ * to count heap allocations, so include it from one translation unit only.
+ */
+namespace bench {
+
+/// Number of heap allocations since the program started
+inline std::atomic<size_t> n_allocs{0};
+
+/** Get current allocation count. */
+inline size_t alloc_count() { return n_allocs.load(std::memory_order_relaxed); }
+
+/**
+ * Measure elapsed time and allocations of a section.
+ *
+ *  Example:
+ *    bench::Timer timer;
+ *    run_something();
+ *    timer.report("label", n_records);
+ */
+class Timer {
+ public:
+  Timer() : allocs_(alloc_count()), start_(std::chrono::steady_clock::now()) {}
+
+  /**
+   * Print elapsed time and allocation count per item.
+   *
+   *  @param label    name of the measured section
+   *  @param n_items  number of items processed in the section
+   */
+  void report(const char* label, size_t n_items) const {
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_).count();
+    auto allocs = alloc_count() - allocs_;
+    std::printf("%-40s %10.2f ns/item %8.3f allocs/item\n",
+                label, elapsed / n_items, static_cast<double>(allocs) / n_items);
+  }
+
+ private:
+  size_t allocs_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/** Prevent the compiler from optimizing away a value. */
+template <typename T>
+inline void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace bench
+
+void* operator new(size_t size) {
+  bench::n_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+#endif  // BENCH_BENCH_UTILS_H_
\ No newline at end of file
@@ -1,7 +1,11 @@
 target_sources(simplemapreduce PRIVATE
   ${SimpleMapReduce_SOURCE_DIR}/src/argparse.cc
+  ${SimpleMapReduce_SOURCE_DIR}/src/batch.cc
+  ${SimpleMapReduce_SOURCE_DIR}/src/buffer.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/bytes.cc
+  ${SimpleMapReduce_SOURCE_DIR}/src/codec.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/commons.cc
+  ${SimpleMapReduce_SOURCE_DIR}/src/hash.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/job.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/job_runner.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/loader.cc
@@ -9,7 +13,10 @@ target_sources(simplemapreduce PRIVATE
   ${SimpleMapReduce_SOURCE_DIR}/src/local_manager.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/local_runner.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/log.cc
+  ${SimpleMapReduce_SOURCE_DIR}/src/mpi_channel.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/parser.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/queue.cc
+  ${SimpleMapReduce_SOURCE_DIR}/src/sampler.cc
+  ${SimpleMapReduce_SOURCE_DIR}/src/thread_pool.cc
   ${SimpleMapReduce_SOURCE_DIR}/src/writer.cc
 )
@@ -4,6 +4,10 @@ function(setup_test test_target use_mpi)
   target_include_directories(${test_target} PRIVATE ${PROJECT_SOURCE_DIR}/../include)
 
   # set libraries
+  if(ZLIB_FOUND)
+    target_compile_definitions(${test_target} PRIVATE HAS_ZLIB)
+    target_link_libraries(${test_target} PRIVATE ZLIB::ZLIB)
+  endif()
   if(use_mpi)
     target_link_libraries(${test_target} PRIVATE ${MPI_LIBRARIES})
   endif()
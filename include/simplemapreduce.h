@@ -8,6 +8,9 @@
 /// Processed data handler
 #include "simplemapreduce/ops/context.h"
 
+/// Intermediate key distribution
+#include "simplemapreduce/ops/partitioner.h"
+
 /// Mapreduce task runner
 #include "simplemapreduce/ops/job.h"
 
@@ -19,6 +19,7 @@ class JobRunner {
   void set_mapper(std::unique_ptr<mapreduce::base::MapTask>);
   void set_combiner(std::unique_ptr<mapreduce::base::ReduceTask>);
   void set_reducer(std::unique_ptr<mapreduce::base::ReduceTask>);
+  void set_partitioner(std::unique_ptr<mapreduce::base::PartitionTask>);
 
   void set_conf(std::shared_ptr<mapreduce::JobConf> conf) { conf_ = conf; }
 
@@ -28,6 +29,7 @@ class JobRunner {
   std::unique_ptr<mapreduce::base::MapTask> mapper_ = nullptr;
   std::unique_ptr<mapreduce::base::ReduceTask> combiner_ = nullptr;
   std::unique_ptr<mapreduce::base::ReduceTask> reducer_ = nullptr;
+  std::shared_ptr<mapreduce::base::PartitionTask> partitioner_ = nullptr;
 };
 
 }  // namespace base
@@ -1,11 +1,17 @@
 #ifndef SIMPLEMAPREDUCE_BASE_JOB_TASKS_H_
 #define SIMPLEMAPREDUCE_BASE_JOB_TASKS_H_
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "simplemapreduce/data/queue.h"
 #include "simplemapreduce/ops/context.h"
+#include "simplemapreduce/ops/partitioner.h"
 #include "simplemapreduce/proc/loader.h"
+#include "simplemapreduce/proc/sampler.h"
 #include "simplemapreduce/proc/shuffle.h"
 #include "simplemapreduce/proc/sorter.h"
 #include "simplemapreduce/proc/writer.h"
@@ -24,10 +30,13 @@ enum TaskType {
   map_start,
   map_end,
   shuffle_start,
+  shuffle_data,
+  shuffle_hot_keys,
   shuffle_end,
   sort_start,
   sort_end,
   reduce_start,
+  reduce_data,
   reduce_end,
   end,
 };
@@ -50,7 +59,7 @@ class JobTask {
 class MapTask : public JobTask {
  public:
   MapTask() {
-    mq_ = std::make_shared<mapreduce::data::MessageQueue>(mapreduce::data::MessageQueue());
+    mq_ = std::make_shared<mapreduce::data::MessageQueue>();
   }
 
   virtual std::unique_ptr<mapreduce::proc::ShuffleTask> get_shuffle() = 0;
@@ -68,6 +77,32 @@ class MapTask : public JobTask {
    */
   std::shared_ptr<mapreduce::data::MessageQueue> get_mq() { return mq_; };
 
+  /**
+   * Set Partitioner used by shuffle.
+   * If not set, intermediate keys are partitioned by the hash.
+   */
+  void set_partitioner(std::shared_ptr<mapreduce::base::PartitionTask> partitioner) { partitioner_ = partitioner; }
+
+  /**
+   * Partition keys by ranges at shuffle.
+   *
+   *  @param splits  split points of the ranges in primary key bytes
+   */
+  virtual void set_range_partitioner(std::vector<std::string>) = 0;
+
+  /**
+   * Get a sampler of the map output keys.
+   * Keys are sampled only if JobConf::sort_output is set, otherwise nullptr.
+   */
+  std::shared_ptr<mapreduce::proc::KeySampler> get_sampler() { return sampler_; }
+
+ protected:
+  /// Partitioner to decide a group of each key at shuffle
+  std::shared_ptr<mapreduce::base::PartitionTask> partitioner_ = nullptr;
+
+  /// Sampler of map output keys to compute ranges of partitions
+  std::shared_ptr<mapreduce::proc::KeySampler> sampler_ = nullptr;
+
  private:
   /// MessageQueue to store data processed by mapper
   std::shared_ptr<mapreduce::data::MessageQueue> mq_ = nullptr;
@@ -76,18 +111,60 @@ class MapTask : public JobTask {
 class ReduceTask : public JobTask {
  public:
   /**
-   * Run Reduce process.
+   * Run Reduce process of the group set by set_group().
    */
   virtual void run() = 0;
 
+  /**
+   * Finish Reduce processes after all groups assigned to this worker.
+   * Called by all workers, so that partial outputs of salted keys are merged.
+   */
+  virtual void finish() = 0;
+
+  /**
+   * Set the group to reduce by the next run().
+   * Records of this worker kept in the queue are reduced with the group of the worker rank.
+   *
+   *  @param id   group ID, which is the worker rank by default
+   */
+  void set_group(int id) { group_ = id; }
+
   /**
    * Set a MessageQueue object for combiner.
    * If this is set, the Reducer will be seen as Combiner.
    */
   virtual void set_mq(std::shared_ptr<mapreduce::data::MessageQueue>) = 0;
 
+  /**
+   * Get a sorter grouping records of the group of the worker rank.
+   * Shuffle adds records of this worker to it in memory, and records in the queue
+   * set by set_mq() are grouped into the same container at reduce.
+   */
+  virtual std::shared_ptr<mapreduce::proc::SortTask> get_local_sorter() = 0;
+
   /** If called, this object will be used as Combiner. */
   virtual void as_combiner() = 0;
+
+  /**
+   * Return true if outputs have the same types as inputs to be reduced again.
+   * This is required to merge partial outputs of hot keys salted at shuffle.
+   */
+  virtual bool can_reduce_outputs() const = 0;
+
+  /**
+   * Set keys salted at shuffle, which are reduced partially on several workers.
+   * The partial outputs are sent to the group of each key and reduced again.
+   *
+   *  @param keys   hashes of the salted keys
+   */
+  void set_salted_keys(std::unordered_set<std::uint64_t> keys) { salted_keys_ = std::move(keys); }
+
+ protected:
+  /// Group to reduce, or -1 for the group of the worker rank
+  int group_{-1};
+
+  /// Hashes of keys salted at shuffle
+  std::unordered_set<std::uint64_t> salted_keys_;
 };
 
 }  // namespace base
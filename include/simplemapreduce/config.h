@@ -8,6 +8,30 @@ enum Config {
   log_level,
   log_dirpath,
   log_file_level,
+  mq_max_bytes,
+  front_coding,
+  mpi_shuffle,
+  sort_output,
+  sort_runs,
+  compression,
+  hot_key_salts,
+  sort_max_bytes,
+  grouping,
+  reduce_threads,
+  spill_dirpath,
+};
+
+/** Compression codec of intermediate and output files. */
+enum class Compression : char {
+  none,
+  lz,
+  zlib,
+};
+
+/** Strategy to group values by key at reduce. */
+enum class Grouping : char {
+  sort,
+  hash,
 };
 
 }  // namespace mapreduce
@@ -0,0 +1,74 @@
+namespace mapreduce {
+namespace data {
+
+/** Get approximate size of data encoded in ByteData. */
+template <typename T>
+size_t approx_bytes(const T& data) {
+  if constexpr (std::is_same<T, mapreduce::type::String>::value)
+    return data.size();
+  else if constexpr (mapreduce::util::is_compositekey<T>::value)
+    return approx_bytes(data.first) + approx_bytes(data.second) + 1;
+  else
+    return sizeof(T);
+}
+
+template <typename K, typename V>
+void TypedRecords<K, V>::emplace_back(K&& key, V&& value, std::uint64_t hash) {
+  bytes_ += approx_bytes(key) + approx_bytes(value);
+  records_.emplace_back(std::move(key), std::move(value));
+  hashes_.push_back(hash);
+}
+
+template <typename K, typename V>
+void TypedRecords<K, V>::encode(RecordBatch& batch) {
+  for (size_t i = 0; i < records_.size(); ++i) {
+    auto& [key, value] = records_[i];
+    batch.append(ByteData{std::move(key)}, ByteData{std::move(value)}, hashes_[i]);
+  }
+
+  records_.clear();
+  hashes_.clear();
+  bytes_ = 0;
+}
+
+template <typename K, typename V>
+void RecordBatch::emplace_back(K&& key, V&& value) {
+  auto hash = hash_key(key);
+  emplace_back(std::move(key), std::move(value), hash);
+}
+
+template <typename K, typename V>
+void RecordBatch::emplace_back(K&& key, V&& value, std::uint64_t hash) {
+  if (auto records = typed_records<K, V>()) {
+    records->emplace_back(std::move(key), std::move(value), hash);
+  } else {
+    encode();
+    append(ByteData{std::move(key)}, ByteData{std::move(value)}, hash);
+  }
+}
+
+template <typename K, typename V>
+TypedRecords<K, V>* RecordBatch::typed_records() {
+  if (typed_ == nullptr && records_.empty())
+    typed_ = std::make_unique<TypedRecords<K, V>>();
+  return dynamic_cast<TypedRecords<K, V>*>(typed_.get());
+}
+
+template <typename K, typename V>
+std::vector<std::pair<K, V>>* RecordBatch::typed() {
+  auto records = dynamic_cast<TypedRecords<K, V>*>(typed_.get());
+  return records ? &records->records() : nullptr;
+}
+
+template <typename T>
+T RecordBatch::get_key(size_t index) const {
+  return key(index).get_data<T>();
+}
+
+template <typename T>
+T RecordBatch::get_value(size_t index) const {
+  return value(index).get_data<T>();
+}
+
+}  // namespace data
+}  // namespace mapreduce
\ No newline at end of file
@@ -0,0 +1,263 @@
+#ifndef SIMPLEMAPREDUCE_DATA_BATCH_H_
+#define SIMPLEMAPREDUCE_DATA_BATCH_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/hash.h"
+
+namespace mapreduce {
+namespace data {
+
+class RecordBatch;
+
+/** Type erased records stored without byte encoding. */
+class TypedRecordsBase {
+ public:
+  virtual ~TypedRecordsBase() = default;
+
+  /** Get a number of records. */
+  virtual size_t size() const = 0;
+
+  /** Get an approximate size of records in bytes. */
+  virtual size_t bytes() const = 0;
+
+  /** Move all records to given batch with byte encoding. */
+  virtual void encode(RecordBatch&) = 0;
+
+  /** Get key hashes of records in the same order as records. */
+  const std::vector<std::uint64_t>& hashes() const { return hashes_; }
+
+ protected:
+  /// Key hash of each record
+  std::vector<std::uint64_t> hashes_;
+};
+
+/**
+ * Key/value records kept in the original types.
+ * Used to pass records between tasks in the same process
+ * when the consumer takes the same types as the producer.
+ */
+template <typename K, typename V>
+class TypedRecords : public TypedRecordsBase {
+ public:
+  size_t size() const override { return records_.size(); }
+  size_t bytes() const override { return bytes_; }
+  void encode(RecordBatch&) override;
+
+  /**
+   * Append a key/value record.
+   *
+   *  @param key    key data
+   *  @param value  value data
+   *  @param hash   hash of the key (see hash_key())
+   */
+  void emplace_back(K&&, V&&, std::uint64_t);
+
+  /** Get stored records. */
+  std::vector<std::pair<K, V>>& records() { return records_; }
+
+ private:
+  std::vector<std::pair<K, V>> records_;
+  size_t bytes_{0};
+};
+
+/**
+ * Contiguous container of key/value records.
+ *
+ * Key and value bytes of all records are stored in a single growable arena
+ * and each record only holds offsets into it,
+ * so that passing records between tasks does not allocate per record.
+ *
+ * Alternatively, a batch can hold records in their original types (see emplace_back()),
+ * which is consumed without encoding by a task taking the same types.
+ * Byte accessors are only valid for encoded batches, so call encode() before using them
+ * if the batch can be typed.
+ */
+class RecordBatch {
+ public:
+  /// Default arena size in bytes to send a batch to the next task
+  static constexpr size_t kDefaultCapacity = 64 * 1024;
+
+  RecordBatch() {}
+
+  /**
+   * Append a key/value record.
+   *
+   *  @param key    key data
+   *  @param value  value data
+   */
+  void append(const ByteData&, const ByteData&);
+
+  /**
+   * Append a key/value record with the key hash computed in advance.
+   *
+   *  @param key    key data
+   *  @param value  value data
+   *  @param hash   hash of the key (see hash_key())
+   */
+  void append(const ByteData&, const ByteData&, std::uint64_t);
+
+  /**
+   * Copy a record from another batch.
+   *
+   *  @param batch  batch containing the record
+   *  @param index  index of the record in the batch
+   */
+  void append(const RecordBatch&, size_t);
+
+  /**
+   * Append a record keeping the original types.
+   * If the batch already has records in bytes or other types, the record is encoded.
+   * The key is hashed here once and the hash is kept with the record.
+   *
+   *  @param key    key data
+   *  @param value  value data
+   */
+  template <typename K, typename V>
+  void emplace_back(K&&, V&&);
+
+  /**
+   * Append a record keeping the original types with the key hash computed in advance.
+   *
+   *  @param key    key data
+   *  @param value  value data
+   *  @param hash   hash of the key (see hash_key())
+   */
+  template <typename K, typename V>
+  void emplace_back(K&&, V&&, std::uint64_t);
+
+  /**
+   * Get the storage of records in given types to append records without checking the types each time.
+   * An empty batch starts to hold records of the types.
+   *
+   *  @return   pointer to the storage valid until the batch is encoded, moved or cleared,
+   *            nullptr if the batch has records in bytes or other types
+   */
+  template <typename K, typename V>
+  TypedRecords<K, V>* typed_records();
+
+  /**
+   * Get typed records if the batch holds records of given types.
+   *
+   *  @return   pointer to the records, nullptr if the batch is encoded or in other types
+   */
+  template <typename K, typename V>
+  std::vector<std::pair<K, V>>* typed();
+
+  /** Check if the batch holds records in the original types. */
+  bool is_typed() const { return typed_ != nullptr; }
+
+  /** Convert typed records to bytes. Nothing happens if already encoded. */
+  void encode();
+
+  /**
+   * Get the key hash of the record at given index.
+   * This is computed when the record is added, and available for both typed and encoded records.
+   */
+  std::uint64_t hash(size_t index) const { return typed_ ? typed_->hashes()[index] : records_[index].hash; }
+
+  /** Get a view of key bytes of the record at given index. */
+  ByteView key(size_t) const;
+
+  /** Get a view of value bytes of the record at given index. */
+  ByteView value(size_t) const;
+
+  /** Get key of the record at given index as given type. */
+  template <typename T>
+  T get_key(size_t) const;
+
+  /** Get value of the record at given index as given type. */
+  template <typename T>
+  T get_value(size_t) const;
+
+  /** Get the record at given index as ByteData pair. */
+  BytePair get_item(size_t) const;
+
+  /** Get a number of records. */
+  size_t size() const { return typed_ ? typed_->size() : records_.size(); }
+
+  /** Check if no record is stored. */
+  bool empty() const { return size() == 0; }
+
+  /** Get a size of the arena in bytes, or approximate size of typed records. */
+  size_t bytes() const { return typed_ ? typed_->bytes() : arena_.size(); }
+
+  /** Remove all records. Allocated memory is kept for reuse. */
+  void clear();
+
+  /**
+   * Write the batch to a binary file.
+   *
+   *  @param ofs  output file stream
+   */
+  void write(std::ofstream&) const;
+
+  /**
+   * Replace content with a batch written by write().
+   *
+   *  @param ifs  input file stream
+   *  @return     false if reached the end of the file
+   */
+  bool read(std::ifstream&);
+
+  /**
+   * Append the batch to a byte array in the same format as write().
+   * The batch must be encoded.
+   *
+   *  @param out  byte array to store the batch
+   */
+  void write(std::vector<char>&) const;
+
+  /**
+   * Replace content with a batch in a byte array.
+   *
+   *  @param data   pointer to bytes written by write()
+   *  @param size   size of the bytes
+   *  @return       false if the bytes are not a valid batch
+   */
+  bool read(const char*, size_t);
+
+ private:
+  /** Location of a record in the arena. */
+  struct Record {
+    /// Hash of the key
+    std::uint64_t hash;
+
+    /// Offset of the key, value is placed right after the key
+    std::uint32_t offset;
+    std::uint32_t key_size;
+    std::uint32_t value_size;
+
+    /// Length of the key/value in the original data type (see ByteData::size())
+    std::uint32_t key_length;
+    std::uint32_t value_length;
+
+    /// 1 if the key is CompositeKey (see ByteView::is_composite())
+    std::uint32_t key_composite;
+  };
+
+  /** Helper function to append record bytes. */
+  inline void append_(ByteView, size_t, std::string_view, size_t, std::uint64_t);
+
+  /// Key and value bytes of all records
+  std::vector<char> arena_;
+
+  /// Offset table of records
+  std::vector<Record> records_;
+
+  /// Records stored without encoding
+  std::unique_ptr<TypedRecordsBase> typed_ = nullptr;
+};
+
+}  // namespace data
+}  // namespace mapreduce
+
+#include "simplemapreduce/data/batch-inl.h"
+
+#endif  // SIMPLEMAPREDUCE_DATA_BATCH_H_
\ No newline at end of file
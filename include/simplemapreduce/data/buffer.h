@@ -0,0 +1,112 @@
+#ifndef SIMPLEMAPREDUCE_DATA_BUFFER_H_
+#define SIMPLEMAPREDUCE_DATA_BUFFER_H_
+
+#include <cstddef>
+
+namespace mapreduce {
+namespace data {
+
+/**
+ * Byte array with small buffer optimization.
+ *
+ * Payloads up to `kInlineCapacity` bytes are stored in the object itself
+ * so that scalar values and short words do not need heap allocation.
+ * Larger payloads are moved to heap memory.
+ * The interface follows the subset of std::vector<char> used in ByteData.
+ */
+class ByteBuffer {
+ public:
+  /// Max size of bytes stored without heap allocation
+  static constexpr size_t kInlineCapacity = 24;
+
+  ByteBuffer() {}
+
+  /**
+   * Construct with bytes copied from given array.
+   *
+   *  @param data   pointer to a byte array
+   *  @param size   size of the array
+   */
+  ByteBuffer(const char*, size_t);
+
+  /**
+   * Construct zero-filled buffer.
+   *
+   *  @param size   size of the buffer
+   */
+  explicit ByteBuffer(size_t);
+
+  ~ByteBuffer() { release(); }
+
+  ByteBuffer(const ByteBuffer&);
+  ByteBuffer &operator=(const ByteBuffer&);
+  ByteBuffer(ByteBuffer&&) noexcept;
+  ByteBuffer &operator=(ByteBuffer&&) noexcept;
+
+  bool operator==(const ByteBuffer&) const;
+  bool operator!=(const ByteBuffer& rhs) const { return !(*this == rhs); }
+  bool operator<(const ByteBuffer&) const;
+  bool operator>(const ByteBuffer& rhs) const { return rhs < *this; }
+
+  /**
+   * Replace content with given bytes.
+   *
+   *  @param data   pointer to a byte array
+   *  @param size   size of the array
+   */
+  void assign(const char*, size_t);
+
+  /**
+   * Append bytes to the end.
+   *
+   *  @param data   pointer to a byte array
+   *  @param size   size of the array
+   */
+  void append(const char*, size_t);
+
+  /** Append a byte to the end. */
+  void push_back(char c) { append(&c, 1); }
+
+  /** Resize the buffer. Newly added bytes are not initialized. */
+  void resize(size_t);
+
+  /** Remove all data. Allocated memory is kept for reuse. */
+  void clear() noexcept { size_ = 0; }
+
+  char* data() noexcept { return is_inline() ? local_ : heap_; }
+  const char* data() const noexcept { return is_inline() ? local_ : heap_; }
+
+  char* begin() noexcept { return data(); }
+  char* end() noexcept { return data() + size_; }
+  const char* begin() const noexcept { return data(); }
+  const char* end() const noexcept { return data() + size_; }
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  /** Check if data is stored without heap allocation. */
+  bool is_inline() const noexcept { return capacity_ == kInlineCapacity; }
+
+ private:
+  /** Make sure the buffer can hold given size of bytes. */
+  void reserve(size_t);
+
+  /** Free heap memory if allocated and reset to inline storage. */
+  void release() noexcept;
+
+  /// Size of stored bytes
+  size_t size_{0};
+
+  /// Size of bytes can be stored without reallocation
+  size_t capacity_{kInlineCapacity};
+
+  union {
+    char local_[kInlineCapacity];
+    char* heap_;
+  };
+};
+
+}  // namespace data
+}  // namespace mapreduce
+
+#endif  // SIMPLEMAPREDUCE_DATA_BUFFER_H_
\ No newline at end of file
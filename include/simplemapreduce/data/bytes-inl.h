@@ -1,97 +1,203 @@
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <limits>
 #include <stdexcept>
 
 namespace mapreduce {
 namespace data {
 
+/// Unsigned integer type with the same size as T
+template <typename T>
+using ordered_uint_t = std::conditional_t<sizeof(T) == 1, std::uint8_t,
+                       std::conditional_t<sizeof(T) == 2, std::uint16_t,
+                       std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>>>;
+
+template <typename T>
+void encode_ordered(T value, char* out) {
+  static_assert(std::is_arithmetic<T>::value, "Only numeric values are encoded in order.");
+  using U = ordered_uint_t<T>;
+  constexpr U sign = U(1) << (sizeof(U) * 8 - 1);
+
+  /// Equal keys must have the same bytes to be grouped after spills and shuffle
+  if constexpr (std::is_floating_point<T>::value) {
+    if (value == T(0))
+      value = T(0);
+    else if (std::isnan(value))
+      value = std::numeric_limits<T>::quiet_NaN();
+  }
+
+  U bits;
+  std::memcpy(&bits, &value, sizeof(T));
+  if constexpr (std::is_floating_point<T>::value)
+    bits = (bits & sign) ? static_cast<U>(~bits) : static_cast<U>(bits ^ sign);
+  else if constexpr (std::is_signed<T>::value)
+    bits ^= sign;
+
+  /// Most significant byte first so that bytes are compared from the top
+  for (size_t i = 0; i < sizeof(U); ++i)
+    out[i] = static_cast<char>(bits >> (8 * (sizeof(U) - 1 - i)));
+}
+
+template <typename T>
+T decode_ordered(const char* data) {
+  static_assert(std::is_arithmetic<T>::value, "Only numeric values are encoded in order.");
+  using U = ordered_uint_t<T>;
+  constexpr U sign = U(1) << (sizeof(U) * 8 - 1);
+
+  U bits = 0;
+  for (size_t i = 0; i < sizeof(U); ++i)
+    bits = static_cast<U>((bits << 8) | static_cast<unsigned char>(data[i]));
+
+  if constexpr (std::is_floating_point<T>::value)
+    bits = (bits & sign) ? static_cast<U>(bits ^ sign) : static_cast<U>(~bits);
+  else if constexpr (std::is_signed<T>::value)
+    bits ^= sign;
+
+  T value;
+  std::memcpy(&value, &bits, sizeof(T));
+  return value;
+}
+
 template <typename T1, typename T2>
 ByteData::ByteData(mapreduce::type::CompositeKey<T1, T2>&& data) {
+  set_data(std::move(data));
+}
+
+template <typename T1, typename T2>
+void ByteData::set_data(mapreduce::type::CompositeKey<T1, T2>&& data) noexcept {
   set_data(std::move(data.first));
+  std::uint32_t first_size = data_.size();
+
   // use SOH as separator of first and second data
   data_.push_back('\1');
   push_back<T2>(data.second);
+
+  /// Size of the first data is stored at the end to split data without scanning,
+  /// which is in big-endian to keep the order of bytes
+  char trailer[kCompositeTrailerSize];
+  for (size_t i = 0; i < kCompositeTrailerSize; ++i)
+    trailer[i] = static_cast<char>(first_size >> (8 * (kCompositeTrailerSize - 1 - i)));
+  data_.append(trailer, kCompositeTrailerSize);
   size_ = 2;
+  composite_ = true;
 }
 
 template <typename T>
 void ByteData::set_bytes(char* data, const size_t& size) {
-  data_ = std::vector<char>(data, data + size);
+  data_.assign(data, size);
   size_ = size / sizeof(T);
+  composite_ = mapreduce::util::is_compositekey<T>::value;
 }
 
 template <typename T>
 void ByteData::set_data_(T& data) {
-  data_.clear();
-  char* buff = reinterpret_cast<char*>(&data);
-  data_ = std::vector<char>(buff, buff + sizeof(T));
+  data_.resize(sizeof(T));
+  encode_ordered(data, data_.data());
   size_ = 1;
+  composite_ = false;
 }
 
 template <typename T>
 void ByteData::set_data_(T* data, const size_t& size) {
-  data_.clear();
-  char* buff = reinterpret_cast<char*>(data);
-  data_ = std::vector<char>(buff, buff + sizeof(T) * size);
+  data_.resize(sizeof(T) * size);
+  for (size_t i = 0; i < size; ++i)
+    encode_ordered(data[i], data_.data() + sizeof(T) * i);
   size_ = size;
+  composite_ = false;
 }
 
 template <typename T>
 T ByteData::get_data_() const {
-  T data;
-  /// Only used on the same machine so no need to consider endianness
-  size_ ? std::memcpy(&data, data_.data(), sizeof(T) * size_)
-        : std::memcpy(&data, data_.data(), sizeof(T));
+  return decode_ordered<T>(data_.data());
+}
 
-  return data;
+/** Get a size of the first data of CompositeKey, and throw if the data is not a pair. */
+inline size_t composite_first_size_or_throw(const char* data, size_t size) {
+  size_t first_size = composite_first_size(data, size);
+  if (first_size == size) {
+    throw std::runtime_error("Invalid call: this is not a pair.");
+  }
+  return first_size;
 }
 
 template <typename T>
-T ByteData::get_data_(size_t offset) const {
-  T data;
-  std::memcpy(&data, data_.data() + offset, sizeof(T));
-  return data;
+T from_bytes(const char* data, size_t size) {
+  if constexpr (std::is_same<T, mapreduce::type::String>::value) {
+    return T(data, size);
+  } else if constexpr (mapreduce::util::is_compositekey<T>::value) {
+    auto first_size = composite_first_size_or_throw(data, size);
+    auto start = first_size + 1;
+    auto first = from_bytes<typename T::first_type>(data, first_size);
+    auto second = from_bytes<typename T::second_type>(data + start, size - start - kCompositeTrailerSize);
+
+    return T(std::move(first), std::move(second));
+  } else {
+    return decode_ordered<T>(data);
+  }
 }
 
 template <typename T>
-T ByteData::get_data_(size_t start, size_t end) const {
-  T data;
-  std::memcpy(&data, data_.data() + start, end - start);
-  return data;
+view_t<T> from_bytes_view(const char* data, size_t size) {
+  if constexpr (std::is_same<T, mapreduce::type::String>::value) {
+    return std::string_view(data, size);
+  } else if constexpr (mapreduce::util::is_compositekey<T>::value) {
+    auto first_size = composite_first_size_or_throw(data, size);
+    auto start = first_size + 1;
+    return view_t<T>(from_bytes_view<typename T::first_type>(data, first_size),
+                     from_bytes_view<typename T::second_type>(data + start, size - start - kCompositeTrailerSize));
+  } else {
+    static_assert(std::is_trivially_copyable<T>::value, "Invalid type to view.");
+    return from_bytes<T>(data, size);
+  }
+}
+
+template <typename T>
+view_t<T> ByteView::get_view() const {
+  return from_bytes_view<T>(data_.data(), data_.size());
 }
 
-template<> mapreduce::type::String ByteData::get_data_(size_t, size_t) const;
+template <typename T>
+T ByteView::get_data() const {
+  return from_bytes<T>(data_.data(), data_.size());
+}
 
 template <typename T, std::enable_if_t<mapreduce::util::is_compositekey<T>::value, bool>>
 T ByteData::get_data() const {
-  typename T::first_type first;
-  auto divider = std::find(data_.begin(), data_.end(), '\1');
-  if (divider == data_.end()) {
-    throw std::runtime_error("Invalid call: this is not a pair.");
-  }
+  return from_bytes<T>(data_.data(), data_.size());
+}
 
-  if (std::is_same<typename T::first_type, mapreduce::type::String>()) {
-    first = get_data_<typename T::first_type>(0, divider - data_.begin());
-  } else {
-    first = get_data_<typename T::first_type>(0, sizeof(typename T::first_type));
-  }
+template <typename T>
+void ByteData::push_back_(T& data) {
+  char buffer[sizeof(T)];
+  encode_ordered(data, buffer);
+  data_.append(buffer, sizeof(T));
+  ++size_;
+}
 
-  typename T::second_type second;
-  auto start = divider - data_.begin() + 1;
-  if (std::is_same<typename T::second_type, mapreduce::type::String>()) {
-    second = get_data_<typename T::second_type>(start, data_.size());
+/** Call a function with the encoded bytes of a typed value. */
+template <typename T, typename F>
+auto visit_bytes_(const T& data, F&& func) {
+  if constexpr (std::is_same<T, mapreduce::type::String>::value) {
+    return func(ByteView(data));
+  } else if constexpr (std::is_arithmetic<T>::value) {
+    char bytes[sizeof(T)];
+    encode_ordered(data, bytes);
+    return func(ByteView(bytes, sizeof(T)));
   } else {
-    second = get_data_<typename T::second_type>(start, start + sizeof(typename T::second_type));
+    ByteData bdata{T(data)};
+    return func(bdata.view());
   }
-
-  return mapreduce::type::CompositeKey<typename T::first_type, typename T::second_type>(first, second);
 }
 
-template <typename T>
-void ByteData::push_back_(T& data) {
-  char* buff = reinterpret_cast<char*>(&data);
-  data_.insert(data_.end(), buff, buff + sizeof(T));
-  ++size_;
+template <typename K, typename F>
+auto visit_primary_key(const K& key, F&& func) {
+  /// Whole bytes of the first data is the primary key of CompositeKey, and whole bytes of the key otherwise
+  if constexpr (mapreduce::util::is_compositekey<K>::value)
+    return visit_bytes_(key.first, std::forward<F>(func));
+  else
+    return visit_bytes_(key, std::forward<F>(func));
 }
 
 }  // namespace data
@@ -3,16 +3,89 @@
 
 #include <filesystem>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "simplemapreduce/data/buffer.h"
 #include "simplemapreduce/data/type.h"
 #include "simplemapreduce/util/type_check.h"
 
 namespace mapreduce {
 namespace data {
 
+/**
+ * Type of non-owning view to data decoded from bytes.
+ *  - String: std::string_view
+ *  - CompositeKey: pair of views
+ *  - Others: the data type itself, which is copied from bytes
+ */
+template <typename T>
+struct view_type { using type = T; };
+
+template <>
+struct view_type<mapreduce::type::String> { using type = std::string_view; };
+
+template <typename T1, typename T2>
+struct view_type<mapreduce::type::CompositeKey<T1, T2>> {
+  using type = std::pair<typename view_type<T1>::type, typename view_type<T2>::type>;
+};
+
+template <typename T>
+using view_t = typename view_type<T>::type;
+
+/**
+ * Non-owning view of bytes in ByteData format.
+ * The viewed bytes must outlive the view.
+ * Bytes of CompositeKey are viewed with the composite flag to split the primary key,
+ * since they cannot be told from other bytes reliably.
+ */
+class ByteView {
+ public:
+  ByteView() {}
+  ByteView(const char* data, size_t size, bool composite = false) : data_(data, size), composite_(composite) {}
+  ByteView(std::string_view data, bool composite = false) : data_(data), composite_(composite) {}
+
+  /// Same order as ByteData
+  bool operator==(const ByteView& rhs) const { return data_ == rhs.data_; }
+  bool operator!=(const ByteView& rhs) const { return data_ != rhs.data_; }
+  bool operator<(const ByteView& rhs) const { return data_ < rhs.data_; }
+  bool operator>(const ByteView& rhs) const { return rhs < *this; }
+
+  operator std::string_view() const { return data_; }
+
+  /**
+   * Get data as a view without copying bytes.
+   *
+   *  Example:
+   *    std::string_view word = view.get_view<String>();
+   */
+  template <typename T>
+  view_t<T> get_view() const;
+
+  /** Get data as given type. */
+  template <typename T>
+  T get_data() const;
+
+  /**
+   * Get a view of primary key.
+   * This is the first part of CompositeKey, otherwise whole data.
+   */
+  ByteView primary_key() const;
+
+  /** Check if the bytes are CompositeKey. */
+  bool is_composite() const { return composite_; }
+
+  const char* data() const { return data_.data(); }
+  size_t size() const { return data_.size(); }
+  bool empty() const { return data_.empty(); }
+
+ private:
+  std::string_view data_;
+  bool composite_{false};
+};
+
 class ByteData {
  public:
   ByteData() {}
@@ -29,9 +102,10 @@ class ByteData {
 
   ByteData(const ByteData&);
   ByteData &operator=(const ByteData&);
-  ByteData(ByteData&&);
-  ByteData &operator=(ByteData&&);
+  ByteData(ByteData&&) noexcept;
+  ByteData &operator=(ByteData&&) noexcept;
 
+  /// Bytes are compared by memcmp, which is the same order as the original values
   bool operator==(const ByteData& rhs) const;
   bool operator!=(const ByteData& rhs) const;
   bool operator<(const ByteData& rhs) const;
@@ -81,6 +155,16 @@ class ByteData {
   template <typename T>
   void set_bytes(char*, const size_t&);
 
+  /**
+   * Set data from bytes with the length in the original data type.
+   *
+   *  @param data       pointer to a bytes array
+   *  @param size       size of the array
+   *  @param length     length of values in the original data type
+   *  @param composite  true if the bytes are CompositeKey
+   */
+  void set_bytes(const char*, const size_t&, const size_t&, bool composite = false);
+
   /**
    * Read and set data from a file.
    * All data will be assumed as char type.
@@ -112,11 +196,28 @@ class ByteData {
    * This is used for shuffling process with hashing by the key
    * and will not directly convert numeric value to the string
    * so that it cannot be used for converting value to string.
+   * The first data is taken from the trailer for CompositeKey without scanning bytes.
    */
   mapreduce::type::String get_key() const;
 
+  /** Get a view of primary key data without copying bytes. */
+  ByteView get_key_view() const { return view().primary_key(); }
+
+  /** Get a non-owning view of the bytes. */
+  ByteView view() const { return ByteView(data_.data(), data_.size(), composite_); }
+
+  /** Check if the data is CompositeKey. */
+  bool is_composite() const { return composite_; }
+
+  /**
+   * Get data as a view without copying bytes.
+   * The view is valid while this object is not modified.
+   */
+  template <typename T>
+  view_t<T> get_view() const { return view().get_view<T>(); }
+
   /** Get data as bytes in char array. */
-  const char* get_byte() { return data_.data(); }
+  const char* get_byte() const { return data_.data(); }
 
   /** Get a length of the data. */
   size_t size() const { return size_; }
@@ -124,7 +225,7 @@ class ByteData {
   size_t bsize() const { return data_.size(); }
 
   /** Check if data is empty. */
-  bool empty() { return data_.empty(); }
+  bool empty() const { return data_.empty(); }
 
   /**
    * Append new value to the container as array.
@@ -153,38 +254,90 @@ class ByteData {
   template <typename T>
   inline T get_data_() const;
 
-  /**
-   * Helper function to get data with offset.
-   * This will read data from `begin() + offset` to `end()`.
-   *
-   *  @param offset  offset size from begin()
-   */
-  template <typename T>
-  inline T get_data_(size_t) const;
-
-  /**
-   * Helper function to get data with range.
-   * This will read data from `begin() + start` to `begin() + end()`.
-   * This is used for reading string data.
-   *
-   *  @param start  start index to read data
-   *  @param end    end index to read data exclusive
-   */
-  template <typename T>
-  inline T get_data_(size_t, size_t) const;
-
   /** Helper function to append byte data. */
   template <typename T>
   inline void push_back_(T& data);
 
-  std::vector<char> data_;
+  /// Small values are stored inline without heap allocation
+  ByteBuffer data_;
 
   /// Length of values in the original data type.
   size_t size_{0};
+
+  /// Data is CompositeKey, whose primary key is the first data
+  bool composite_{false};
 };
 
 using BytePair =  std::pair<ByteData, ByteData>;
 
+/**
+ * Decode data stored as bytes in ByteData format.
+ *
+ *  @param data   pointer to a bytes array
+ *  @param size   size of the array
+ */
+template <typename T>
+T from_bytes(const char*, size_t);
+
+/**
+ * Decode data stored as bytes in ByteData format without copying bytes.
+ *
+ *  @param data   pointer to a bytes array
+ *  @param size   size of the array
+ */
+template <typename T>
+view_t<T> from_bytes_view(const char*, size_t);
+
+/**
+ * Size of the trailer of CompositeKey.
+ *
+ * CompositeKey is encoded as (first, SOH, second, size of first in big-endian),
+ * so that the primary key is split in O(1) even if numeric first data contains SOH.
+ * The separator and the trailer also keep keys in order by memcmp.
+ */
+constexpr size_t kCompositeTrailerSize = 4;
+
+/**
+ * Get a size of the first data if bytes are encoded as CompositeKey.
+ *
+ *  @param data   pointer to a bytes array
+ *  @param size   size of the array
+ *  @return       size of the first data, or `size` if the bytes are not CompositeKey
+ */
+size_t composite_first_size(const char*, size_t);
+
+/**
+ * Encode a numeric value to bytes in the order of the values.
+ * Integers are stored in big-endian with the sign bit flipped, and floating points
+ * are stored with the sign bit flipped for positive and all bits flipped for negative,
+ * so that encoded bytes are compared by memcmp in the same order as the values.
+ * -0.0 is encoded as 0.0 and any NaN as the quiet NaN, which is ordered after infinity.
+ *
+ *  @param value  numeric value to encode
+ *  @param out    pointer to a bytes array of sizeof(T)
+ */
+template <typename T>
+void encode_ordered(T, char*);
+
+/**
+ * Decode a numeric value from bytes encoded by `encode_ordered`.
+ *
+ *  @param data   pointer to a bytes array of sizeof(T)
+ */
+template <typename T>
+T decode_ordered(const char*);
+
+/**
+ * Call a function with the primary key bytes of a typed key,
+ * which are the same bytes as ByteData{key}.get_key_view() without encoding whole key.
+ *
+ *  @param key  typed key
+ *  @param func function taking ByteView
+ *  @return     the return value of the function
+ */
+template <typename K, typename F>
+auto visit_primary_key(const K&, F&&);
+
 }  // namespace data
 }  // namespace mapreduce
 
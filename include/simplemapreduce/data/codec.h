@@ -0,0 +1,251 @@
+#ifndef SIMPLEMAPREDUCE_DATA_CODEC_H_
+#define SIMPLEMAPREDUCE_DATA_CODEC_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+#include "simplemapreduce/config.h"
+
+namespace mapreduce {
+namespace data {
+
+/// Header of files written by CompressBuffer, followed by a byte of the codec type
+constexpr char kCompressedMagic[] = "\x89SMRCZ\r\n";
+constexpr size_t kCompressedMagicSize = sizeof(kCompressedMagic) - 1;
+
+/**
+ * Base class of block compression codecs.
+ * Each block is compressed independently so that it can be decompressed alone.
+ */
+class Codec {
+ public:
+  virtual ~Codec() = default;
+
+  /** Get the type written in file headers. */
+  virtual mapreduce::Compression type() const = 0;
+
+  /**
+   * Compress bytes and append to a buffer.
+   *
+   *  @param data   pointer to bytes to compress
+   *  @param size   size of the bytes
+   *  @param out    buffer to append the compressed bytes
+   */
+  virtual void compress(const char*, size_t, std::vector<char>&) const = 0;
+
+  /**
+   * Decompress bytes compressed by compress().
+   *
+   *  @param data     pointer to compressed bytes
+   *  @param size     size of the compressed bytes
+   *  @param out      pointer to store the original bytes
+   *  @param out_size size of the original bytes
+   *  @return         false if the data is corrupted
+   */
+  virtual bool decompress(const char*, size_t, char*, size_t) const = 0;
+};
+
+/**
+ * Fast codec in the LZ4 block format, which finds matches of 4+ bytes by a hash table.
+ * Suited to intermediate data where speed matters more than the ratio.
+ */
+class LZCodec : public Codec {
+ public:
+  mapreduce::Compression type() const override { return mapreduce::Compression::lz; }
+  void compress(const char*, size_t, std::vector<char>&) const override;
+  bool decompress(const char*, size_t, char*, size_t) const override;
+};
+
+/**
+ * Codec by zlib (deflate) for a higher ratio than LZCodec.
+ * Available only if the library is built with zlib.
+ */
+class ZlibCodec : public Codec {
+ public:
+  mapreduce::Compression type() const override { return mapreduce::Compression::zlib; }
+  void compress(const char*, size_t, std::vector<char>&) const override;
+  bool decompress(const char*, size_t, char*, size_t) const override;
+};
+
+/**
+ * Get a codec of the compression type.
+ *
+ *  @param type   compression type
+ *  @return       codec, or nullptr for Compression::none
+ *  @throw        std::invalid_argument if the codec is not available
+ */
+std::shared_ptr<Codec> get_codec(mapreduce::Compression);
+
+/** Bytes before and after compression. */
+struct CompressionStats {
+  std::uint64_t raw_bytes{0};
+  std::uint64_t stored_bytes{0};
+
+  CompressionStats& operator+=(const CompressionStats& rhs) {
+    raw_bytes += rhs.raw_bytes;
+    stored_bytes += rhs.stored_bytes;
+    return *this;
+  }
+
+  /** Get raw bytes per stored byte. */
+  double ratio() const { return stored_bytes > 0 ? static_cast<double>(raw_bytes) / stored_bytes : 1.0; }
+};
+
+/**
+ * Compress a block and append it with the header (original size, stored size) in uint32.
+ * The block is stored as it is if not compressed into smaller bytes.
+ *
+ *  @param codec  codec to compress
+ *  @param data   pointer to bytes to compress
+ *  @param size   size of the bytes, which must fit in uint32
+ *  @param out    buffer to append the block
+ */
+void write_block(const Codec&, const char*, size_t, std::vector<char>&);
+
+/**
+ * Decompress a block written by write_block().
+ *
+ *  @param codec  codec to decompress
+ *  @param data   pointer to the block
+ *  @param size   size of the block
+ *  @param out    buffer to store the original bytes
+ *  @return       false if the block is corrupted
+ */
+bool read_block(const Codec&, const char*, size_t, std::vector<char>&);
+
+/**
+ * Output stream buffer compressing bytes in blocks.
+ * Written bytes start with kCompressedMagic and the codec type,
+ * followed by blocks written by write_block(), which are read by InputFile.
+ */
+class CompressBuffer : public std::streambuf {
+ public:
+  /// Size of original bytes compressed at once
+  static constexpr size_t kBlockBytes = 64 * 1024;
+
+  /**
+   * Constructor.
+   *
+   *  @param out    stream buffer to write compressed bytes (e.g. of std::ofstream)
+   *  @param codec  codec to compress
+   */
+  CompressBuffer(std::streambuf*, std::shared_ptr<Codec>);
+  ~CompressBuffer() { sync(); }
+
+  CompressBuffer(const CompressBuffer&) = delete;
+  CompressBuffer& operator=(const CompressBuffer&) = delete;
+
+  /** Get bytes written so far. */
+  const CompressionStats& stats() const { return stats_; }
+
+ protected:
+  int_type overflow(int_type) override;
+
+  /** Write buffered bytes as a block. */
+  int sync() override;
+
+ private:
+  /** Compress and write the buffered bytes. */
+  bool write_block_();
+
+  std::streambuf* out_;
+  std::shared_ptr<Codec> codec_;
+
+  /// Original bytes of the current block, and the compressed block
+  std::vector<char> block_;
+  std::vector<char> stored_;
+
+  CompressionStats stats_;
+};
+
+/**
+ * Input stream buffer decompressing blocks written by CompressBuffer.
+ * An index of the blocks is built on construction to seek to any position of the original bytes.
+ */
+class DecompressBuffer : public std::streambuf {
+ public:
+  /**
+   * Constructor.
+   *
+   *  @param in     file stream located after the header
+   *  @param codec  codec to decompress
+   */
+  DecompressBuffer(std::shared_ptr<std::istream>, std::shared_ptr<Codec>);
+
+  /** Share the file and the index, with the own buffer of a block. */
+  DecompressBuffer(const DecompressBuffer&);
+  DecompressBuffer& operator=(const DecompressBuffer&) = delete;
+
+ protected:
+  int_type underflow() override;
+  pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode) override;
+  pos_type seekpos(pos_type, std::ios_base::openmode) override;
+
+ private:
+  /** Location of a block in the original bytes and in the file. */
+  struct Block {
+    std::uint64_t offset;
+    std::uint32_t size;
+    std::streamoff file_offset;
+    std::uint32_t stored_size;
+  };
+
+  /** Decompress the i-th block to the buffer. */
+  void load_(size_t);
+
+  std::shared_ptr<std::istream> in_;
+  std::shared_ptr<Codec> codec_;
+  std::shared_ptr<const std::vector<Block>> blocks_;
+
+  /// Index of the block in the buffer
+  size_t current_{0};
+  std::vector<char> buffer_;
+  std::vector<char> stored_;
+};
+
+/**
+ * Input file stream of the original bytes, which are decompressed if the file
+ * is written with a codec (detected by kCompressedMagic).
+ * The file may be any seekable stream, such as a partition of an intermediate file.
+ *
+ *  Example:
+ *    InputFile fin("outputs/00000");
+ *    std::string line;
+ *    while (std::getline(fin, line)) {...}
+ */
+class InputFile : public std::istream {
+ public:
+  InputFile(const std::filesystem::path&);
+
+  /**
+   * Constructor reading from a stream located at the beginning of the file.
+   *
+   *  @param file   seekable stream of the file bytes
+   */
+  InputFile(std::shared_ptr<std::istream>);
+
+  /**
+   * Open another stream of the same file sharing the file descriptor.
+   * Streams must set the position (e.g. seekg) before reading.
+   */
+  std::unique_ptr<InputFile> share() const;
+
+  /** Return true if the file is written with a codec. */
+  bool is_compressed() const { return buffer_ != nullptr; }
+
+ private:
+  InputFile(std::shared_ptr<std::istream>, std::unique_ptr<DecompressBuffer>);
+
+  std::shared_ptr<std::istream> file_;
+  std::unique_ptr<DecompressBuffer> buffer_;
+};
+
+}  // namespace data
+}  // namespace mapreduce
+
+#endif  // SIMPLEMAPREDUCE_DATA_CODEC_H_
\ No newline at end of file
@@ -0,0 +1,13 @@
+#include <type_traits>
+
+namespace mapreduce {
+namespace data {
+
+template <typename K>
+std::uint64_t hash_key(const K& key) {
+  /// Hash the same bytes as the primary key of ByteData
+  return visit_primary_key(key, [](ByteView view) { return hash_bytes(view.data(), view.size()); });
+}
+
+}  // namespace data
+}  // namespace mapreduce
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef SIMPLEMAPREDUCE_DATA_HASH_H_
+#define SIMPLEMAPREDUCE_DATA_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "simplemapreduce/data/bytes.h"
+
+namespace mapreduce {
+namespace data {
+
+/// Seed shared by all ranks so that the same key is always assigned to the same partition
+constexpr std::uint64_t kHashSeed = 0x9e3779b97f4a7c15ull;
+
+/**
+ * Hash bytes with a seeded 64-bit hash in wyhash style.
+ * Input is read in little-endian regardless of the platform,
+ * so that the result is the same on every rank.
+ *
+ *  @param data   pointer to a bytes array
+ *  @param size   size of the array
+ *  @param seed   seed of the hash
+ */
+std::uint64_t hash_bytes(const char*, size_t, std::uint64_t seed = kHashSeed);
+
+/**
+ * Hash a primary key of bytes in ByteData format.
+ * This is the first part of CompositeKey, otherwise whole data.
+ *
+ *  @param data   key bytes
+ */
+std::uint64_t hash_key(ByteView);
+
+/**
+ * Hash a key in the original type.
+ * This returns the same hash as the key encoded in ByteData.
+ *
+ *  @param key    key data
+ */
+template <typename K>
+std::uint64_t hash_key(const K&);
+
+/**
+ * View of key bytes with the hash computed in advance.
+ * Used for hash tables not to hash keys again.
+ */
+struct HashedView {
+  std::string_view key;
+  std::uint64_t hash;
+
+  bool operator==(const HashedView& rhs) const { return key == rhs.key; }
+
+  /** Hash function object returning the stored hash. */
+  struct Hash {
+    size_t operator()(const HashedView& view) const { return view.hash; }
+  };
+};
+
+}  // namespace data
+}  // namespace mapreduce
+
+#include "simplemapreduce/data/hash-inl.h"
+
+#endif  // SIMPLEMAPREDUCE_DATA_HASH_H_
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace mapreduce {
+namespace data {
+
+template <typename K, typename V>
+template <typename T>
+bool HashGroups<K, V>::add(T&& key, std::uint64_t hash, V&& value) {
+  if (values_.size() >= kNone)
+    throw std::length_error("Too many values in HashGroups.");
+  if ((keys_.size() + 1) * 16 > slots_.size() * kMaxLoad)
+    grow_();
+
+  /// Probe linearly from the slot of the hash until the key or an empty slot
+  size_t mask = slots_.size() - 1;
+  size_t pos = hash & mask;
+  for (; slots_[pos] != kNone; pos = (pos + 1) & mask) {
+    auto group = slots_[pos];
+    if (hashes_[group] == hash && keys_[group] == key)
+      break;
+  }
+
+  std::uint32_t index = values_.size();
+  values_.push_back(std::move(value));
+  next_.push_back(kNone);
+
+  bool is_new = slots_[pos] == kNone;
+  if (is_new) {
+    slots_[pos] = keys_.size();
+    keys_.emplace_back(std::forward<T>(key));
+    hashes_.push_back(hash);
+    heads_.push_back(index);
+    tails_.push_back(index);
+  } else {
+    /// The chain is started again if all values of the group are taken
+    auto group = slots_[pos];
+    if (heads_[group] == kNone)
+      heads_[group] = index;
+    else
+      next_[tails_[group]] = index;
+    tails_[group] = index;
+  }
+  return is_new;
+}
+
+template <typename K, typename V>
+void HashGroups<K, V>::take(size_t group, std::vector<V>& out) {
+  for (auto index = heads_[group]; index != kNone; index = next_[index])
+    out.push_back(std::move(values_[index]));
+  heads_[group] = kNone;
+}
+
+template <typename K, typename V>
+bool HashGroups<K, V>::next(size_t group, V& value) {
+  /// Values taken are dropped from the head of the chain
+  auto index = heads_[group];
+  if (index == kNone)
+    return false;
+  value = std::move(values_[index]);
+  heads_[group] = next_[index];
+  return true;
+}
+
+template <typename K, typename V>
+void HashGroups<K, V>::clear() {
+  std::fill(slots_.begin(), slots_.end(), kNone);
+  keys_.clear();
+  hashes_.clear();
+  heads_.clear();
+  tails_.clear();
+  values_.clear();
+  next_.clear();
+}
+
+template <typename K, typename V>
+void HashGroups<K, V>::grow_() {
+  slots_.assign(slots_.empty() ? 16 : slots_.size() * 2, kNone);
+  size_t mask = slots_.size() - 1;
+  for (std::uint32_t group = 0; group < keys_.size(); ++group) {
+    size_t pos = hashes_[group] & mask;
+    while (slots_[pos] != kNone)
+      pos = (pos + 1) & mask;
+    slots_[pos] = group;
+  }
+}
+
+}  // namespace data
+}  // namespace mapreduce
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef SIMPLEMAPREDUCE_DATA_HASH_GROUPS_H_
+#define SIMPLEMAPREDUCE_DATA_HASH_GROUPS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace mapreduce {
+namespace data {
+
+/**
+ * Values grouped by key in a hash table with open addressing.
+ *
+ * Keys are stored in a flat array in the order of first appearance,
+ * and the table of group indices is probed linearly by key hashes given by the caller
+ * (e.g. hashes stored in RecordBatch), which are compared before the keys.
+ * Values of all groups are appended to a single array and chained group by group,
+ * so that adding a value never allocates a vector for its group.
+ * Groups are not ordered by key.
+ */
+template <typename K, typename V>
+class HashGroups {
+ public:
+  /// Group index of an empty slot or the end of a chain
+  static constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+  /// Max number of keys per slot before the table grows, in 1/16
+  static constexpr size_t kMaxLoad = 12;
+
+  /**
+   * Add a value to the group of a key.
+   *
+   *  @param key    key, or a view of a String key, which is copied only if the key is new
+   *  @param hash   hash of the key
+   *  @param value  value to add
+   *  @return       true if the key is new
+   *  @throw        std::length_error if values exceed the index range
+   */
+  template <typename T>
+  bool add(T&&, std::uint64_t, V&&);
+
+  /** Get number of groups. */
+  size_t size() const { return keys_.size(); }
+
+  /** Get number of values of all groups. */
+  size_t n_values() const { return values_.size(); }
+
+  bool empty() const { return keys_.empty(); }
+
+  /** Get the key of a group, in the order of first appearance. */
+  K& key(size_t group) { return keys_[group]; }
+
+  /**
+   * Move values of a group to a vector in the order added.
+   *
+   *  @param group  index of the group
+   *  @param out    vector to append the values
+   */
+  void take(size_t, std::vector<V>&);
+
+  /**
+   * Move the next value of a group in the order added.
+   *
+   *  @param group  index of the group
+   *  @param value  variable to store the value
+   *  @return       false if no value of the group is left
+   */
+  bool next(size_t, V&);
+
+  /** Remove all groups, keeping the memory of the table. */
+  void clear();
+
+ private:
+  /** Double the table and insert the groups again by the stored hashes. */
+  void grow_();
+
+  /// Table of group indices
+  std::vector<std::uint32_t> slots_;
+
+  /// Keys, hashes and the first and last values of each group
+  std::vector<K> keys_;
+  std::vector<std::uint64_t> hashes_;
+  std::vector<std::uint32_t> heads_;
+  std::vector<std::uint32_t> tails_;
+
+  /// Values of all groups and the next value of the same group
+  std::vector<V> values_;
+  std::vector<std::uint32_t> next_;
+};
+
+}  // namespace data
+}  // namespace mapreduce
+
+#include "simplemapreduce/data/hash_groups-inl.h"
+
+#endif  // SIMPLEMAPREDUCE_DATA_HASH_GROUPS_H_
\ No newline at end of file
@@ -1,14 +1,18 @@
 #ifndef SIMPLEMAPREDUCE_DATA_QUEUE_H_
 #define SIMPLEMAPREDUCE_DATA_QUEUE_H_
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
-#include <deque>
+#include <filesystem>
+#include <fstream>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <utility>
 
+#include "simplemapreduce/data/batch.h"
 #include "simplemapreduce/data/bytes.h"
 
 namespace mapreduce {
@@ -16,14 +20,54 @@ namespace data {
 
 /**
  * FIFO queue to store key/value byte data.
+ * Records are passed in RecordBatch and an empty batch is used as end signal.
+ *
+ * The queue is a single-producer/single-consumer ring made of fixed size segments,
+ * whose slots are published and taken with atomic counters without a lock between
+ * the producer and the consumer, so that the consumer never blocks the producer.
+ * The roles can be handed over to other threads when the handover is synchronized
+ * (e.g. Mapper -> Combiner via std::future), and concurrent producers are
+ * serialized by a mutex, which is uncontended in the normal pipeline.
+ * The consumer spins for a while and then sleeps until new data is published.
+ *
+ * Memory usage can be bounded by set_max_bytes().
+ * Once batches in memory exceed the limit, following batches are written to
+ * spill files until the consumer catches up, and the files are replayed in order.
+ * Producers are never blocked, since a task can be the producer of the queue
+ * which it is consuming (e.g. Shuffle sending local records back).
  */
 class MessageQueue {
  public:
-  MessageQueue() {};
-  MessageQueue(const MessageQueue&);
+  /// Number of batches stored in a segment of the ring
+  static constexpr size_t kSegmentSize = 64;
 
+  MessageQueue();
+  ~MessageQueue();
+
+  MessageQueue(const MessageQueue&) = delete;
+  MessageQueue &operator=(const MessageQueue&) = delete;
+
+  /**
+   * Limit the size of batches held in memory.
+   * This must be called before sending data.
+   *
+   *  @param max_bytes  max bytes of batches held in memory, 0 for unlimited
+   *  @param prefix     path prefix of spill files
+   */
+  void set_max_bytes(size_t, const std::filesystem::path&);
+
+  /**
+   * Receive a record.
+   * Once reached the end signal, return a pair of empty data.
+   */
   mapreduce::data::BytePair receive();
 
+  /**
+   * Receive records in a batch.
+   * Once reached the end signal, return an empty batch.
+   */
+  mapreduce::data::RecordBatch receive_batch();
+
   /**
    * Send data to storage.
    * The format can be either
@@ -33,15 +77,84 @@ class MessageQueue {
   void send(mapreduce::data::ByteData&&, mapreduce::data::ByteData&&);
   void send(mapreduce::data::BytePair&&);
 
+  /**
+   * Send records in a batch.
+   * Empty batch is ignored, use end() to signal the end.
+   */
+  void send_batch(mapreduce::data::RecordBatch&&);
+
   /**
    * Signal as end of pushing new data.
-   * This is simply pushing empty data pair to the end of the queue.
+   * This is simply pushing empty batch to the end of the queue.
    */
   void end();
 
  private:
-  std::deque<mapreduce::data::BytePair> queue_;
-  std::mutex mq_mutex_;
+  /** Entry of the ring, either a batch or a path of spilled batches. */
+  struct Slot {
+    mapreduce::data::RecordBatch batch;
+    std::filesystem::path spill;
+  };
+
+  struct Segment {
+    std::array<Slot, kSegmentSize> slots;
+    std::atomic<Segment*> next{nullptr};
+  };
+
+  /** Send a batch to memory or spill file depending on the memory usage. */
+  void send_(mapreduce::data::RecordBatch&&);
+
+  /** Publish a slot to the tail of the ring. */
+  void push_(Slot&&);
+
+  /** Close the current spill file and publish it. */
+  void close_spill_();
+
+  /** Take a batch from the head of the ring, wait until it is published. */
+  mapreduce::data::RecordBatch pop_();
+
+  /** Take a slot from the head of the ring. */
+  Slot pop_slot_();
+
+  /** Wait until the producer publishes a batch not read yet. */
+  void wait_();
+
+  /// Number of batches published by the producer and taken by the consumer.
+  /// Each counter is on a separate cache line to avoid false sharing.
+  alignas(64) std::atomic<size_t> n_written_{0};
+  alignas(64) std::atomic<size_t> n_read_{0};
+
+  /// Producer side
+  alignas(64) Segment* tail_;
+  size_t tail_index_{0};
+  std::mutex producer_mutex_;
+
+  /// Memory limit and size of batches in memory
+  size_t max_bytes_{0};
+  std::atomic<size_t> bytes_{0};
+
+  /// Spill file being written by the producer
+  std::filesystem::path spill_prefix_;
+  std::filesystem::path spill_path_;
+  std::ofstream spill_out_;
+  size_t spill_bytes_{0};
+  size_t n_spills_{0};
+
+  /// Consumer side
+  alignas(64) Segment* head_;
+  size_t head_index_{0};
+
+  /// Spill file being replayed by the consumer
+  std::filesystem::path replay_path_;
+  std::ifstream replay_in_;
+
+  /// Batch being read by receive() and the index of the next record
+  mapreduce::data::RecordBatch current_;
+  size_t cursor_{0};
+
+  /// Used only while the consumer is sleeping on an empty queue
+  std::atomic<bool> waiting_{false};
+  std::mutex wait_mutex_;
   std::condition_variable cond_;
 };
 
@@ -25,6 +25,12 @@ class LocalJobManager : public mapreduce::base::JobManager {
    */
   void start_reducer_tasks();
 
+  /**
+   * Assign groups to reduce to available workers one by one,
+   * so that workers finished earlier take more groups.
+   */
+  void assign_groups();
+
   /**
    * Search available worker except master and return the worker ID as MPI_Rank.
    * If not node is available, return -1
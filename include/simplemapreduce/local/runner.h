@@ -2,8 +2,12 @@
 #define SIMPLEMAPREDUCE_LOCAL_RUNNER_H_
 
 #include <filesystem>
+#include <future>
+#include <memory>
 
 #include "simplemapreduce/base/job_runner.h"
+#include "simplemapreduce/data/queue.h"
+#include "simplemapreduce/proc/sampler.h"
 
 namespace mapreduce {
 namespace local {
@@ -29,17 +33,54 @@ class LocalJobRunner : public mapreduce::base::JobRunner {
   void run_map_tasks();
 
   /**
-   * Execute shuffle tasks on child nodes
+   * Execute shuffle tasks on child nodes.
+   * If the shuffle is already running with map tasks, wait for it.
    */
   void run_shuffle_tasks();
 
   /**
-   * Execute reduce tasks on child nodes
+   * Create a shuffle task to store records for this worker to the reducer queue.
+   */
+  std::unique_ptr<mapreduce::proc::ShuffleTask> get_shuffle();
+
+  /**
+   * Check if the shuffle can run while map tasks write the data.
+   * It cannot when the shuffle needs all map outputs first (combiner, sampled ranges),
+   * or when MPI is not allowed to be called from the shuffle thread.
+   */
+  bool can_overlap_shuffle() const;
+
+  /**
+   * Check if hot keys are salted at shuffle.
+   * Salted keys are merged on the group of the key after reduce,
+   * which needs the default Partitioner, outputs of Reducer to be reduced again,
+   * and each group to be on the worker of the same rank.
+   */
+  bool can_salt_hot_keys() const;
+
+  /**
+   * Report hot keys found at shuffle to the master,
+   * and pass hot keys found on all workers to the reducer.
+   */
+  void share_hot_keys();
+
+  /**
+   * Execute reduce tasks on child nodes.
+   * With shuffle via files, groups are assigned by the master one by one.
    */
   void run_reduce_tasks();
 
   /// Output file path to write results
   std::filesystem::path output_fpath_;
+
+  /// Queue of shuffled records consumed by the reducer
+  std::shared_ptr<mapreduce::data::MessageQueue> reduce_mq_ = nullptr;
+
+  /// Shuffle running concurrently with map tasks
+  std::future<void> shuffle_ftr_;
+
+  /// Sketch of shuffled keys to find hot keys, or nullptr not to salt keys
+  std::shared_ptr<mapreduce::proc::HotKeySketch> sketch_ = nullptr;
 };
 
 }  // namespace local
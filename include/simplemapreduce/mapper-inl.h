@@ -2,16 +2,38 @@ namespace mapreduce {
 
 template <typename IK, typename IV, typename OK, typename OV>
 std::unique_ptr<mapreduce::Context<OK, OV>> Mapper<IK, IV, OK, OV>::get_context() {
-  std::unique_ptr<mapreduce::proc::MQWriter> writer = std::make_unique<mapreduce::proc::MQWriter>(get_mq());
+  std::unique_ptr<mapreduce::proc::MQWriter> writer =
+    std::make_unique<mapreduce::proc::TypedMQWriter<OK, OV>>(get_mq(), mapreduce::data::RecordBatch::kDefaultCapacity);
+
+  /// Sample keys over all map tasks on this worker to split ranges for sorted output
+  if (conf_->sort_output) {
+    if (sampler_ == nullptr)
+      sampler_ = std::make_shared<mapreduce::proc::KeySampler>(mapreduce::proc::KeySampler::kDefaultCapacity, conf_->worker_rank);
+    writer->set_sampler(sampler_);
+  }
   return std::make_unique<mapreduce::Context<OK, OV>>(std::move(writer));
 }
 
 template <typename IK, typename IV, typename OK, typename OV>
 std::unique_ptr<mapreduce::proc::ShuffleTask> Mapper<IK, IV, OK, OV>::get_shuffle() {
-  std::unique_ptr<mapreduce::proc::ShuffleTask> shuffle = std::make_unique<mapreduce::proc::Shuffle<OK, OV>>(get_mq(), conf_);
+  auto partitioner = std::dynamic_pointer_cast<mapreduce::Partitioner<OK>>(partitioner_);
+  if (partitioner_ != nullptr && partitioner == nullptr)
+    throw std::runtime_error("Key type of Partitioner does not match the output key of Mapper.");
+
+  /// Send data over MPI unless workers share tmpdir to exchange files
+  std::unique_ptr<mapreduce::proc::ShuffleTask> shuffle;
+  if (conf_->mpi_shuffle)
+    shuffle = std::make_unique<mapreduce::proc::MPIShuffle<OK, OV>>(get_mq(), conf_, std::move(partitioner));
+  else
+    shuffle = std::make_unique<mapreduce::proc::Shuffle<OK, OV>>(get_mq(), conf_, std::move(partitioner));
   return shuffle;
 };
 
+template <typename IK, typename IV, typename OK, typename OV>
+void Mapper<IK, IV, OK, OV>::set_range_partitioner(std::vector<std::string> splits) {
+  partitioner_ = std::make_shared<mapreduce::RangePartitioner<OK>>(std::move(splits));
+}
+
 template <typename IK, typename IV, typename OK, typename OV>
 void Mapper<IK, IV, OK, OV>::run(mapreduce::data::ByteData& key, mapreduce::data::ByteData& value) {
   this->map(key.get_data<IK>(), value.get_data<IV>(), *(this->get_context()));
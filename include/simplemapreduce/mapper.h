@@ -2,7 +2,9 @@
 #define SIMPLEMAPREDUCE_MAPPER_H_
 
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "simplemapreduce/commons.h"
 #include "simplemapreduce/base/job_tasks.h"
@@ -38,6 +40,13 @@ class Mapper : public mapreduce::base::MapTask {
    */
   std::unique_ptr<mapreduce::proc::ShuffleTask> get_shuffle() override;
 
+  /**
+   * Partition keys by ranges at shuffle.
+   *
+   *  @param splits  split points of the ranges in primary key bytes
+   */
+  void set_range_partitioner(std::vector<std::string>) override;
+
   /**
    * Run map task
    *
@@ -3,6 +3,8 @@
 
 #include <filesystem>
 
+#include "simplemapreduce/config.h"
+
 namespace mapreduce {
 
   /**
@@ -15,6 +17,18 @@ namespace mapreduce {
     /* # of worker to run tasks */   int worker_size{0};
     /* Current worker rank */        int worker_rank{0};
     /* Current MPI world rank */     int mpi_rank{0};
+    /* Node-local directory of this process to spill data over memory limits */ std::filesystem::path spill_dirpath{"./_tmp/spill"};
+    /* Max bytes of queue in memory, 0 for unlimited */ size_t mq_max_bytes{size_t(256) << 20};
+    /* Max bytes of records grouped in memory at reduce, 0 for unlimited */ size_t sort_max_bytes{size_t(1) << 30};
+    /* Front code sorted keys */     bool front_coding{false};
+    /* Sort intermediate files in runs to merge at reduce */ bool sort_runs{true};
+    /* Codec of shuffled data and output files */ mapreduce::Compression compression{mapreduce::Compression::none};
+    /* Shuffle over MPI, otherwise files in shared tmpdir */ bool mpi_shuffle{true};
+    /* Range partition by sampled keys so that output files are globally sorted */ bool sort_output{false};
+    /* # of groups to spread each hot key, or 0 not to salt keys */ int hot_key_salts{0};
+    /* MPI can be called from multiple threads */ bool mpi_thread_multiple{false};
+    /* Group values at reduce by sorting keys, or by hashing keys without order */ mapreduce::Grouping grouping{mapreduce::Grouping::sort};
+    /* # of threads to reduce keys of a group in parallel */ int reduce_threads{1};
   };
 
 }  // namespace mapreduce
@@ -7,20 +7,33 @@
 
 namespace mapreduce {
 
+template <typename K, typename V>
+Context<K, V>::Context(std::unique_ptr<mapreduce::proc::Writer> writer) : writer_(std::move(writer)) {
+  typed_writer_ = dynamic_cast<mapreduce::proc::TypedWriter<K, V>*>(writer_.get());
+}
+
 template <typename K, typename V>
 Context<K, V>::Context(Context&& rhs) {
   this->writer_ = std::move(rhs.writer_);
+  this->typed_writer_ = rhs.typed_writer_;
+  rhs.typed_writer_ = nullptr;
 }
 
 template <typename K, typename V>
 Context<K, V>& Context<K, V>::operator=(Context&& rhs) {
   this->writer_ = std::move(rhs.writer_);
+  this->typed_writer_ = rhs.typed_writer_;
+  rhs.typed_writer_ = nullptr;
   return *this;
 }
 
 template <typename K, typename V>
 void Context<K, V>::write(K& key, V& value) const {
-  writer_->write(mapreduce::data::ByteData{std::move(key)}, mapreduce::data::ByteData{std::move(value)});
+  /// Skip encoding if the data is consumed in the same types
+  if (typed_writer_ != nullptr)
+    typed_writer_->write(std::move(key), std::move(value));
+  else
+    writer_->write(mapreduce::data::ByteData{std::move(key)}, mapreduce::data::ByteData{std::move(value)});
 }
 
 } // namespace mapreduce
\ No newline at end of file
@@ -16,7 +16,14 @@ namespace mapreduce {
 template <typename K, typename V>
 class Context {
  public:
-  Context(std::unique_ptr<mapreduce::proc::Writer> writer) : writer_(std::move(writer)) {}
+  /**
+   * Constructor.
+   * If the writer also implements TypedWriter<K, V>,
+   * data is passed to the writer without byte encoding.
+   *
+   *  @param writer   writer to send data
+   */
+  Context(std::unique_ptr<mapreduce::proc::Writer>);
 
   Context(const Context&) = delete;
   Context &operator=(const Context&) = delete;
@@ -34,6 +41,9 @@ class Context {
 
  private:
   std::unique_ptr<mapreduce::proc::Writer> writer_ = nullptr;
+
+  /// Same object as writer_ if it takes data in the original types
+  mapreduce::proc::TypedWriter<K, V>* typed_writer_ = nullptr;
 };
 
 } // namespace mapreduce
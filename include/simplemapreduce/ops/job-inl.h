@@ -33,6 +33,15 @@ void Job::set_reducer() {
     job_runner_->set_reducer(std::make_unique<Reducer>());
 }
 
+template <class Partitioner>
+void Job::set_partitioner() {
+  static_assert(std::is_base_of<mapreduce::base::PartitionTask, Partitioner>::value,
+                "Invalid Partitioner Class");
+
+  if (!is_master_)
+    job_runner_->set_partitioner(std::make_unique<Partitioner>());
+}
+
 template <int N>
 void Job::set_config(mapreduce::Config key, char value[N]) {
   set_config(key, std::string(value));
@@ -75,6 +75,12 @@ class Job {
    */
   template <class> void set_reducer();
 
+  /**
+   * Setup Partitioner to decide a group of each intermediate key.
+   * If not set, keys are partitioned by the hash.
+   */
+  template <class> void set_partitioner();
+
   /**
    * Start MapReduce job.
    *
@@ -90,6 +96,13 @@ class Job {
    */
   void start_up();
 
+  /**
+   * Get a spill directory of this process, which is unique among processes on the node.
+   *
+   *  @param parent   node-local directory to make the spill directory in
+   */
+  std::filesystem::path get_spill_dirpath(const std::filesystem::path&) const;
+
   /**
    * Clean up all files and directory in a tmp directory.
    * If the tmp directory does not exist, create a new one.
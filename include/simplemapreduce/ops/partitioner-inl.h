@@ -0,0 +1,14 @@
+#include <algorithm>
+#include <string_view>
+
+namespace mapreduce {
+
+template <typename K>
+int RangePartitioner<K>::partition(const K& key, std::uint64_t, int n_groups) const {
+  return mapreduce::data::visit_primary_key(key, [&](mapreduce::data::ByteView view) {
+    auto found = std::upper_bound(splits_.begin(), splits_.end(), std::string_view(view));
+    return std::min(static_cast<int>(found - splits_.begin()), n_groups - 1);
+  });
+}
+
+}  // namespace mapreduce
\ No newline at end of file
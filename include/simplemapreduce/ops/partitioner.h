@@ -0,0 +1,81 @@
+#ifndef SIMPLEMAPREDUCE_OPS_PARTITIONER_H_
+#define SIMPLEMAPREDUCE_OPS_PARTITIONER_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "simplemapreduce/data/bytes.h"
+
+namespace mapreduce {
+namespace base {
+
+/** Base class of Partitioner to hold it regardless of the key type. */
+class PartitionTask {
+ public:
+  virtual ~PartitionTask() = default;
+};
+
+}  // namespace base
+
+/**
+ * Decide a group (reducer) of each intermediate key at shuffle.
+ * Register to Job with Job::set_partitioner<...>().
+ * The key type must be the same as the output key type of Mapper.
+ */
+template <typename /* Intermediate key type */ KeyType>
+class Partitioner : public mapreduce::base::PartitionTask {
+ public:
+  /**
+   * Get a group ID of the key.
+   *
+   *  @param key       intermediate key data
+   *  @param hash      hash of the key computed by mapreduce::data::hash_key
+   *  @param n_groups  number of groups
+   *  @return          group ID in [0, n_groups)
+   */
+  virtual int partition(const KeyType&, std::uint64_t, int) const = 0;
+};
+
+/**
+ * Partition keys by the hash, which is the default of Shuffle.
+ * Useful as a fallback for keys not routed by a custom Partitioner.
+ */
+template <typename KeyType>
+class HashPartitioner : public Partitioner<KeyType> {
+ public:
+  int partition(const KeyType&, std::uint64_t hash, int n_groups) const override {
+    return hash % n_groups;
+  }
+};
+
+/**
+ * Partition keys by ranges so that groups are ordered by the keys.
+ * Keys are compared with split points in the primary key bytes by memcmp,
+ * which is the same order as the keys in the original type.
+ * The primary key is the first data of CompositeKey, and whole bytes of any other key type.
+ * This is used for globally sorted output (see Config::sort_output).
+ */
+template <typename KeyType>
+class RangePartitioner : public Partitioner<KeyType> {
+ public:
+  /**
+   * Constructor.
+   *
+   *  @param splits  primary key bytes in ascending order.
+   *                 Keys in [splits[i-1], splits[i]) are assigned to group i.
+   */
+  RangePartitioner(std::vector<std::string> splits) : splits_(std::move(splits)) {};
+
+  int partition(const KeyType&, std::uint64_t, int) const override;
+
+ private:
+  std::vector<std::string> splits_;
+};
+
+}  // namespace mapreduce
+
+#include "simplemapreduce/ops/partitioner-inl.h"
+
+#endif  // SIMPLEMAPREDUCE_OPS_PARTITIONER_H_
\ No newline at end of file
@@ -0,0 +1,122 @@
+#ifndef SIMPLEMAPREDUCE_OPS_VALUE_RANGE_H_
+#define SIMPLEMAPREDUCE_OPS_VALUE_RANGE_H_
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace mapreduce {
+
+/**
+ * Values of a key streamed to Reducer::reduce.
+ *
+ * Values are decoded from the grouped records (e.g. the merge of sorted runs) as they are iterated,
+ * so that all values of a key are not held in memory at once.
+ * The range is single-pass: copies of the range share the position, and values cannot be read twice.
+ * Values left unread are skipped after reduce returns.
+ */
+template <typename V>
+class ValueRange {
+ public:
+  /** Source of values of a key. */
+  class Source {
+   public:
+    virtual ~Source() = default;
+
+    /**
+     * Move the next value.
+     *
+     *  @param value  variable to store the value
+     *  @return       false if no value is left
+     */
+    virtual bool next(V&) = 0;
+  };
+
+  /** Input iterator holding the current value. */
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = V;
+    using difference_type = std::ptrdiff_t;
+    using pointer = V*;
+    using reference = V&;
+
+    iterator() = default;
+    explicit iterator(Source* source) : source_(source) { ++*this; }
+
+    /// The value can be moved out, since it is not read again
+    V& operator*() { return value_; }
+    const V& operator*() const { return value_; }
+    V* operator->() { return &value_; }
+
+    iterator& operator++() {
+      if (source_ != nullptr && !source_->next(value_))
+        source_ = nullptr;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator it(*this);
+      ++*this;
+      return it;
+    }
+
+    /// Iterators are equal only at the end, or on the same source
+    bool operator==(const iterator& other) const { return source_ == other.source_; }
+    bool operator!=(const iterator& other) const { return source_ != other.source_; }
+
+   private:
+    Source* source_ = nullptr;
+    V value_{};
+  };
+
+  /**
+   * Constructor.
+   *
+   *  @param source   source of values, which must outlive the range
+   */
+  explicit ValueRange(Source& source) : source_(&source) {}
+
+  /** Start reading values. This can be called only once. */
+  iterator begin() { return iterator(source_); }
+  iterator end() { return iterator(); }
+
+  /**
+   * Move the next value without an iterator.
+   *
+   *  @param value  variable to store the value
+   *  @return       false if no value is left
+   */
+  bool next(V& value) { return source_->next(value); }
+
+ private:
+  Source* source_;
+};
+
+/** Source of values moved out of a vector one by one. */
+template <typename V>
+class VectorValueSource : public ValueRange<V>::Source {
+ public:
+  /**
+   * Constructor.
+   *
+   *  @param values   values to move out, which must outlive the source
+   */
+  VectorValueSource(std::vector<V>& values) : values_(values) {}
+
+  bool next(V& value) override {
+    if (pos_ == values_.size())
+      return false;
+    value = std::move(values_[pos_++]);
+    return true;
+  }
+
+ private:
+  std::vector<V>& values_;
+  size_t pos_{0};
+};
+
+}  // namespace mapreduce
+
+#endif  // SIMPLEMAPREDUCE_OPS_VALUE_RANGE_H_
\ No newline at end of file
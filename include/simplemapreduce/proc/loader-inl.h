@@ -1,9 +1,12 @@
+#include <algorithm>
+
 #include "simplemapreduce/commons.h"
+
 namespace mapreduce {
 namespace proc {
 
 template <typename T, std::enable_if_t<!std::is_arithmetic<T>::value, bool>>
-mapreduce::data::ByteData load_byte_data(std::ifstream& fin) {
+mapreduce::data::ByteData load_byte_data(std::istream& fin) {
   /// Read data from CompositeKey
   mapreduce::type::Size_t data_size;
   fin.read(reinterpret_cast<char*>(&data_size), sizeof(mapreduce::type::Size_t));
@@ -20,55 +23,99 @@ mapreduce::data::ByteData load_byte_data(std::ifstream& fin) {
 }
 
 template <typename K, typename V>
-BinaryFileDataLoader<K, V>::BinaryFileDataLoader(std::shared_ptr<mapreduce::JobConf> conf) : conf_(conf) {
+mapreduce::data::BytePair RunReader::get_item() {
+  mapreduce::data::ByteData key, value;
+  key.set_bytes<K>(key_.data(), key_.size());
+  value.set_bytes<V>(buffer_.data() + value_pos_, value_size_);
+  return std::make_pair(std::move(key), std::move(value));
+}
+
+template <typename K, typename V>
+BinaryFileDataLoader<K, V>::BinaryFileDataLoader(std::shared_ptr<mapreduce::JobConf> conf, int id)
+    : id_(id < 0 ? conf->worker_rank : id), conf_(conf) {
   extract_target_files();
-  fin_.open(fpaths_.back(), std::ios::binary);
-  fpaths_.pop_back();
+
+  /// Keep only files in plain format to read sequentially
+  files_.erase(std::remove_if(files_.begin(), files_.end(), [this](auto& fin) { return add_runs_(*fin); }),
+               files_.end());
+  sorted_ = files_.empty();
+
+  for (auto& run: runs_) {
+    if (run->next())
+      heap_.push(run.get());
+  }
+  open_next_();
 };
 
 template <typename K, typename V>
-void BinaryFileDataLoader<K, V>::extract_target_files() {
-  for (auto& p: std::filesystem::directory_iterator(conf_->tmpdir)) {
-    if (!p.is_regular_file())
-      continue;
+bool BinaryFileDataLoader<K, V>::open_next_() {
+  if (files_.empty())
+    return false;
 
-    /// Get file id from file name
-    std::string fname = p.path().string();
+  fin_ = std::move(files_.back());
+  files_.pop_back();
+  return true;
+}
 
-    unsigned int idx = fname.find_last_of("-");
+template <typename K, typename V>
+bool BinaryFileDataLoader<K, V>::add_runs_(mapreduce::data::InputFile& fin) {
+  /// Check the header
+  char header[kSortedRunsMagicSize];
+  fin.read(header, kSortedRunsMagicSize);
+  if (fin.gcount() != kSortedRunsMagicSize
+      || !std::equal(header, header + kSortedRunsMagicSize, kSortedRunsMagic)) {
+    fin.clear();
+    fin.seekg(0);
+    return false;
+  }
 
-    /// Continue if a given file name is not valid format.
-    if (idx > fname.length())
-      continue;
+  /// Each run starts with the number of records and the size in bytes
+  std::uint64_t n_records, n_bytes;
+  while (read_varint(fin, n_records) && read_varint(fin, n_bytes)) {
+    std::streamoff offset = fin.tellg();
+    runs_.push_back(std::make_unique<RunReader>(fin.share(), offset, n_records, n_bytes));
+    fin.seekg(offset + static_cast<std::streamoff>(n_bytes));
+  }
+  return true;
+}
 
-    /// Get file id from file name "{worker_id}-{file_id}"
-    int file_id = std::stoi(fname.substr(idx+1));
+template <typename K, typename V>
+void BinaryFileDataLoader<K, V>::extract_target_files() {
+  /// Intermediate files are not created if data is shuffled over MPI
+  if (!std::filesystem::exists(conf_->tmpdir))
+    return;
 
-    if ((file_id % conf_->worker_size) == conf_->worker_rank)
-      fpaths_.push_back(std::move(p.path()));
+  /// The group is read from the file of each worker without listing tmpdir
+  for (int rank = 0; rank < conf_->worker_size; ++rank) {
+    PartitionedFileReader file(shuffle_file_path(conf_->tmpdir, rank));
+    if (auto stream = file.open(id_))
+      files_.push_back(std::make_unique<mapreduce::data::InputFile>(std::move(stream)));
   }
 }
 
 template <typename K, typename V>
 mapreduce::data::BytePair BinaryFileDataLoader<K, V>::get_item() {
-  /// Load key data
-  mapreduce::data::ByteData key;
-  while (true) {
-    key = load_byte_data<K>(fin_);
-    if (fin_.eof()) {
-      fin_.close();
-
-      /// Return empty data once all data is extracted
-      if (fpaths_.empty())
-        return std::make_pair(std::move(key), mapreduce::data::ByteData());
-
-      fin_.open(fpaths_.back(), std::ios::binary);
-      fpaths_.pop_back();
-      continue;
-    }
-    break;
+  /// Records in plain files are not sorted, so return them before merging runs
+  while (fin_ != nullptr) {
+    auto key = load_byte_data<K>(*fin_);
+    if (!fin_->eof())
+      return std::make_pair(std::move(key), load_byte_data<V>(*fin_));
+
+    fin_.reset();
+    open_next_();
   }
-  return std::make_pair(std::move(key), std::move(load_byte_data<V>(fin_)));
+
+  /// Return empty data once all data is extracted
+  if (heap_.empty())
+    return mapreduce::data::BytePair();
+
+  /// Take the smallest key of all runs
+  auto run = heap_.top();
+  heap_.pop();
+  auto item = run->template get_item<K, V>();
+  if (run->next())
+    heap_.push(run);
+  return item;
 }
 
 }  // namespace proc
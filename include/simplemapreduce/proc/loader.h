@@ -1,15 +1,23 @@
 #ifndef SIMPLEMAPREDUCE_PROC_LOADER_H_
 #define SIMPLEMAPREDUCE_PROC_LOADER_H_
 
+#include <filesystem>
 #include <fstream>
+#include <istream>
 #include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "simplemapreduce/data/batch.h"
 #include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/codec.h"
 #include "simplemapreduce/data/queue.h"
 #include "simplemapreduce/ops/conf.h"
+#include "simplemapreduce/proc/writer.h"
 
 namespace mapreduce {
 namespace proc {
@@ -17,13 +25,22 @@ namespace proc {
 /**
  * Load data from binary file.
  *
- *  @param fin  input binary file stream
+ *  @param fin  input binary stream
  */
 template <typename T, std::enable_if_t<std::is_arithmetic<T>::value, bool> = true>
-mapreduce::data::ByteData load_byte_data(std::ifstream&);
+mapreduce::data::ByteData load_byte_data(std::istream&);
 
 template <typename T, std::enable_if_t<!std::is_arithmetic<T>::value, bool> = true>
-mapreduce::data::ByteData load_byte_data(std::ifstream&);
+mapreduce::data::ByteData load_byte_data(std::istream&);
+
+/**
+ * Read unsigned integer written by write_varint().
+ *
+ *  @param fin    input binary stream
+ *  @param value  variable to store the read value
+ *  @return       false if failed to read
+ */
+bool read_varint(std::istream&, std::uint64_t&);
 
 /**
  * Base abstract class of data loader.
@@ -39,21 +56,150 @@ class DataLoader {
    * Return nullptr when reached eof.
    */
   virtual mapreduce::data::BytePair get_item() = 0;
+
+  /**
+   * Return key-value pairs in a batch until read all data.
+   * Once finished reading, return an empty batch.
+   * By default, the batch is filled with items taken by get_item().
+   */
+  virtual mapreduce::data::RecordBatch get_batch();
+
+  /** Return true if items are returned in the order of key bytes. */
+  virtual bool is_sorted() const { return false; }
+
+ private:
+  /// Set true once get_batch() reached the end of data
+  bool finished_{false};
+};
+
+/**
+ * Reader of partitions in a data file written by PartitionedFileWriter.
+ * Only the index is read on construction, and the bytes of each partition
+ * are read from its segments by pread, so that streams of partitions share the file descriptor.
+ */
+class PartitionedFileReader {
+ public:
+  /// Size of bytes read from the file at once
+  static constexpr size_t kChunkBytes = 64 * 1024;
+
+  /**
+   * Constructor.
+   *
+   *  @param path   path of the data file, whose index is at PartitionedFileWriter::index_path(path)
+   *  @throw        std::runtime_error if the index is corrupted
+   */
+  PartitionedFileReader(const std::filesystem::path&);
+
+  /** Return true if the file is written, otherwise no partition is available. */
+  bool is_open() const { return fd_ != nullptr; }
+
+  /** Get number of partitions in the file. */
+  int size() const { return index_.size(); }
+
+  /**
+   * Open a seekable stream of the bytes of a partition.
+   *
+   *  @param id   partition ID
+   *  @return     stream of the partition, or nullptr if the partition is empty
+   */
+  std::shared_ptr<std::istream> open(int) const;
+
+ private:
+  /// File descriptor of the data file, closed when the reader and all streams are destroyed
+  std::shared_ptr<const int> fd_ = nullptr;
+
+  /// Segments of each partition
+  std::vector<std::vector<FileSegment>> index_;
+};
+
+/**
+ * Reader of records in a sorted run written by BinaryFileWriter.
+ * The run is read chunk by chunk so that many runs can be merged with bounded memory.
+ * Runs in the same file share the file descriptor and seek to their own offsets.
+ */
+class RunReader {
+ public:
+  /// Size of bytes read from the file at once
+  static constexpr size_t kChunkBytes = 16384;
+
+  /**
+   * Constructor.
+   *
+   *  @param fin        file stream of the run, which may share the file with other runs
+   *  @param offset     offset of the first record in the file
+   *  @param n_records  number of records in the run
+   *  @param n_bytes    size of the records in bytes
+   */
+  RunReader(std::shared_ptr<std::istream> fin, std::streamoff offset, std::uint64_t n_records, std::uint64_t n_bytes)
+    : fin_(fin), offset_(offset), n_records_(n_records), n_bytes_(n_bytes) {}
+
+  /**
+   * Move to the next record.
+   *
+   *  @return   false if no record is left
+   */
+  bool next();
+
+  /** Get key bytes of the current record. */
+  std::string_view key() const { return key_; }
+
+  /** Get value bytes of the current record. */
+  std::string_view value() const { return std::string_view(buffer_.data() + value_pos_, value_size_); }
+
+  /** Copy the current record in ByteData of the given types. */
+  template <typename K, typename V>
+  mapreduce::data::BytePair get_item();
+
+ private:
+  /**
+   * Make bytes available in the buffer, reading the next chunk if needed.
+   *
+   *  @param size   number of bytes needed from the current position
+   *  @return       false if the run is shorter than the size
+   */
+  bool fill_(size_t);
+
+  /** Read unsigned integer written by write_varint() from the buffer. */
+  bool read_varint_(std::uint64_t&);
+
+  std::shared_ptr<std::istream> fin_;
+
+  /// Offset of bytes not read into the buffer yet
+  std::streamoff offset_;
+
+  /// Records and bytes of the run not read yet
+  std::uint64_t n_records_;
+  std::uint64_t n_bytes_;
+
+  /// Bytes read from the file and the current position
+  std::vector<char> buffer_;
+  size_t pos_{0};
+
+  /// Current record, whose value is in the buffer
+  std::string key_;
+  size_t value_pos_{0};
+  std::uint64_t value_size_{0};
 };
 
 /**
  * Helper class to load data from intermediate state files.
  * The data is pair of mapreduce::data::ByteData.
+ * Each worker writes a single file of all groups at shuffle,
+ * from which a group is read by PartitionedFileReader.
+ * Files written in sorted runs are detected by the header,
+ * and the runs of all files are merged so that items are returned in the order of key bytes.
+ * Files written in plain format are not sorted and returned before the merged runs.
  */
 template <typename K, typename V>
 class BinaryFileDataLoader : public DataLoader {
  public:
-  BinaryFileDataLoader(std::shared_ptr<mapreduce::JobConf>);
-  ~BinaryFileDataLoader()
-  {
-    if (fin_.is_open())
-      fin_.close();
-  }
+  /**
+   * Constructor.
+   *
+   *  @param conf   job configuration
+   *  @param id     group to load, which is the worker rank by default
+   */
+  BinaryFileDataLoader(std::shared_ptr<mapreduce::JobConf>, int id = -1);
 
   /// Copy/Move are not allowed
   BinaryFileDataLoader(const BinaryFileDataLoader&) = delete;
@@ -66,15 +212,48 @@ class BinaryFileDataLoader : public DataLoader {
    * Once finished reading, return with invalid key.
    */
   mapreduce::data::BytePair get_item();
-  
+
+  /** Items are sorted if all files are written in sorted runs. */
+  bool is_sorted() const override { return sorted_; }
+
  private:
-  /** Read key-value data from files. */
+  /** Open the partitions of the group in files written by all workers. */
   void extract_target_files();
 
-  /// Intermediate file directory
-  std::vector<std::filesystem::path> fpaths_;
+  /**
+   * Open the next file in plain format.
+   *
+   *  @return   false if no file is left
+   */
+  bool open_next_();
+
+  /**
+   * Add readers of the runs in a file if the file is written in sorted runs.
+   *
+   *  @param fin    file to check, which is rewound if in plain format
+   *  @return       false if the file is in plain format
+   */
+  bool add_runs_(mapreduce::data::InputFile&);
 
-  std::ifstream fin_;
+  /// Intermediate files in plain format
+  std::vector<std::unique_ptr<mapreduce::data::InputFile>> files_;
+
+  /// Current file in plain format
+  std::unique_ptr<mapreduce::data::InputFile> fin_;
+
+  /// Readers of sorted runs
+  std::vector<std::unique_ptr<RunReader>> runs_;
+
+  /// Runs ordered by the current key to merge
+  struct RunGreater {
+    bool operator()(const RunReader* lhs, const RunReader* rhs) const { return lhs->key() > rhs->key(); }
+  };
+  std::priority_queue<RunReader*, std::vector<RunReader*>, RunGreater> heap_;
+
+  bool sorted_{true};
+
+  /// Group to load
+  int id_;
 
   /// Job configuration
   std::shared_ptr<mapreduce::JobConf> conf_;
@@ -101,6 +280,12 @@ class MQDataLoader : public DataLoader {
    */
   mapreduce::data::BytePair get_item();
 
+  /**
+   * Return key-value pairs in a batch sent to MessageQueue.
+   * Once fetched all data, return an empty batch.
+   */
+  mapreduce::data::RecordBatch get_batch() override;
+
  private:
   std::shared_ptr<mapreduce::data::MessageQueue> mq_;
 };
@@ -0,0 +1,142 @@
+#ifndef SIMPLEMAPREDUCE_PROC_MPI_CHANNEL_H_
+#define SIMPLEMAPREDUCE_PROC_MPI_CHANNEL_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <mpi.h>
+
+#include "simplemapreduce/data/batch.h"
+#include "simplemapreduce/data/codec.h"
+#include "simplemapreduce/data/queue.h"
+#include "simplemapreduce/ops/conf.h"
+
+namespace mapreduce {
+namespace proc {
+
+/**
+ * Channel to exchange shuffled records between workers over MPI.
+ *
+ * Batches are sent to the owning worker with non-blocking sends,
+ * and each destination has two send buffers so that a batch can be filled
+ * while the previous one is in flight.
+ * Batches received from other workers are stored to the MessageQueue
+ * consumed by the reducer, which spills them to local disk over its memory limit.
+ * With JobConf::compression, each batch is compressed as a block by write_block().
+ */
+class MPIChannel {
+ public:
+  /**
+   * Constructor.
+   *
+   *  @param mq     MessageQueue to store received batches
+   *  @param conf   job configuration
+   */
+  MPIChannel(std::shared_ptr<mapreduce::data::MessageQueue>, std::shared_ptr<mapreduce::JobConf>);
+  ~MPIChannel();
+
+  MPIChannel(const MPIChannel&) = delete;
+  MPIChannel& operator=(const MPIChannel&) = delete;
+
+  /**
+   * Send a batch to a worker without waiting for the delivery.
+   * This blocks only while both buffers for the worker are in flight,
+   * and receives incoming batches meanwhile not to deadlock.
+   *
+   *  @param worker   worker rank to send the batch
+   *  @param batch    batch to send, which is cleared after the call
+   */
+  void send(int, mapreduce::data::RecordBatch&);
+
+  /** Receive all batches arrived so far without blocking. */
+  void poll();
+
+  /**
+   * Notify the end of data to all workers,
+   * then receive batches until all other workers finish sending.
+   */
+  void finish();
+
+ private:
+  /** Send buffers for a destination worker. */
+  struct Outbox {
+    std::vector<char> buffers[2];
+    MPI_Request requests[2]{MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+    /// Index of the buffer used for the next send
+    int next{0};
+  };
+
+  /** Receive a message from given source and store it to MessageQueue. */
+  void receive_(const MPI_Status&);
+
+  /** Wait for a send request while receiving incoming batches. */
+  void wait_(MPI_Request&);
+
+  std::shared_ptr<mapreduce::data::MessageQueue> mq_;
+  std::shared_ptr<mapreduce::JobConf> conf_;
+
+  /// Codec to compress batches, or nullptr
+  std::shared_ptr<mapreduce::data::Codec> codec_;
+  mapreduce::data::CompressionStats stats_;
+
+  /// Batches serialized before compression, and decompressed after receiving
+  std::vector<char> packed_;
+  std::vector<char> unpacked_;
+
+  /// Send buffers for each worker
+  std::vector<Outbox> outboxes_;
+
+  /// Buffer to receive a batch
+  std::vector<char> inbox_;
+
+  /// Number of workers which finished sending to this worker
+  int n_finished_{0};
+
+  /// True once the end of data is sent
+  bool finished_{false};
+};
+
+/**
+ * Send sampled keys to the master and receive split points broadcast by the master.
+ * Called by all workers while the master calls broadcast_split_points().
+ *
+ *  @param samples  sampled primary key bytes on this worker
+ *  @return         split points of key ranges
+ */
+std::vector<std::string> exchange_samples(const std::vector<std::string>&);
+
+/**
+ * Gather sampled keys from all workers and broadcast split points of key ranges.
+ * Called by the master.
+ *
+ *  @param conf   job configuration
+ */
+void broadcast_split_points(const mapreduce::JobConf&);
+
+/**
+ * Report hot keys to the master and receive hot keys of all workers broadcast by the master.
+ * Called by all workers while the master calls broadcast_hot_keys().
+ *
+ *  @param hot_keys   counts of hot keys by the hash on this worker
+ *  @param n_records  number of records counted on this worker
+ *  @return           hashes of hot keys on any worker
+ */
+std::unordered_set<std::uint64_t> exchange_hot_keys(const std::unordered_map<std::uint64_t, std::uint64_t>&, std::uint64_t);
+
+/**
+ * Gather hot keys from all workers and broadcast them.
+ * Called by the master.
+ *
+ *  @param conf   job configuration
+ */
+void broadcast_hot_keys(const mapreduce::JobConf&);
+
+}  // namespace proc
+}  // namespace mapreduce
+
+#endif  // SIMPLEMAPREDUCE_PROC_MPI_CHANNEL_H_
\ No newline at end of file
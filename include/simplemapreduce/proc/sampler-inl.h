@@ -0,0 +1,12 @@
+namespace mapreduce {
+namespace proc {
+
+template <typename K>
+void KeySampler::add(const K& key) {
+  size_t slot = next_slot_();
+  if (slot < capacity_)
+    mapreduce::data::visit_primary_key(key, [&](mapreduce::data::ByteView view) { store_(slot, view); });
+}
+
+}  // namespace proc
+}  // namespace mapreduce
\ No newline at end of file
@@ -0,0 +1,147 @@
+#ifndef SIMPLEMAPREDUCE_PROC_SAMPLER_H_
+#define SIMPLEMAPREDUCE_PROC_SAMPLER_H_
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "simplemapreduce/data/bytes.h"
+
+namespace mapreduce {
+namespace proc {
+
+/**
+ * Sample keys of map outputs uniformly by reservoir sampling.
+ * Keys are stored as the primary key bytes,
+ * which are compared by memcmp in the same order as the keys in the original type.
+ */
+class KeySampler {
+ public:
+  /// Default number of keys to keep on each worker
+  static constexpr size_t kDefaultCapacity = 1000;
+
+  /**
+   * Constructor.
+   *
+   *  @param capacity  max number of keys to keep
+   *  @param seed      seed of random numbers to choose keys
+   */
+  KeySampler(size_t capacity = kDefaultCapacity, std::uint64_t seed = 0)
+    : capacity_(capacity), rng_(seed) {};
+
+  /**
+   * Sample a key in the original type.
+   * The key is encoded only when it is kept.
+   *
+   *  @param key  key data
+   */
+  template <typename K>
+  void add(const K&);
+
+  /**
+   * Sample an encoded key.
+   *
+   *  @param key  key bytes in ByteData format
+   */
+  void add(mapreduce::data::ByteView);
+
+  /** Get sampled primary key bytes. */
+  const std::vector<std::string>& samples() const { return samples_; }
+
+  /** Get a number of keys seen by the sampler. */
+  size_t count() const { return count_; }
+
+ private:
+  /** Get an index to store the next key, or capacity if the key is not kept. */
+  size_t next_slot_();
+
+  /** Store the primary key bytes at the index. */
+  void store_(size_t, mapreduce::data::ByteView);
+
+  size_t capacity_;
+  size_t count_ = 0;
+  std::mt19937_64 rng_;
+  std::vector<std::string> samples_;
+};
+
+/**
+ * Find frequent keys by the Misra-Gries heavy hitters algorithm.
+ * Keys are identified by the hash stored in records (see mapreduce::data::hash_key),
+ * so that no key needs to be decoded nor copied.
+ * The count of each key is underestimated by at most (number of keys seen) / capacity.
+ */
+class HotKeySketch {
+ public:
+  /// Default number of keys seen before detecting hot keys
+  static constexpr std::uint64_t kMinCount = 1000;
+
+  /**
+   * Constructor.
+   *
+   *  @param capacity   max number of keys to count
+   *  @param min_share  share of all keys seen over which a key is hot (e.g. 0.05 for 5%)
+   *  @param min_count  number of keys seen before detecting hot keys
+   */
+  HotKeySketch(size_t capacity, double min_share, std::uint64_t min_count = kMinCount)
+    : capacity_(capacity), min_share_(min_share), min_count_(min_count) {};
+
+  /**
+   * Count a key.
+   * Once a key is detected as hot, it stays hot.
+   *
+   *  @param hash  hash of the key
+   *  @return      true if the key is hot
+   */
+  bool add(std::uint64_t);
+
+  /** Get counts of hot keys by the hash, counted since detected with the estimate at that time. */
+  const std::unordered_map<std::uint64_t, std::uint64_t>& hot_keys() const { return hot_; }
+
+  /** Get a number of keys seen by the sketch. */
+  std::uint64_t count() const { return count_; }
+
+ private:
+  size_t capacity_;
+  double min_share_;
+  std::uint64_t min_count_;
+  std::uint64_t count_ = 0;
+
+  /// Counters of candidates, and hot keys which are no longer candidates
+  std::unordered_map<std::uint64_t, std::uint64_t> counters_;
+  std::unordered_map<std::uint64_t, std::uint64_t> hot_;
+};
+
+/**
+ * Choose split points of key ranges from samples.
+ * Keys are assigned to the range i if splits[i-1] <= key < splits[i].
+ *
+ *  @param samples   sampled primary key bytes from all workers
+ *  @param n_groups  number of ranges
+ *  @return          n_groups - 1 split points in ascending order, or empty if no sample
+ */
+std::vector<std::string> split_points(std::vector<std::string>, int);
+
+/**
+ * Append keys to a byte array as (size, bytes) pairs.
+ *
+ *  @param keys  keys to write
+ *  @param out   byte array to store the keys
+ */
+void write_keys(const std::vector<std::string>&, std::vector<char>&);
+
+/**
+ * Read keys written by write_keys.
+ *
+ *  @param data  pointer to bytes
+ *  @param size  size of the bytes
+ */
+std::vector<std::string> read_keys(const char*, size_t);
+
+}  // namespace proc
+}  // namespace mapreduce
+
+#include "simplemapreduce/proc/sampler-inl.h"
+
+#endif  // SIMPLEMAPREDUCE_PROC_SAMPLER_H_
\ No newline at end of file
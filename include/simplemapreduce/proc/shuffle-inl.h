@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <filesystem>
 #include <functional>
-#include <iomanip>
-#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
 #include "simplemapreduce/util/log.h"
 using namespace mapreduce::util;
@@ -10,48 +12,176 @@ namespace mapreduce {
 namespace proc {
 
 template <typename K, typename V>
-Shuffle<K, V>::Shuffle(std::shared_ptr<mapreduce::data::MessageQueue> mq, std::shared_ptr<mapreduce::JobConf> conf)
-    : conf_(conf), mq_(std::move(mq)) {
-  std::ostringstream oss_rank;
-  oss_rank << std::setw(4) << std::setfill('0') << conf_->worker_rank;
+Shuffle<K, V>::Shuffle(std::shared_ptr<mapreduce::data::MessageQueue> mq, std::shared_ptr<mapreduce::JobConf> conf,
+                       std::shared_ptr<mapreduce::Partitioner<K>> partitioner)
+    : conf_(conf), partitioner_(std::move(partitioner)), mq_(std::move(mq)) {}
 
-  for (int i = 0; i < conf_->n_groups; ++i) {
-    /// Create each file path to store intermediate states
-    std::ostringstream oss_id;
-    oss_id << std::setw(5) << std::setfill('0') << i;
-    std::filesystem::path filename = oss_rank.str() + "-" + oss_id.str();
+template <typename K, typename V>
+int Shuffle<K, V>::partition(const K& key, std::uint64_t hash) const {
+  if (partitioner_ == nullptr)
+    return partition(hash);
 
-    /// Set writer with the file defined above
-    fouts_.push_back(std::make_unique<mapreduce::proc::BinaryFileWriter<K, V>>((conf_->tmpdir / filename).string()));
-  }
+  int id = partitioner_->partition(key, hash, conf_->n_groups);
+  if (id < 0 || id >= conf_->n_groups)
+    throw std::out_of_range("Invalid group ID from Partitioner: " + std::to_string(id));
+  return id;
+}
+
+template <typename K, typename V>
+int Shuffle<K, V>::partition(const mapreduce::data::RecordBatch& batch, size_t index) const {
+  if (partitioner_ == nullptr)
+    return partition(batch.hash(index));
+  return partition(batch.get_key<K>(index), batch.hash(index));
+}
+
+template <typename K, typename V>
+int Shuffle<K, V>::salt_(int id, std::uint64_t hash) {
+  if (this->sketch_ == nullptr || !this->sketch_->add(hash))
+    return id;
+
+  int salts = std::min(conf_->hot_key_salts, conf_->n_groups);
+  next_salt_ = (next_salt_ + 1) % salts;
+  return (id + next_salt_) % conf_->n_groups;
+}
+
+template <typename K, typename V>
+void Shuffle<K, V>::open_() {
+  /// All groups are written to a single file of this worker with the index of the groups
+  file_ = std::make_unique<mapreduce::proc::PartitionedFileWriter>(
+      shuffle_file_path(conf_->tmpdir, conf_->worker_rank), conf_->n_groups);
+
+  /// Runs are not sorted for values grouped by hash at reduce, since they are not merged in the order of keys
+  auto codec = mapreduce::data::get_codec(conf_->compression);
+  bool sorted = conf_->sort_runs && (conf_->grouping == mapreduce::Grouping::sort || conf_->sort_output);
+  for (int i = 0; i < conf_->n_groups; ++i)
+    fouts_.push_back(std::make_unique<mapreduce::proc::BinaryFileWriter<K, V>>(file_->partition(i), conf_->front_coding, sorted, codec));
+}
+
+template <typename K, typename V>
+void Shuffle<K, V>::send_(int id, K&& key, V&& value, std::uint64_t) {
+  fouts_[id]->write(mapreduce::data::ByteData{std::move(key)}, mapreduce::data::ByteData{std::move(value)});
 }
 
 template <typename K, typename V>
-int Shuffle<K, V>::hash(const mapreduce::type::String& data) {
-  return std::hash<std::string>{}(data) % conf_->n_groups;
+void Shuffle<K, V>::send_(int id, const mapreduce::data::RecordBatch& batch, size_t index) {
+  auto data = batch.get_item(index);
+  fouts_[id]->write(std::move(data.first), std::move(data.second));
+}
+
+template <typename K, typename V>
+void Shuffle<K, V>::close_() {
+  /// Flush all groups and write the index
+  mapreduce::data::CompressionStats stats;
+  for (auto& fout: fouts_) {
+    fout->close();
+    stats += fout->stats();
+  }
+  fouts_.clear();
+  file_->close();
+  file_.reset();
+
+  if (conf_->compression != mapreduce::Compression::none)
+    mapreduce::util::logger.info("[Worker] Compressed shuffled data: ", stats.raw_bytes, " bytes to ",
+                                 stats.stored_bytes, " bytes (ratio ", stats.ratio(), ") on worker ", conf_->worker_rank);
 }
 
 template <typename K, typename V>
 void Shuffle<K, V>::run() {
-  /// Get initial item and define the data type
-  auto data = mq_->receive();
-
-  /// Run until all processed and receive empty when finished the process
-  while (!data.first.empty()) {
-    int id = hash(data.first.get_key());
-    if (id == conf_->worker_rank) {
-      /// data processed on the same worker node at reduce will be stored back to MessageQueue
-      /// and retrieve it later
-      mq_->send(std::move(data));
+  if (this->out_mq_ == nullptr)
+    this->out_mq_ = mq_;
+
+  /// Open after the first data arrives, which is after the master prepared tmpdir
+  /// even if the shuffle starts before map tasks
+  auto batch = mq_->receive_batch();
+  open_();
+
+  /// Data processed on the same worker node at reduce is grouped by the sorter of the reducer if set,
+  /// otherwise stored to the output queue and retrieved later
+  mapreduce::data::RecordBatch local;
+  auto sorter = std::dynamic_pointer_cast<Sorter<K, V>>(this->local_sorter_);
+  auto keep_local = [&] {
+    if (sorter != nullptr)
+      sorter->add(local);
+    else
+      this->out_mq_->send_batch(std::move(local));
+    local.clear();
+  };
+
+  /// Run until all processed and receive empty batch when finished the process
+  for (; !batch.empty(); batch = mq_->receive_batch()) {
+    if (auto records = batch.typed<K, V>()) {
+      /// Data of this worker is kept in the original types, only data sent to others is encoded
+      for (size_t i = 0; i < records->size(); ++i) {
+        auto& [key, value] = (*records)[i];
+        auto hash = batch.hash(i);
+        int id = salt_(partition(key, hash), hash);
+        if (id == conf_->worker_rank)
+          local.emplace_back(std::move(key), std::move(value), hash);
+        else
+          send_(id, std::move(key), std::move(value), hash);
+      }
     } else {
-      fouts_[id]->write(std::move(data.first), std::move(data.second));
+      batch.encode();
+      for (size_t i = 0; i < batch.size(); ++i) {
+        int id = salt_(partition(batch, i), batch.hash(i));
+        if (id == conf_->worker_rank)
+          local.append(batch, i);
+        else
+          send_(id, batch, i);
+      }
     }
 
-    /// Get new one after processed
-    data = mq_->receive();
+    if (local.bytes() >= mapreduce::data::RecordBatch::kDefaultCapacity)
+      keep_local();
   }
 
-  mq_->end();
+  /// Data from other workers may be stored to the queue until closed
+  keep_local();
+  close_();
+  this->out_mq_->end();
+}
+
+template <typename K, typename V>
+MPIShuffle<K, V>::MPIShuffle(std::shared_ptr<mapreduce::data::MessageQueue> mq, std::shared_ptr<mapreduce::JobConf> conf,
+                             std::shared_ptr<mapreduce::Partitioner<K>> partitioner)
+    : Shuffle<K, V>(std::move(mq), std::move(conf), std::move(partitioner)) {}
+
+template <typename K, typename V>
+void MPIShuffle<K, V>::open_() {
+  channel_ = std::make_unique<mapreduce::proc::MPIChannel>(this->out_mq_, this->conf_);
+  batches_.resize(this->conf_->worker_size);
+}
+
+template <typename K, typename V>
+void MPIShuffle<K, V>::send_(int id, K&& key, V&& value, std::uint64_t hash) {
+  /// Group ID is the same as the worker rank to reduce
+  batches_[id].emplace_back(std::move(key), std::move(value), hash);
+  send_if_filled_(id);
+}
+
+template <typename K, typename V>
+void MPIShuffle<K, V>::send_(int id, const mapreduce::data::RecordBatch& batch, size_t index) {
+  batches_[id].append(batch, index);
+  send_if_filled_(id);
+}
+
+template <typename K, typename V>
+void MPIShuffle<K, V>::send_if_filled_(int id) {
+  if (batches_[id].bytes() < kSendBytes)
+    return;
+
+  channel_->send(id, batches_[id]);
+  channel_->poll();
+}
+
+template <typename K, typename V>
+void MPIShuffle<K, V>::close_() {
+  for (size_t id = 0; id < batches_.size(); ++id)
+    channel_->send(id, batches_[id]);
+
+  /// Receive all data from other workers before the end of the queue
+  channel_->finish();
+  channel_.reset();
 }
 
 }  // namespace proc
@@ -1,8 +1,10 @@
 #ifndef SIMPLEMAPREDUCE_PROC_SHUFFLE_H_
 #define SIMPLEMAPREDUCE_PROC_SHUFFLE_H_
 
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <string_view>
 #include <vector>
 
 #include "simplemapreduce/commons.h"
@@ -10,6 +12,10 @@
 #include "simplemapreduce/data/type.h"
 #include "simplemapreduce/ops/conf.h"
 #include "simplemapreduce/ops/context.h"
+#include "simplemapreduce/ops/partitioner.h"
+#include "simplemapreduce/proc/mpi_channel.h"
+#include "simplemapreduce/proc/sampler.h"
+#include "simplemapreduce/proc/sorter.h"
 #include "simplemapreduce/proc/writer.h"
 
 namespace mapreduce {
@@ -23,10 +29,48 @@ class ShuffleTask {
    * Run shuffle process.
    */
   virtual void run() = 0;
+
+  /**
+   * Set a queue to store records to reduce on this worker.
+   * If not set, the records are stored back to the input queue after its end signal.
+   * This is required to run the shuffle while the input queue is still being filled.
+   *
+   *  @param mq   queue consumed by the reducer
+   */
+  void set_output(std::shared_ptr<mapreduce::data::MessageQueue> mq) { out_mq_ = mq; }
+
+  /**
+   * Set a sketch to count keys, and spread records of hot keys
+   * over JobConf::hot_key_salts groups starting from the group of the key.
+   * The hot keys must be reduced again on the group of the key after reduce.
+   *
+   *  @param sketch  sketch shared with the caller to read hot keys after the shuffle
+   */
+  void set_sketch(std::shared_ptr<HotKeySketch> sketch) { sketch_ = sketch; }
+
+  /**
+   * Set a sorter to group records of this worker in memory instead of storing them to the output queue.
+   * The sorter is used only if it has the same key/value types as the shuffle.
+   *
+   *  @param sorter  sorter shared with the reducer of the group of this worker
+   */
+  void set_local_sorter(std::shared_ptr<SortTask> sorter) { local_sorter_ = sorter; }
+
+ protected:
+  /// Queue to store records of this worker and records received from others
+  std::shared_ptr<mapreduce::data::MessageQueue> out_mq_ = nullptr;
+
+  /// Sketch of key frequencies, or nullptr not to salt hot keys
+  std::shared_ptr<HotKeySketch> sketch_ = nullptr;
+
+  /// Sorter to group records of this worker, or nullptr to store them to the output queue
+  std::shared_ptr<SortTask> local_sorter_ = nullptr;
 };
 
 /**
  * Shuffle process handler object.
+ * Data for other workers is written to an intermediate file of this worker in tmpdir,
+ * which needs to be shared by all workers.
  */
 template <typename K, typename V>
 class Shuffle : public ShuffleTask {
@@ -34,11 +78,13 @@ class Shuffle : public ShuffleTask {
   /**
    * Shuffle constructor
    * 
-   *  @param mq     data cotainer to process
-   *  @param conf   Configuration set in Job class
+   *  @param mq           data cotainer to process
+   *  @param conf         Configuration set in Job class
+   *  @param partitioner  decide a group of each key. If nullptr, the key hash is used
    */
-  Shuffle(std::shared_ptr<mapreduce::data::MessageQueue>, std::shared_ptr<mapreduce::JobConf>);
-  ~Shuffle() {}
+  Shuffle(std::shared_ptr<mapreduce::data::MessageQueue>, std::shared_ptr<mapreduce::JobConf>,
+          std::shared_ptr<mapreduce::Partitioner<K>> = nullptr);
+  virtual ~Shuffle() {}
 
   /// Not use for copy/move and to avoid accidentaly pass objects
   Shuffle &operator=(const Shuffle&) = delete;
@@ -52,20 +98,118 @@ class Shuffle : public ShuffleTask {
    */
   void run() override;
 
- private:
+ protected:
+  /** Prepare to send data to other workers. Called at the beginning of run(). */
+  virtual void open_();
+
+  /**
+   * Send a record to other worker.
+   *
+   *  @param id     group ID of the record
+   *  @param key    key data
+   *  @param value  value data
+   *  @param hash   hash of the key
+   */
+  virtual void send_(int, K&&, V&&, std::uint64_t);
+
+  /**
+   * Send a record in a batch to other worker.
+   *
+   *  @param id     group ID of the record
+   *  @param batch  encoded batch containing the record
+   *  @param index  index of the record in the batch
+   */
+  virtual void send_(int, const mapreduce::data::RecordBatch&, size_t);
+
+  /** Finish sending data. Called once all data is processed. */
+  virtual void close_();
+
   /// Job configuration
   std::shared_ptr<mapreduce::JobConf> conf_;
 
-  /// Hash function to group the intermediate states
-  int hash(const mapreduce::type::String&);
+  /// Get a group of the intermediate states from the key hash stored in records
+  int partition(std::uint64_t hash) const { return hash % conf_->n_groups; }
+
+  /**
+   * Get a group of the key with Partitioner if set, otherwise from the hash.
+   *
+   *  @param key    key data
+   *  @param hash   hash of the key
+   */
+  inline int partition(const K&, std::uint64_t) const;
+
+  /**
+   * Get a group of the record in the encoded batch.
+   * The key is decoded only if Partitioner is set.
+   *
+   *  @param batch  encoded batch containing the record
+   *  @param index  index of the record in the batch
+   */
+  inline int partition(const mapreduce::data::RecordBatch&, size_t) const;
+
+  /**
+   * Count a key and get another group if the key is hot.
+   * Records of a hot key are assigned to groups in round robin.
+   *
+   *  @param id     group ID of the key
+   *  @param hash   hash of the key
+   */
+  inline int salt_(int, std::uint64_t);
+
+  /// Partitioner set by Job, or nullptr to partition by the hash
+  std::shared_ptr<mapreduce::Partitioner<K>> partitioner_ = nullptr;
 
   /// Message Queue to get data to process
   std::shared_ptr<mapreduce::data::MessageQueue> mq_ = nullptr;
 
+ private:
+  /// Offset from the group of the key to send the next record of hot keys
+  int next_salt_{0};
+
+  /// Intermediate file of all groups
+  std::unique_ptr<mapreduce::proc::PartitionedFileWriter> file_;
+
   /// BinaryFileWriter for each grouping after shuffled
   std::vector<std::unique_ptr<mapreduce::proc::BinaryFileWriter<K, V>>> fouts_;
 };
 
+/**
+ * Shuffle sending data for other workers over MPI.
+ * This does not need tmpdir shared by workers.
+ */
+template <typename K, typename V>
+class MPIShuffle : public Shuffle<K, V> {
+ public:
+  /// Bytes of a batch to send to a worker at once
+  static constexpr size_t kSendBytes = 16 * mapreduce::data::RecordBatch::kDefaultCapacity;
+
+  /**
+   * Constructor.
+   *
+   *  @param mq           data cotainer to process
+   *  @param conf         Configuration set in Job class
+   *  @param partitioner  decide a group of each key. If nullptr, the key hash is used
+   */
+  MPIShuffle(std::shared_ptr<mapreduce::data::MessageQueue>, std::shared_ptr<mapreduce::JobConf>,
+             std::shared_ptr<mapreduce::Partitioner<K>> = nullptr);
+
+ protected:
+  void open_() override;
+  void send_(int, K&&, V&&, std::uint64_t) override;
+  void send_(int, const mapreduce::data::RecordBatch&, size_t) override;
+  void close_() override;
+
+ private:
+  /** Send a batch to the worker if it is filled. */
+  inline void send_if_filled_(int);
+
+  /// Channel to exchange data between workers
+  std::unique_ptr<mapreduce::proc::MPIChannel> channel_ = nullptr;
+
+  /// Batches being filled for each worker
+  std::vector<mapreduce::data::RecordBatch> batches_;
+};
+
 }  // namespace proc
 }  // namespace mapreduce
 
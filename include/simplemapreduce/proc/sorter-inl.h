@@ -1,23 +1,484 @@
 #include "simplemapreduce/proc/sorter.h"
 
+#include <algorithm>
+#include <fstream>
+#include <queue>
+#include <system_error>
+
 namespace mapreduce {
 namespace proc {
 
+/** Groups of the container, whose values are moved out by value(). */
 template <typename K, typename V>
-std::unique_ptr<std::map<K, std::vector<V>>> Sorter<K, V>::run() {
+class Sorter<K, V>::ContainerSource : public Sorter<K, V>::Source {
+ public:
+  ContainerSource(std::unique_ptr<Container> container)
+    : container_(std::move(container)), groups_(sorted_groups_(*container_)) {}
+
+  bool next() override {
+    /// Values of the previous group are released
+    if (pos_ > 0)
+      std::vector<V>().swap(groups_[pos_ - 1]->second);
+    if (pos_ == groups_.size())
+      return false;
+
+    mapreduce::data::visit_bytes_(groups_[pos_++]->first, [this](mapreduce::data::ByteView bytes) {
+      key_.assign(bytes.data(), bytes.size());
+    });
+    n_taken_ = 0;
+    return true;
+  }
+
+  std::string_view key() const override { return key_; }
+
+  bool value(V& value) override {
+    auto& group = groups_[pos_ - 1]->second;
+    if (n_taken_ == group.size())
+      return false;
+    value = std::move(group[n_taken_++]);
+    return true;
+  }
+
+ private:
+  std::unique_ptr<Container> container_;
+  std::vector<typename Container::iterator> groups_;
+  size_t pos_{0};
+  size_t n_taken_{0};
+  std::string key_;
+};
+
+/** Records of a spill file. */
+template <typename K, typename V>
+class Sorter<K, V>::RunSource : public Sorter<K, V>::Source {
+ public:
+  RunSource(const Spill& spill)
+    : reader_(std::make_shared<std::ifstream>(spill.path, std::ios::binary), 0, spill.n_records, spill.n_bytes) {}
+
+  bool next() override {
+    taken_ = false;
+    return reader_.next();
+  }
+
+  std::string_view key() const override { return reader_.key(); }
+
+  bool value(V& value) override {
+    if (taken_)
+      return false;
+    auto bytes = reader_.value();
+    value = mapreduce::data::from_bytes<V>(bytes.data(), bytes.size());
+    taken_ = true;
+    return true;
+  }
+
+ private:
+  RunReader reader_;
+  bool taken_{false};
+};
+
+/** Items of a loader returning items sorted by key bytes. */
+template <typename K, typename V>
+class Sorter<K, V>::LoaderSource : public Sorter<K, V>::Source {
+ public:
+  LoaderSource(std::unique_ptr<DataLoader> loader) : loader_(std::move(loader)) {}
+
+  bool next() override {
+    item_ = loader_->get_item();
+    taken_ = false;
+    return !item_.first.empty();
+  }
+
+  std::string_view key() const override { return item_.first.view(); }
+
+  bool value(V& value) override {
+    if (taken_)
+      return false;
+    value = item_.second.get_data<V>();
+    taken_ = true;
+    return true;
+  }
+
+ private:
+  std::unique_ptr<DataLoader> loader_;
+  mapreduce::data::BytePair item_;
+  bool taken_{false};
+};
+
+/** Values of a group in HashGroups. */
+template <typename K, typename V>
+class Sorter<K, V>::HashValues : public mapreduce::ValueRange<V>::Source {
+ public:
+  HashValues(mapreduce::data::HashGroups<K, V>& groups, size_t group) : groups_(groups), group_(group) {}
+
+  bool next(V& value) override { return groups_.next(group_, value); }
+
+ private:
+  mapreduce::data::HashGroups<K, V>& groups_;
+  size_t group_;
+};
+
+/**
+ * Values of a key merged from sources in the heap.
+ * Sources are taken from the heap while they have the same key, and pushed back with their next records.
+ */
+template <typename K, typename V>
+class Sorter<K, V>::MergedValues : public mapreduce::ValueRange<V>::Source {
+ public:
+  /**
+   * Constructor.
+   *
+   *  @param heap     heap of the other sources
+   *  @param source   source of the smallest key taken from the heap
+   */
+  MergedValues(SourceHeap& heap, Source* source) : heap_(heap), source_(source), key_(source->key()) {}
+
+  bool next(V& value) override {
+    while (source_ != nullptr) {
+      if (source_->value(value))
+        return true;
+
+      if (source_->next())
+        heap_.push(source_);
+      if (heap_.empty() || heap_.top()->key() != key_) {
+        source_ = nullptr;
+        return false;
+      }
+      source_ = heap_.top();
+      heap_.pop();
+    }
+    return false;
+  }
+
+  /** Get the key bytes. */
+  const std::string& key() const { return key_; }
+
+ private:
+  SourceHeap& heap_;
+  Source* source_;
+  std::string key_;
+};
+
+template <typename K, typename V>
+Sorter<K, V>::~Sorter() {
+  std::error_code err;
+  for (auto& spill: spills_)
+    std::filesystem::remove(spill.path, err);
+}
+
+template <typename K, typename V>
+void Sorter<K, V>::set_max_bytes(size_t max_bytes, const std::filesystem::path& prefix) {
+  max_bytes_ = max_bytes;
+  spill_prefix_ = prefix;
+}
+
+template <typename K, typename V>
+void Sorter<K, V>::prepare_() {
   if (container_ == nullptr) {
-    container_ = std::make_unique<std::map<K, std::vector<V>>>();
+    container_ = std::make_unique<Container>();
+  }
+
+  /// String keys are looked up by views and copied only when a new key appears.
+  /// Views in the index refer to keys owned by the map, whose nodes are never moved.
+  if constexpr (std::is_same<K, mapreduce::type::String>::value) {
+    if (index_.empty() && grouping_ == mapreduce::Grouping::sort) {
+      for (auto& [key, values]: *container_)
+        index_.emplace(mapreduce::data::HashedView{key, mapreduce::data::hash_key(key)}, &values);
+    }
+  }
+}
+
+template <typename K, typename V>
+std::vector<V>& Sorter<K, V>::group_(std::string_view view, std::uint64_t hash) {
+  /// The index reuses key hashes stored in records instead of hashing keys again
+  auto found = index_.find(mapreduce::data::HashedView{view, hash});
+  if (found == index_.end()) {
+    auto& [key, values] = *container_->try_emplace(K(view)).first;
+    found = index_.emplace(mapreduce::data::HashedView{key, hash}, &values).first;
+    bytes_ += kGroupBytes + key.size();
+  }
+  return *found->second;
+}
+
+template <typename K, typename V>
+std::vector<V>& Sorter<K, V>::group_(K&& key) {
+  auto [it, inserted] = container_->try_emplace(std::move(key));
+  if (inserted)
+    bytes_ += kGroupBytes + mapreduce::data::approx_bytes(it->first);
+  return it->second;
+}
+
+template <typename K, typename V>
+template <typename T>
+void Sorter<K, V>::add_(T&& key, std::uint64_t hash, V&& value) {
+  bytes_ += mapreduce::data::approx_bytes(value);
+  if (grouping_ == mapreduce::Grouping::hash) {
+    size_t key_bytes;
+    if constexpr (std::is_same<K, mapreduce::type::String>::value)
+      key_bytes = std::string_view(key).size();
+    else
+      key_bytes = mapreduce::data::approx_bytes(key);
+
+    if (groups_.add(std::forward<T>(key), hash, std::move(value)))
+      bytes_ += kGroupBytes + key_bytes;
+    return;
+  }
+
+  if constexpr (std::is_same<K, mapreduce::type::String>::value)
+    group_(std::string_view(key), hash).push_back(std::move(value));
+  else
+    group_(std::forward<T>(key)).push_back(std::move(value));
+}
+
+template <typename K, typename V>
+void Sorter<K, V>::add(mapreduce::data::RecordBatch& batch) {
+  prepare_();
+  constexpr bool use_view = std::is_same<K, mapreduce::type::String>::value;
+
+  /// Records sent in the same types are moved without decoding
+  if (auto records = batch.typed<K, V>()) {
+    for (size_t i = 0; i < records->size(); ++i) {
+      auto& [key, value] = (*records)[i];
+      if constexpr (use_view)
+        add_(std::string_view(key), batch.hash(i), std::move(value));
+      else
+        add_(std::move(key), batch.hash(i), std::move(value));
+    }
+  } else {
+    batch.encode();
+    for (size_t i = 0; i < batch.size(); ++i) {
+      if constexpr (use_view)
+        add_(batch.key(i).get_view<K>(), batch.hash(i), batch.get_value<V>(i));
+      else
+        add_(batch.get_key<K>(i), batch.hash(i), batch.get_value<V>(i));
+    }
+  }
+
+  if (max_bytes_ > 0 && bytes_ > max_bytes_)
+    spill_();
+}
+
+template <typename K, typename V>
+void Sorter<K, V>::to_container_() {
+  for (size_t group = 0; group < groups_.size(); ++group)
+    groups_.take(group, (*container_)[std::move(groups_.key(group))]);
+  groups_.clear();
+  index_.clear();
+}
+
+template <typename K, typename V>
+std::vector<typename Sorter<K, V>::Container::iterator> Sorter<K, V>::sorted_groups_(Container& container) {
+  std::vector<typename Container::iterator> groups;
+  groups.reserve(container.size());
+  for (auto it = container.begin(); it != container.end(); ++it)
+    groups.push_back(it);
+
+  /// The order of the map is the order of key bytes except keys such as pairs of strings with control characters,
+  /// so that keys are sorted again only if needed
+  auto less = [](const auto& lhs, const auto& rhs) {
+    return mapreduce::data::visit_bytes_(lhs->first, [&rhs](mapreduce::data::ByteView lbytes) {
+      return mapreduce::data::visit_bytes_(rhs->first, [&lbytes](mapreduce::data::ByteView rbytes) {
+        return lbytes < rbytes;
+      });
+    });
+  };
+  if constexpr (!std::is_same<K, mapreduce::type::String>::value) {
+    if (!std::is_sorted(groups.begin(), groups.end(), less))
+      std::sort(groups.begin(), groups.end(), less);
+  }
+  return groups;
+}
+
+template <typename K, typename V>
+std::filesystem::path Sorter<K, V>::spill_path_() {
+  std::filesystem::path path = spill_prefix_.string() + "-" + std::to_string(n_spills_++);
+  if (path.has_parent_path())
+    std::filesystem::create_directories(path.parent_path());
+  return path;
+}
+
+template <typename K, typename V>
+void Sorter<K, V>::spill_() {
+  /// Groups by hash are sorted in the map to be written in the order of keys
+  if (grouping_ == mapreduce::Grouping::hash)
+    to_container_();
+  if (container_->empty())
+    return;
+
+  auto path = spill_path_();
+  RunWriter writer(path);
+  for (auto it: sorted_groups_(*container_)) {
+    mapreduce::data::visit_bytes_(it->first, [&](mapreduce::data::ByteView key) {
+      for (const auto& value: it->second)
+        mapreduce::data::visit_bytes_(value, [&](mapreduce::data::ByteView bytes) { writer.write(key, bytes); });
+    });
+  }
+  writer.close();
+  spills_.push_back(Spill{path, writer.n_records(), writer.n_bytes()});
+
+  index_.clear();
+  container_->clear();
+  bytes_ = 0;
+}
+
+template <typename K, typename V>
+void Sorter<K, V>::merge_spills_(size_t n_others) {
+  while (spills_.size() > 1 && spills_.size() + n_others > kMergeFanIn) {
+    /// Merge the oldest spills into the first one, so that values are kept in the order of spills
+    size_t n_merged = std::min(kMergeFanIn, spills_.size());
+    std::vector<std::unique_ptr<RunReader>> runs;
+    auto greater = [](const auto& lhs, const auto& rhs) {
+      return lhs.first->key() != rhs.first->key() ? lhs.first->key() > rhs.first->key() : lhs.second > rhs.second;
+    };
+    std::priority_queue<std::pair<RunReader*, size_t>, std::vector<std::pair<RunReader*, size_t>>, decltype(greater)>
+      heap(greater);
+    for (size_t i = 0; i < n_merged; ++i) {
+      auto& spill = spills_[i];
+      runs.push_back(std::make_unique<RunReader>(std::make_shared<std::ifstream>(spill.path, std::ios::binary),
+                                                 0, spill.n_records, spill.n_bytes));
+      if (runs.back()->next())
+        heap.emplace(runs.back().get(), i);
+    }
+
+    auto path = spill_path_();
+    RunWriter writer(path);
+    while (!heap.empty()) {
+      auto [run, i] = heap.top();
+      heap.pop();
+      writer.write(run->key(), run->value());
+      if (run->next())
+        heap.emplace(run, i);
+    }
+    writer.close();
+    runs.clear();
+
+    std::error_code err;
+    for (size_t i = 0; i < n_merged; ++i)
+      std::filesystem::remove(spills_[i].path, err);
+    spills_.erase(spills_.begin() + 1, spills_.begin() + n_merged);
+    spills_.front() = Spill{path, writer.n_records(), writer.n_bytes()};
+  }
+}
+
+template <typename K, typename V>
+std::vector<std::unique_ptr<typename Sorter<K, V>::Source>> Sorter<K, V>::load_() {
+  prepare_();
+
+  /// Items not sorted are grouped in memory, and sorted items are merged as they are
+  std::vector<std::unique_ptr<Source>> sources;
+  for (auto& loader: loaders_) {
+    if (loader->is_sorted()) {
+      sources.push_back(std::make_unique<LoaderSource>(std::move(loader)));
+      continue;
+    }
+
+    /// store values to vector of the associated key in map
+    for (auto batch = loader->get_batch(); !batch.empty(); batch = loader->get_batch())
+      add(batch);
+  }
+
+  loaders_.clear();
+  index_.clear();
+  return sources;
+}
+
+template <typename K, typename V>
+std::unique_ptr<std::map<K, std::vector<V>>> Sorter<K, V>::run() {
+  auto sources = load_();
+  if (sources.empty() && spills_.empty()) {
+    to_container_();
+    bytes_ = 0;
+    return std::move(container_);
+  }
+
+  auto container = std::make_unique<Container>();
+  merge_(std::move(sources), [&container](const K& key, mapreduce::ValueRange<V> values) {
+    auto& group = (*container)[key];
+    for (auto& value: values)
+      group.push_back(std::move(value));
+  });
+  return container;
+}
+
+template <typename K, typename V>
+void Sorter<K, V>::run(const std::function<void(const K&, const std::vector<V>&)>& func) {
+  /// Values are collected into a vector reused for all keys
+  std::vector<V> values;
+  merge_(load_(), [&](const K& key, mapreduce::ValueRange<V> range) {
+    values.clear();
+    for (auto& value: range)
+      values.push_back(std::move(value));
+    func(key, values);
+  });
+}
+
+template <typename K, typename V>
+void Sorter<K, V>::run(const std::function<void(const K&, mapreduce::ValueRange<V>)>& func) {
+  merge_(load_(), func);
+}
+
+template <typename K, typename V>
+void Sorter<K, V>::merge_(std::vector<std::unique_ptr<Source>> sources,
+                          const std::function<void(const K&, mapreduce::ValueRange<V>)>& func) {
+  if (grouping_ == mapreduce::Grouping::hash) {
+    /// Groups only in memory are passed without sorting keys, otherwise merged in the order of keys
+    if (sources.empty() && spills_.empty() && container_->empty()) {
+      for (size_t group = 0; group < groups_.size(); ++group) {
+        HashValues values(groups_, group);
+        func(groups_.key(group), mapreduce::ValueRange<V>(values));
+      }
+      groups_ = mapreduce::data::HashGroups<K, V>();
+      container_.reset();
+      bytes_ = 0;
+      return;
+    }
+    to_container_();
+  }
+
+  auto container = std::move(container_);
+  bytes_ = 0;
+
+  /// Groups passed to the function are released to keep only the rest in memory
+  if (sources.empty() && spills_.empty()) {
+    for (auto it: sorted_groups_(*container)) {
+      mapreduce::VectorValueSource<V> values(it->second);
+      func(it->first, mapreduce::ValueRange<V>(values));
+      std::vector<V>().swap(it->second);
+    }
+    return;
+  }
+
+  /// Values of the same key are merged in the order of the container, spills and loaders
+  merge_spills_(sources.size() + 1);
+  std::vector<std::unique_ptr<Source>> all;
+  all.push_back(std::make_unique<ContainerSource>(std::move(container)));
+  for (auto& spill: spills_)
+    all.push_back(std::make_unique<RunSource>(spill));
+  for (auto& source: sources)
+    all.push_back(std::move(source));
+
+  SourceHeap heap;
+  for (size_t i = 0; i < all.size(); ++i) {
+    all[i]->id = i;
+    if (all[i]->next())
+      heap.push(all[i].get());
   }
 
-  auto data(loader_->get_item());
+  /// Records of the same key are adjacent in the order of key bytes, and streamed to the function
+  V value;
+  while (!heap.empty()) {
+    auto source = heap.top();
+    heap.pop();
+    MergedValues values(heap, source);
+    func(mapreduce::data::from_bytes<K>(values.key().data(), values.key().size()), mapreduce::ValueRange<V>(values));
 
-  /// store values to vector of the associated key in map
-  while (!data.first.empty()) {
-    (*container_)[data.first.get_data<K>()].push_back(data.second.get_data<V>());
-    data = std::move(loader_->get_item());
+    /// Values left unread are skipped to move to the next key
+    while (values.next(value)) {}
   }
 
-  return std::move(container_);
+  all.clear();
+  std::error_code err;
+  for (auto& spill: spills_)
+    std::filesystem::remove(spill.path, err);
+  spills_.clear();
 }
 
 }  // namespace proc
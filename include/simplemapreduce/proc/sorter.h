@@ -1,54 +1,279 @@
 #ifndef SIMPLEMAPREDUCE_PROC_SORTER_H_
 #define SIMPLEMAPREDUCE_PROC_SORTER_H_
 
+#include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <map>
 #include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "simplemapreduce/commons.h"
+#include "simplemapreduce/data/batch.h"
 #include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/hash.h"
+#include "simplemapreduce/data/hash_groups.h"
 #include "simplemapreduce/proc/loader.h"
+#include "simplemapreduce/proc/writer.h"
 #include "simplemapreduce/ops/conf.h"
+#include "simplemapreduce/ops/value_range.h"
 
 namespace mapreduce {
 namespace proc {
 
+/**
+ * Base class of Sorter to pass it between tasks without the key/value types.
+ */
+class SortTask {
+ public:
+  virtual ~SortTask() = default;
+};
+
 /**
  * Sort operating class
+ *
+ * Records are grouped by key in memory. With a memory limit set by set_max_bytes(),
+ * the groups are written to a spill file as a run sorted by key bytes whenever they exceed the limit,
+ * and run(func) merges the spills, the groups left in memory and the loaders returning sorted items
+ * key by key in the order of key bytes (external merge sort).
+ * Values of each key can be streamed from the merge by ValueRange without collecting them into a vector.
+ * At most kMergeFanIn runs are merged at once, and more spills are merged into fewer files in advance.
+ *
+ * With Grouping::hash, records are grouped in HashGroups instead of the map,
+ * and passed to run(func) in the order of first appearance without sorting keys.
+ * The groups are moved to the map only to be spilled or merged with sorted items.
  */
 template <typename K, typename V>
-class Sorter {
+class Sorter : public SortTask {
  public:
+  /// Max number of sources merged at once
+  static constexpr size_t kMergeFanIn = 64;
+
+  /// Approximate size of a group in the container in addition to the key and values
+  static constexpr size_t kGroupBytes = 64;
+
   /**
    * Constructor of Sorter class.
    * This is grouping items by keywords and pass to reducer.
-   * 
+   *
    *  @param loader DataLoader unique pointer
    */
-  Sorter(std::unique_ptr<mapreduce::proc::DataLoader> loader) : loader_(std::move(loader)) {}
+  Sorter(std::unique_ptr<mapreduce::proc::DataLoader> loader) { loaders_.push_back(std::move(loader)); }
+  ~Sorter();
+
+  /// Copy/Move are not allowed
+  Sorter(const Sorter&) = delete;
+  Sorter& operator=(const Sorter&) = delete;
+
+  /**
+   * Limit the size of grouped records held in memory.
+   * This must be called before adding records.
+   *
+   *  @param max_bytes  max bytes of grouped records in memory, 0 for unlimited
+   *  @param prefix     path prefix of spill files
+   */
+  void set_max_bytes(size_t, const std::filesystem::path&);
+
+  /**
+   * Set the strategy to group records.
+   * This must be called before adding records.
+   *
+   *  @param grouping   Grouping::sort to group in the order of keys, or Grouping::hash not to sort keys
+   */
+  void set_grouping(mapreduce::Grouping grouping) { grouping_ = grouping; }
+
+  /**
+   * Add a loader to read in addition to the loader given on construction.
+   * Items of a loader returning items sorted by key bytes are merged by run(func) without grouping in memory.
+   */
+  void add_loader(std::unique_ptr<mapreduce::proc::DataLoader> loader) { loaders_.push_back(std::move(loader)); }
 
   /**
    * Execute sorting.
    * Each execution handles each file groped ID.
    * This will create a new map with values grouped by the given key.
-   * 
+   * All values are held in the map, even if they are spilled to files once.
+   *
    *  @return   map of vectors grouped by sorting process
    */
   std::unique_ptr<std::map<K, std::vector<V>>> run();
 
+  /**
+   * Execute sorting and pass each key with the grouped values in the order of key bytes.
+   * Items of loaders returning items sorted by key (e.g. sorted runs in files) and spilled groups
+   * are merged with the container key by key without building a map of all items.
+   * With Grouping::hash, keys grouped only in memory are passed in no particular order.
+   *
+   *  @param func   function called with a key and the values
+   */
+  void run(const std::function<void(const K&, const std::vector<V>&)>&);
+
+  /**
+   * Execute sorting and pass each key with a range streaming the values in the same order as run(func).
+   * Values are moved from the sources as the range is read, and values left unread are skipped.
+   *
+   *  @param func   function called with a key and the values
+   */
+  void run(const std::function<void(const K&, mapreduce::ValueRange<V>)>&);
+
   /**
    * Set initial container to be used for sorting task.
    * If this is not run, construct new map in run().
+   * The container is not counted in the memory limit.
    */
-  void set_container(std::unique_ptr<std::map<K, std::vector<V>>> container) { container_ = std::move(container); }
+  void set_container(std::unique_ptr<std::map<K, std::vector<V>>> container) {
+    container_ = std::move(container);
+    index_.clear();
+  }
+
+  /**
+   * Group records of a batch into the container without the loader.
+   * The records are grouped with the records of the loader by the next run().
+   * The container is spilled to a file if it exceeds the memory limit.
+   *
+   *  @param batch  records to group, which are moved out if typed in the same types
+   */
+  void add(mapreduce::data::RecordBatch&);
 
  private:
+  using Container = std::map<K, std::vector<V>>;
+
+  /** Source of records merged in the order of key bytes. */
+  class Source {
+   public:
+    virtual ~Source() = default;
+
+    /**
+     * Move to the next record.
+     *
+     *  @return   false if no record is left
+     */
+    virtual bool next() = 0;
+
+    /** Get key bytes of the current record. */
+    virtual std::string_view key() const = 0;
+
+    /**
+     * Move the next value of the current record.
+     *
+     *  @return   false if no value of the record is left
+     */
+    virtual bool value(V&) = 0;
+
+    /// Order of the source to merge values of the same key in the order of sources
+    size_t id{0};
+  };
+  class ContainerSource;
+  class RunSource;
+  class LoaderSource;
+
+  /** Order of sources in the heap to take the smallest key first. */
+  struct SourceGreater {
+    bool operator()(const Source* lhs, const Source* rhs) const {
+      return lhs->key() != rhs->key() ? lhs->key() > rhs->key() : lhs->id > rhs->id;
+    }
+  };
+  using SourceHeap = std::priority_queue<Source*, std::vector<Source*>, SourceGreater>;
+
+  /** Values of a key passed to ValueRange. */
+  class HashValues;
+  class MergedValues;
+
+  /** Spill file written as a run. */
+  struct Spill {
+    std::filesystem::path path;
+    std::uint64_t n_records;
+    std::uint64_t n_bytes;
+  };
+
+  /** Create the container if not set, and index String keys in the container. */
+  void prepare_();
+
+  /**
+   * Group a record.
+   *
+   *  @param key    key, or a view of a String key, which is copied only if new
+   *  @param hash   hash of the key stored in the record
+   *  @param value  value moved to the group
+   */
+  template <typename T>
+  void add_(T&&, std::uint64_t, V&&);
+
+  /** Move groups in HashGroups to the container to sort them by key. */
+  void to_container_();
+
+  /**
+   * Get values of a String key, adding the key to the container if new.
+   *
+   *  @param view   view of the key
+   *  @param hash   hash of the key stored in the record
+   */
+  std::vector<V>& group_(std::string_view, std::uint64_t);
+
+  /**
+   * Get values of a key, adding the key to the container if new.
+   *
+   *  @param key    key moved to the container if new
+   */
+  std::vector<V>& group_(K&&);
+
+  /**
+   * Group items of all loaders not sorted into the container and take the sorted ones as sources.
+   *
+   *  @return   sources of loaders returning sorted items
+   */
+  std::vector<std::unique_ptr<Source>> load_();
+
+  /**
+   * Merge the container, spills and the sources key by key.
+   *
+   *  @param sources  sources of loaders returning sorted items
+   *  @param func     function called with a key and the values
+   */
+  void merge_(std::vector<std::unique_ptr<Source>>, const std::function<void(const K&, mapreduce::ValueRange<V>)>&);
+
+  /** Write groups in the container to a spill file and release them. */
+  void spill_();
+
+  /**
+   * Merge spill files into one file until they can be merged at once with other sources.
+   *
+   *  @param n_others   number of other sources merged with the spills
+   */
+  void merge_spills_(size_t);
+
+  /** Get a path of a new spill file. */
+  std::filesystem::path spill_path_();
+
+  /** Get groups of the container in the order of key bytes. */
+  static std::vector<typename Container::iterator> sorted_groups_(Container&);
+
   /// Sorted item container
-  std::unique_ptr<std::map<K, std::vector<V>>> container_ = nullptr;
+  std::unique_ptr<Container> container_ = nullptr;
+
+  /// Values in the container by views of String keys, which are owned by the map
+  std::unordered_map<mapreduce::data::HashedView, std::vector<V>*, mapreduce::data::HashedView::Hash> index_;
+
+  /// Groups of records used instead of the container with Grouping::hash
+  mapreduce::Grouping grouping_{mapreduce::Grouping::sort};
+  mapreduce::data::HashGroups<K, V> groups_;
+
+  /// Data loaders
+  std::vector<std::unique_ptr<mapreduce::proc::DataLoader>> loaders_;
+
+  /// Memory limit and approximate size of the container
+  size_t max_bytes_{0};
+  size_t bytes_{0};
 
-  /// File data loader
-  std::unique_ptr<mapreduce::proc::DataLoader> loader_;
+  /// Runs spilled in order
+  std::filesystem::path spill_prefix_;
+  std::vector<Spill> spills_;
+  size_t n_spills_{0};
 };
 
 }  // namespace proc
@@ -1,8 +1,14 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "simplemapreduce/commons.h"
+#include "simplemapreduce/util/log.h"
 namespace mapreduce {
 namespace proc {
 
@@ -18,52 +24,201 @@ void write_binary(std::ofstream& ofs, mapreduce::type::CompositeKey<T1, T2>&& da
 }
 
 template <typename K, typename V>
-BinaryFileWriter<K, V>::BinaryFileWriter(const std::filesystem::path& path) : path_(std::move(path)) {
+BinaryFileWriter<K, V>::BinaryFileWriter(const std::filesystem::path& path, bool front_coding, bool sorted,
+                                         std::shared_ptr<mapreduce::data::Codec> codec)
+    : path_(path.string()), sorted_(sorted || front_coding), front_coding_(front_coding) {
+  /// Bytes are buffered by the writer, so bypass the stream buffer
+  fout_.rdbuf()->pubsetbuf(nullptr, 0);
   fout_.open(path_, std::ios::binary | std::ios::trunc);
+  open_(fout_.rdbuf(), codec);
 };
 
 template <typename K, typename V>
-BinaryFileWriter<K, V>::BinaryFileWriter(const std::string& path) : path_(std::move(path)) {
-  fout_.open(path_, std::ios::binary | std::ios::trunc);
+BinaryFileWriter<K, V>::BinaryFileWriter(const std::string& path, bool front_coding, bool sorted,
+                                         std::shared_ptr<mapreduce::data::Codec> codec)
+    : BinaryFileWriter(std::filesystem::path(path), front_coding, sorted, codec) {};
+
+template <typename K, typename V>
+BinaryFileWriter<K, V>::BinaryFileWriter(std::streambuf* out, bool front_coding, bool sorted,
+                                         std::shared_ptr<mapreduce::data::Codec> codec)
+    : sorted_(sorted || front_coding), front_coding_(front_coding) {
+  open_(out, codec);
 };
 
 template <typename K, typename V>
 BinaryFileWriter<K, V>::~BinaryFileWriter() {
-  fout_.close();
+  close();
+}
+
+template <typename K, typename V>
+void BinaryFileWriter<K, V>::close() {
+  if (out_ == nullptr)
+    return;
+
+  if (!run_.empty())
+    write_run_();
+  flush_(true);
+  if (compressor_ != nullptr)
+    compressor_->pubsync();
+  out_ = nullptr;
+  if (fout_.is_open())
+    fout_.close();
+}
+
+template <typename K, typename V>
+mapreduce::data::CompressionStats BinaryFileWriter<K, V>::stats() const {
+  if (compressor_ != nullptr)
+    return compressor_->stats();
+  return mapreduce::data::CompressionStats{n_written_, n_written_};
+}
+
+template <typename K, typename V>
+void BinaryFileWriter<K, V>::open_(std::streambuf* out, std::shared_ptr<mapreduce::data::Codec> codec) {
+  out_ = out;
+  if (codec != nullptr)
+    compressor_ = std::make_unique<mapreduce::data::CompressBuffer>(out_, codec);
+  buffer_.reserve(kBufferBytes + kBlockBytes);
+  if (sorted_)
+    buffer_.insert(buffer_.end(), kSortedRunsMagic, kSortedRunsMagic + kSortedRunsMagicSize);
 }
 
 template <typename K, typename V>
 void BinaryFileWriter<K, V>::write(mapreduce::data::ByteData&& key, mapreduce::data::ByteData&& value) {
-  std::lock_guard<std::mutex> lock(mapreduce::commons::mr_mutex);
+  if (sorted_) {
+    run_.append(key, value);
+    if (run_.bytes() >= kRunBytes)
+      write_run_();
+    return;
+  }
 
-  write_binary(fout_, std::move(key));
-  write_binary(fout_, std::move(value));
+  write_binary(buffer_, key);
+  write_binary(buffer_, value);
+  if (buffer_.size() >= kBufferBytes)
+    flush_(false);
 }
 
 template <typename K, typename V>
-OutputWriter<K, V>::OutputWriter(const std::filesystem::path& path) {
-  fout_.open(path, std::ios::out | std::ios::ate);
-};
+void BinaryFileWriter<K, V>::flush_(bool all) {
+  /// Keep the tail shorter than a block so that writes stay aligned in the file
+  size_t size = all ? buffer_.size() : buffer_.size() / kBlockBytes * kBlockBytes;
+  if (size == 0)
+    return;
+
+  if (compressor_ != nullptr)
+    compressor_->sputn(buffer_.data(), size);
+  else
+    out_->sputn(buffer_.data(), size);
+  n_written_ += size;
+  size_t rest = buffer_.size() - size;
+  if (rest > 0)
+    std::memmove(buffer_.data(), buffer_.data() + size, rest);
+  buffer_.resize(rest);
+}
+
+template <typename K, typename V>
+void BinaryFileWriter<K, V>::write_run_() {
+  /// Sort by key bytes, values of the same key are kept in the written order
+  std::vector<std::uint32_t> order(run_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](auto lhs, auto rhs) { return run_.key(lhs) < run_.key(rhs); });
+
+  /// Serialize the run first to write the size in bytes, so that runs are located without decoding records.
+  /// Values are prefixed by the size to be read without the type.
+  run_buffer_.clear();
+  std::string_view prev;
+  for (auto i: order) {
+    std::string_view key = run_.key(i);
+    size_t shared = 0;
+    if (front_coding_)
+      shared = std::mismatch(prev.begin(), prev.end(), key.begin(), key.end()).first - prev.begin();
+
+    write_varint(run_buffer_, shared);
+    write_varint(run_buffer_, key.size() - shared);
+    run_buffer_.insert(run_buffer_.end(), key.data() + shared, key.data() + key.size());
+
+    std::string_view value = run_.value(i);
+    write_varint(run_buffer_, value.size());
+    run_buffer_.insert(run_buffer_.end(), value.begin(), value.end());
+    prev = key;
+  }
+
+  /// Format: (# of records, # of bytes, [(shared prefix length, suffix length, suffix bytes, value size, value bytes)...])
+  write_varint(buffer_, order.size());
+  write_varint(buffer_, run_buffer_.size());
+  buffer_.insert(buffer_.end(), run_buffer_.begin(), run_buffer_.end());
+  if (buffer_.size() >= kBufferBytes)
+    flush_(false);
+  run_.clear();
+}
 
 template <typename K, typename V>
-OutputWriter<K, V>::OutputWriter(const std::string& path) {
-  fout_.open(path, std::ios::out | std::ios::ate);
+OutputWriter<K, V>::OutputWriter(const std::filesystem::path& path, std::shared_ptr<mapreduce::data::Codec> codec)
+    : path_(path.string()) {
+  file_.open(path, std::ios::out | std::ios::ate);
+  if (codec != nullptr)
+    compressor_ = std::make_unique<mapreduce::data::CompressBuffer>(file_.rdbuf(), codec);
+  fout_.rdbuf(compressor_ != nullptr ? static_cast<std::streambuf*>(compressor_.get()) : file_.rdbuf());
 };
 
+template <typename K, typename V>
+OutputWriter<K, V>::OutputWriter(const std::string& path, std::shared_ptr<mapreduce::data::Codec> codec)
+    : OutputWriter(std::filesystem::path(path), codec) {};
+
 template <typename K, typename V>
 OutputWriter<K, V>::~OutputWriter() {
-  fout_.close();
+  if (compressor_ != nullptr) {
+    compressor_->pubsync();
+    auto& stats = compressor_->stats();
+    mapreduce::util::logger.info("[Worker] Compressed output \"", path_, "\": ", stats.raw_bytes, " bytes to ",
+                                 stats.stored_bytes, " bytes (ratio ", stats.ratio(), ")");
+    compressor_.reset();
+  }
+  file_.close();
 }
 
 template <typename K, typename V>
 void OutputWriter<K, V>::write(mapreduce::data::ByteData&& key, mapreduce::data::ByteData&& value) {
+  write(key.get_data<K>(), value.get_data<V>());
+}
+
+template <typename K, typename V>
+void OutputWriter<K, V>::write(K&& key, V&& value) {
   std::lock_guard<std::mutex> lock(mapreduce::commons::mr_mutex);
 
-  write_output<K>(fout_, key.get_data<K>());
+  write_output<K>(fout_, key);
   fout_ << "\t";
-  write_output<V>(fout_, value.get_data<V>());
+  write_output<V>(fout_, value);
   fout_ << "\n";
 }
 
+template <typename K, typename V>
+void BufferWriter<K, V>::write(mapreduce::data::ByteData&& key, mapreduce::data::ByteData&& value) {
+  records_.emplace_back(key.get_data<K>(), value.get_data<V>());
+}
+
+template <typename K, typename V>
+void BufferWriter<K, V>::write(K&& key, V&& value) {
+  records_.emplace_back(std::move(key), std::move(value));
+}
+
+template <typename K, typename V>
+void TypedMQWriter<K, V>::write(K&& key, V&& value) {
+  if (sampler_ != nullptr)
+    sampler_->add(key);
+
+  /// The storage is looked up once per batch, not for each record
+  if (typed_records_ == nullptr)
+    typed_records_ = batch_.typed_records<K, V>();
+
+  if (typed_records_ != nullptr) {
+    auto hash = mapreduce::data::hash_key(key);
+    static_cast<mapreduce::data::TypedRecords<K, V>*>(typed_records_)->emplace_back(std::move(key), std::move(value), hash);
+  } else {
+    batch_.emplace_back(std::move(key), std::move(value));
+  }
+  if (batch_.bytes() >= batch_bytes_)
+    flush();
+}
+
 }  // namespace proc
 }  // namespace mapreduce
\ No newline at end of file
@@ -1,17 +1,65 @@
 #ifndef SIMPLEMAPREDUCE_PROC_WRITER_H_
 #define SIMPLEMAPREDUCE_PROC_WRITER_H_
 
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <streambuf>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include "simplemapreduce/data/batch.h"
 #include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/codec.h"
 #include "simplemapreduce/data/queue.h"
+#include "simplemapreduce/proc/sampler.h"
 
 namespace mapreduce {
 namespace proc {
 
+/// Header of intermediate files written in sorted runs
+constexpr char kSortedRunsMagic[] = "\x89SMRSR\r\n";
+constexpr size_t kSortedRunsMagicSize = sizeof(kSortedRunsMagic) - 1;
+
+/// Header of index files written by PartitionedFileWriter
+constexpr char kPartitionIndexMagic[] = "\x89SMRPI\r\n";
+constexpr size_t kPartitionIndexMagicSize = sizeof(kPartitionIndexMagic) - 1;
+
+/**
+ * Get path of the intermediate data file written by a worker at shuffle.
+ *
+ *  @param dir   directory to store intermediate files (e.g. JobConf::tmpdir)
+ *  @param rank  rank of the worker writing the file
+ */
+std::filesystem::path shuffle_file_path(const std::filesystem::path&, int);
+
+/**
+ * Write unsigned integer in variable length (LEB128).
+ *
+ *  @param filestream  target file stream to write data
+ *  @param value       value to write
+ */
+void write_varint(std::ofstream&, std::uint64_t);
+
+/**
+ * Append unsigned integer in variable length (LEB128) to a byte buffer.
+ *
+ *  @param buffer  target buffer to append data
+ *  @param value   value to write
+ */
+void write_varint(std::vector<char>&, std::uint64_t);
+
+/**
+ * Append ByteData to a byte buffer in the same format as write_binary to a file stream.
+ *
+ *  @param buffer  target buffer to append data
+ *  @param data    data to write
+ */
+void write_binary(std::vector<char>&, const mapreduce::data::ByteData&);
+
 /**
  * Write data as binary to file stream.
  *
@@ -30,11 +78,139 @@ void write_binary(std::ofstream&, mapreduce::type::CompositeKey<T1, T2>&&);
 /**
  * Format value to output.
  *
- *  @param filestream  target file stream to write data
- *  @param data        data to be stored the read data
+ *  @param stream  target stream to write data
+ *  @param data    data to be stored the read data
  */
 template <typename T>
-void write_output(std::ofstream&, const T&);
+void write_output(std::ostream&, const T&);
+
+/** Location of bytes in a file. */
+struct FileSegment {
+  std::uint64_t offset;
+  std::uint64_t size;
+};
+
+/**
+ * Single data file written by writers of all partitions, with an index of the partitions.
+ * Each partition has a stream buffer appending the bytes to the end of the data file,
+ * and the locations of the bytes are written to the index file on close,
+ * so that PartitionedFileReader reads a partition without scanning the data file.
+ *
+ * Index format: (kPartitionIndexMagic, # of partitions, [(# of segments, [(offset, size)...])...]) in varint.
+ * The file is not synchronized, so all partitions must be written by a single thread (e.g. Shuffle).
+ */
+class PartitionedFileWriter {
+ public:
+  /**
+   * Constructor.
+   *
+   *  @param path          path of the data file, whose index is written to index_path(path)
+   *  @param n_partitions  number of partitions
+   */
+  PartitionedFileWriter(const std::filesystem::path&, int);
+  ~PartitionedFileWriter() { close(); }
+
+  PartitionedFileWriter(const PartitionedFileWriter&) = delete;
+  PartitionedFileWriter& operator=(const PartitionedFileWriter&) = delete;
+
+  /**
+   * Get a stream buffer to write bytes of a partition.
+   * The buffer is valid until the file is destroyed.
+   *
+   *  @param id   partition ID
+   */
+  std::streambuf* partition(int id) { return buffers_[id].get(); }
+
+  /** Close the data file and write the index. Bytes written after this are ignored. */
+  void close();
+
+  /** Get path of the index file of a data file. */
+  static std::filesystem::path index_path(const std::filesystem::path&);
+
+ private:
+  /** Unbuffered stream buffer appending bytes of a partition to the data file. */
+  class PartitionBuffer : public std::streambuf {
+   public:
+    PartitionBuffer(PartitionedFileWriter* file, int id) : file_(file), id_(id) {}
+
+   protected:
+    std::streamsize xsputn(const char*, std::streamsize) override;
+    int_type overflow(int_type) override;
+
+   private:
+    PartitionedFileWriter* file_;
+    int id_;
+  };
+
+  /** Append bytes of a partition, extending the last segment if it is at the end of the file. */
+  void append_(int, const char*, size_t);
+
+  std::filesystem::path path_;
+  std::ofstream fout_;
+
+  /// Size of the data file written so far
+  std::uint64_t size_{0};
+
+  /// Segments of each partition in the order written
+  std::vector<std::vector<FileSegment>> index_;
+  std::vector<std::unique_ptr<PartitionBuffer>> buffers_;
+};
+
+/**
+ * Writer of a single run of records given in the order of key bytes, such as spills of Sorter.
+ * Records are written in the run format of BinaryFileWriter with front coding but without the header,
+ * so that RunReader reads the file from offset 0 with n_records() and n_bytes().
+ */
+class RunWriter {
+ public:
+  /// Size of the memory buffer to flush
+  static constexpr size_t kBufferBytes = 256 * 1024;
+
+  /**
+   * Constructor.
+   *
+   *  @param path   path of the file to write
+   *  @throw        std::runtime_error if failed to open the file
+   */
+  RunWriter(const std::filesystem::path&);
+
+  RunWriter(const RunWriter&) = delete;
+  RunWriter& operator=(const RunWriter&) = delete;
+
+  /**
+   * Write a record.
+   *
+   *  @param key    key bytes, which must not be smaller than the previous key
+   *  @param value  value bytes
+   */
+  void write(std::string_view, std::string_view);
+
+  /**
+   * Write buffered bytes and close the file.
+   *
+   *  @throw  std::runtime_error if failed to write the file
+   */
+  void close();
+
+  /** Get number of records written. */
+  std::uint64_t n_records() const { return n_records_; }
+
+  /** Get size of the records in bytes. */
+  std::uint64_t n_bytes() const { return n_bytes_; }
+
+ private:
+  std::filesystem::path path_;
+  std::ofstream fout_;
+
+  /// Serialized bytes not written to the file yet
+  std::vector<char> buffer_;
+
+  /// Previous key to share the prefix
+  std::string prev_;
+
+  std::uint64_t n_records_{0};
+  std::uint64_t n_bytes_{0};
+};
 
 /** Base class to write data used by context. */
 class Writer {
@@ -44,77 +220,237 @@ class Writer {
   virtual void write(mapreduce::data::ByteData&&, mapreduce::data::ByteData&&) = 0;
 };
 
+/**
+ * Base class to write data without byte encoding.
+ * Context passes key/value data as it is if the writer implements this.
+ */
+template <typename K, typename V>
+class TypedWriter {
+ public:
+  virtual ~TypedWriter() = default;
+
+  virtual void write(K&&, V&&) = 0;
+};
+
 /**
  * Wrapper class to write intermediate key/value data to a file.
  * This is used to write intermediate state after map process is applied.
  * The input data must be formatted in mapreduce::data::ByteData.
- * 
+ *
+ * With sorted runs, records are buffered and written as runs sorted by key bytes,
+ * which BinaryFileDataLoader merges into a single sorted stream.
+ * Each key in a run is stored as (shared prefix length, suffix length, suffix bytes)
+ * with the previous key, where the shared prefix is always 0 without front coding.
+ *
+ * Records are serialized into a memory buffer and written to the file
+ * in blocks of kBlockBytes once the buffer reaches kBufferBytes.
+ * With a codec, the bytes are compressed by CompressBuffer and read by InputFile.
+ * The writer is not synchronized: each partition has its own writer
+ * that must be used by a single thread (e.g. Shuffle).
+ *
  * This is for RAII to handle long opened file descriptor.
  */
 template <typename K, typename V>
 class BinaryFileWriter : public Writer {
  public:
+  /// Size of records in bytes to sort and write as a run
+  static constexpr size_t kRunBytes = 16 * mapreduce::data::RecordBatch::kDefaultCapacity;
+
+  /// Alignment of bytes written to the file at once
+  static constexpr size_t kBlockBytes = 4096;
+
+  /// Size of the memory buffer to flush
+  static constexpr size_t kBufferBytes = 256 * kBlockBytes;
+
   /**
    * Constructor Binary data writing class.
    *
-   *  @param path  file path to write the data
+   *  @param path          file path to write the data
+   *  @param front_coding  write keys with front coding in sorted runs
+   *  @param sorted        write records in sorted runs, which is implied by front_coding
+   *  @param codec         codec to compress the file, or nullptr
    */
-  BinaryFileWriter(const std::filesystem::path &path);
-  BinaryFileWriter(const std::string &path);
+  BinaryFileWriter(const std::filesystem::path &path, bool front_coding = false, bool sorted = false,
+                   std::shared_ptr<mapreduce::data::Codec> codec = nullptr);
+  BinaryFileWriter(const std::string &path, bool front_coding = false, bool sorted = false,
+                   std::shared_ptr<mapreduce::data::Codec> codec = nullptr);
+
+  /**
+   * Constructor writing to a stream buffer instead of a file,
+   * such as a partition of PartitionedFileWriter.
+   *
+   *  @param out           stream buffer to write the data, which must outlive the writer
+   *  @param front_coding  write keys with front coding in sorted runs
+   *  @param sorted        write records in sorted runs, which is implied by front_coding
+   *  @param codec         codec to compress the bytes, or nullptr
+   */
+  BinaryFileWriter(std::streambuf*, bool front_coding = false, bool sorted = false,
+                   std::shared_ptr<mapreduce::data::Codec> codec = nullptr);
   ~BinaryFileWriter();
 
   /* Write data to file */
   void write(mapreduce::data::ByteData&&, mapreduce::data::ByteData&&);
 
+  /** Write all buffered data and close the file. Called on destruction if not closed. */
+  void close();
+
   /* Return current set path */
   const std::string &get_path() { return path_; }
 
+  /** Get bytes written so far before and after compression. */
+  mapreduce::data::CompressionStats stats() const;
+
  private:
+  /**
+   * Start writing to a stream buffer with the header.
+   *
+   *  @param out    stream buffer to write the data
+   *  @param codec  codec to compress the bytes, or nullptr
+   */
+  void open_(std::streambuf*, std::shared_ptr<mapreduce::data::Codec>);
+
+  /** Sort buffered records and write them as a run. */
+  void write_run_();
+
+  /**
+   * Write buffered bytes to the file.
+   *
+   *  @param all  write all bytes if true, otherwise only whole blocks
+   */
+  void flush_(bool all);
+
   /// Target file path to write data
   std::string path_;
-  /// File stream to write the binary data
+  /// File stream to write the binary data if written to the path
   std::ofstream fout_;
+  /// Stream buffer to write the data, or nullptr once closed
+  std::streambuf* out_{nullptr};
+  /// Stream buffer to compress bytes written to the file, or nullptr
+  std::unique_ptr<mapreduce::data::CompressBuffer> compressor_;
+  /// Serialized bytes not written to the file yet
+  std::vector<char> buffer_;
+  std::uint64_t n_written_{0};
+
+  /// Records buffered to sort, and the run serialized to know the size
+  bool sorted_;
+  bool front_coding_;
+  mapreduce::data::RecordBatch run_;
+  std::vector<char> run_buffer_;
 };
 
 /**
  * Write key/value data to MessageQueue.
  * The input data must be formatted in mapreduce::data::ByteData.
+ * Records are buffered in RecordBatch and sent to MessageQueue batch by batch.
  */
 class MQWriter : public Writer {
  public:
-
-  MQWriter(std::shared_ptr<mapreduce::data::MessageQueue> mq) : mq_(mq) {};
-  ~MQWriter() {};
+  /**
+   * Constructor
+   *
+   *  @param mq           MessageQueue to send data
+   *  @param batch_bytes  send buffered records once the size reaches this bytes.
+   *                      If 0, each record is sent immediately.
+   */
+  MQWriter(std::shared_ptr<mapreduce::data::MessageQueue> mq, size_t batch_bytes = 0)
+    : mq_(mq), batch_bytes_(batch_bytes) {};
+  ~MQWriter() { flush(); };
 
   /* Save data to Message Queue */
   void write(mapreduce::data::ByteData&&, mapreduce::data::ByteData&&);
 
- private:
+  /* Send buffered data to Message Queue */
+  void flush();
+
+  /**
+   * Set a sampler to sample keys written to the queue.
+   *
+   *  @param sampler  sampler shared by writers of the same worker
+   */
+  void set_sampler(std::shared_ptr<KeySampler> sampler) { sampler_ = sampler; }
+
+ protected:
   std::shared_ptr<mapreduce::data::MessageQueue> mq_ = nullptr;
+
+  /// Sampler of written keys, or nullptr if not sampled
+  std::shared_ptr<KeySampler> sampler_ = nullptr;
+
+  /// Records not sent yet
+  mapreduce::data::RecordBatch batch_;
+
+  /// Typed storage of the batch resolved once per batch by TypedMQWriter, reset when the batch changes
+  mapreduce::data::TypedRecordsBase* typed_records_ = nullptr;
+
+  /// Threshold of buffered bytes to send a batch
+  size_t batch_bytes_;
+};
+
+/**
+ * Write key/value data to MessageQueue keeping the original types.
+ * The records are not encoded unless the consumer takes different types,
+ * which is for tasks in the same process such as Mapper to Combiner.
+ */
+template <typename K, typename V>
+class TypedMQWriter : public MQWriter, public TypedWriter<K, V> {
+ public:
+  using MQWriter::MQWriter;
+  using MQWriter::write;
+
+  /* Save data to Message Queue without encoding */
+  void write(K&&, V&&) override;
 };
 
 /**
  * Wrapper class to write output key/value result to a file.
  * The input data must be formatted in mapreduce::data::ByteData.
+ * With a codec, the file is compressed and can be read by mapreduce::data::InputFile.
+ * The compression ratio is logged when the writer is destroyed.
  * This is for RAII to handle long opened file descriptor.
  */
 template <typename K, typename V>
-class OutputWriter : public Writer {
+class OutputWriter : public Writer, public TypedWriter<K, V> {
  public:
   /**
    * Constructor
    *
-   *  @param path  target file path to write data
+   *  @param path   target file path to write data
+   *  @param codec  codec to compress the file, or nullptr
    */
-  OutputWriter(const std::filesystem::path&);
-  OutputWriter(const std::string&);
+  OutputWriter(const std::filesystem::path&, std::shared_ptr<mapreduce::data::Codec> codec = nullptr);
+  OutputWriter(const std::string&, std::shared_ptr<mapreduce::data::Codec> codec = nullptr);
   ~OutputWriter();
 
   /* Write data to output file */
   void write(mapreduce::data::ByteData&&, mapreduce::data::ByteData&&);
+  void write(K&&, V&&) override;
 
  private:
-  std::ofstream fout_;
+  /// Output file path to report the compression ratio
+  std::string path_;
+
+  std::ofstream file_;
+  std::unique_ptr<mapreduce::data::CompressBuffer> compressor_;
+
+  /// Stream to the file or the compressor
+  std::ostream fout_{nullptr};
+};
+
+/**
+ * Hold written key/value records in memory in the original types.
+ * This is for outputs of a task on another thread, which are written to the actual writer later in order.
+ */
+template <typename K, typename V>
+class BufferWriter : public Writer, public TypedWriter<K, V> {
+ public:
+  /* Save data to the buffer */
+  void write(mapreduce::data::ByteData&&, mapreduce::data::ByteData&&);
+  void write(K&&, V&&) override;
+
+  /** Get the written records in the order written, which can be moved out. */
+  std::vector<std::pair<K, V>>& records() { return records_; }
+
+ private:
+  std::vector<std::pair<K, V>> records_;
 };
 
 }  // namespace proc
@@ -1,37 +1,68 @@
 namespace mapreduce {
 
 template <typename IK, typename IV, typename OK, typename OV>
-std::filesystem::path Reducer<IK, IV, OK, OV>::get_output_filepath() {
-  /// Set file path named by current worker rank and join with the output directory
+std::filesystem::path Reducer<IK, IV, OK, OV>::get_output_filepath(int id) {
+  /// Set file path named by the group ID and join with the output directory
   std::ostringstream oss;
-  oss << std::setw(5) << std::setfill('0') << conf_->worker_rank;
+  oss << std::setw(5) << std::setfill('0') << id;
   std::filesystem::path fname = oss.str();
 
   return conf_->output_dirpath / fname;
 }
 
+template <typename IK, typename IV, typename OK, typename OV>
+std::filesystem::path Reducer<IK, IV, OK, OV>::get_spill_prefix() {
+  /// Sorters spill to the same node-local directory as the queue, named uniquely on this worker
+  std::ostringstream oss;
+  oss << std::setw(4) << std::setfill('0') << conf_->worker_rank << (is_combiner_ ? "-combine-" : "-sort-") << n_sorters_++;
+  return conf_->spill_dirpath / oss.str();
+}
+
+template <typename IK, typename IV, typename OK, typename OV>
+mapreduce::Grouping Reducer<IK, IV, OK, OV>::get_grouping() {
+  /// Outputs of the reducer are written in the order of keys for globally sorted output
+  if (conf_->sort_output && !is_combiner_)
+    return mapreduce::Grouping::sort;
+  return conf_->grouping;
+}
+
 template <typename IK, typename IV, typename OK, typename OV>
 std::unique_ptr<mapreduce::Context<OK, OV>> Reducer<IK, IV, OK, OV>::get_context(const std::string& path) {
-  std::unique_ptr<mapreduce::proc::OutputWriter<OK, OV>> writer = std::make_unique<mapreduce::proc::OutputWriter<OK, OV>>(path);
+  std::unique_ptr<mapreduce::proc::OutputWriter<OK, OV>> writer =
+    std::make_unique<mapreduce::proc::OutputWriter<OK, OV>>(path, mapreduce::data::get_codec(conf_->compression));
   return std::make_unique<mapreduce::Context<OK, OV>>(std::move(writer));
 }
 
 template <typename IK, typename IV, typename OK, typename OV>
 std::unique_ptr<mapreduce::Context<OK, OV>> Reducer<IK, IV, OK, OV>::get_context(std::shared_ptr<mapreduce::data::MessageQueue> mq) {
-  std::unique_ptr<mapreduce::proc::MQWriter> writer = std::make_unique<mapreduce::proc::MQWriter>(mq);
+  std::unique_ptr<mapreduce::proc::MQWriter> writer =
+    std::make_unique<mapreduce::proc::TypedMQWriter<OK, OV>>(mq, mapreduce::data::RecordBatch::kDefaultCapacity);
   return std::make_unique<mapreduce::Context<OK, OV>>(std::move(writer));
 }
 
 template <typename IK, typename IV, typename OK, typename OV>
 std::unique_ptr<mapreduce::proc::Sorter<IK, IV>> Reducer<IK, IV, OK, OV>::get_sorter() {
-  std::unique_ptr<mapreduce::proc::DataLoader> loader = std::make_unique<mapreduce::proc::BinaryFileDataLoader<IK, IV>>(this->conf_);
-  return std::make_unique<mapreduce::proc::Sorter<IK, IV>>(std::move(loader));
+  std::unique_ptr<mapreduce::proc::DataLoader> loader = std::make_unique<mapreduce::proc::BinaryFileDataLoader<IK, IV>>(this->conf_, get_group());
+  auto sorter = std::make_unique<mapreduce::proc::Sorter<IK, IV>>(std::move(loader));
+  sorter->set_max_bytes(conf_->sort_max_bytes, get_spill_prefix());
+  sorter->set_grouping(get_grouping());
+  return sorter;
 }
 
 template <typename IK, typename IV, typename OK, typename OV>
 std::unique_ptr<mapreduce::proc::Sorter<IK, IV>> Reducer<IK, IV, OK, OV>::get_sorter(std::shared_ptr<mapreduce::data::MessageQueue> mq) {
   std::unique_ptr<mapreduce::proc::DataLoader> loader = std::make_unique<mapreduce::proc::MQDataLoader>(mq);
-  return std::make_unique<mapreduce::proc::Sorter<IK, IV>>(std::move(loader));
+  auto sorter = std::make_unique<mapreduce::proc::Sorter<IK, IV>>(std::move(loader));
+  sorter->set_max_bytes(conf_->sort_max_bytes, get_spill_prefix());
+  sorter->set_grouping(get_grouping());
+  return sorter;
+}
+
+template <typename IK, typename IV, typename OK, typename OV>
+std::shared_ptr<mapreduce::proc::SortTask> Reducer<IK, IV, OK, OV>::get_local_sorter() {
+  if (local_sorter_ == nullptr)
+    local_sorter_ = this->get_sorter(mq_);
+  return local_sorter_;
 }
 
 template <typename IK, typename IV, typename OK, typename OV>
@@ -39,40 +70,168 @@ void Reducer<IK, IV, OK, OV>::run() {
   if (is_combiner_)
     this->run_();
   else
-    this->run_(get_output_filepath());
+    this->run_(get_output_filepath(get_group()));
+}
+
+template <typename IK, typename IV, typename OK, typename OV>
+void Reducer<IK, IV, OK, OV>::finish() {
+  if (!salted_keys_.empty())
+    merge_salted_keys_();
+  output_.reset();
 }
 
 template <typename IK, typename IV, typename OK, typename OV>
 void Reducer<IK, IV, OK, OV>::run_() {
-  /// Grouping data by the keys from mapped data
+  /// Grouping data by the keys from mapped data.
+  /// All records are read from the queue before the outputs are sent to it.
   auto sorter = this->get_sorter(mq_);
-  auto container = sorter->run();
 
-  auto context = this->get_context(mq_);
-
-  for (const auto& [key, values] : *container)
-    reduce(key, values, *context);
+  {
+    /// Buffered data is sent when the context is destroyed
+    auto context = this->get_context(mq_);
+    sorter->run([&](const IK& key, mapreduce::ValueRange<IV> values) { reduce(key, values, *context); });
+  }
   mq_->end();
 }
 
 template <typename IK, typename IV, typename OK, typename OV>
 void Reducer<IK, IV, OK, OV>::run_(const std::filesystem::path& outpath) {
-  /// Grouping data by the keys from shuffled data
-  auto sorter = this->get_sorter();
-
-  std::map<IK, std::vector<IV>> container_;
-  auto data = mq_->receive();
-  while (!data.first.empty()) {
-    container_[data.first.get_data<IK>()].push_back(data.second.get_data<IV>());
-    data = mq_->receive();
+  /// Grouping data by the keys from shuffled data.
+  /// Data of this worker grouped at shuffle and in MessageQueue is grouped first, then merged with data in files.
+  /// Sorted runs in files and groups spilled over the memory limit are merged key by key,
+  /// so all of them are not kept in memory. The values of each key are streamed from the merge to reduce().
+  /// Only the group of the worker rank has data in MessageQueue.
+  std::shared_ptr<mapreduce::proc::Sorter<IK, IV>> sorter;
+  if (get_group() == conf_->worker_rank) {
+    sorter = local_sorter_ != nullptr ? std::move(local_sorter_) : this->get_sorter(mq_);
+    sorter->add_loader(std::make_unique<mapreduce::proc::BinaryFileDataLoader<IK, IV>>(this->conf_, get_group()));
+  } else {
+    sorter = this->get_sorter();
   }
-  sorter->set_container(std::make_unique<std::map<IK, std::vector<IV>>>(container_));
-  auto container = sorter->run();
 
   auto context = this->get_context(outpath);
+  if (salted_keys_.empty()) {
+    reduce_(*sorter, {context.get()});
+    return;
+  }
+
+  /// Values of salted keys are spread over workers, so that the outputs are partial
+  if (partial_mq_ == nullptr)
+    partial_mq_ = std::make_shared<mapreduce::data::MessageQueue>();
+  {
+    auto partial = this->get_context(partial_mq_);
+    reduce_(*sorter, {context.get(), partial.get()}, [this](const IK& key) -> size_t {
+      return salted_keys_.count(mapreduce::data::hash_key(key)) ? 1 : 0;
+    });
+  }
+
+  /// Salted keys of the group of this worker are merged into the output in finish()
+  if (get_group() == conf_->worker_rank)
+    output_ = std::move(context);
+}
+
+template <typename IK, typename IV, typename OK, typename OV>
+void Reducer<IK, IV, OK, OV>::reduce_(mapreduce::proc::Sorter<IK, IV>& sorter,
+                                      const std::vector<mapreduce::Context<OK, OV>*>& contexts,
+                                      const std::function<size_t(const IK&)>& select) {
+  if (conf_->reduce_threads < 2) {
+    sorter.run([&](const IK& key, mapreduce::ValueRange<IV> values) {
+      reduce(key, values, *contexts[select ? select(key) : 0]);
+    });
+    return;
+  }
+
+  /** Keys reduced on a thread with the outputs buffered for each context. */
+  struct Batch {
+    std::vector<IK> keys;
+    std::vector<std::vector<IV>> values;
+    size_t bytes{0};
+    std::vector<std::unique_ptr<mapreduce::Context<OK, OV>>> outputs;
+    std::vector<mapreduce::proc::BufferWriter<OK, OV>*> buffers;
+    std::future<void> done;
+  };
+
+  /// The pool is destroyed first to finish the tasks referring to the batches
+  std::deque<std::unique_ptr<Batch>> pending;
+  auto batch = std::make_unique<Batch>();
+  mapreduce::util::ThreadPool pool(conf_->reduce_threads);
+
+  /// Outputs are written in the order of batches, which is the same as reducing on this thread
+  auto write = [&]() {
+    auto done = std::move(pending.front());
+    pending.pop_front();
+    done->done.get();
+    for (size_t i = 0; i < contexts.size(); ++i) {
+      for (auto& [key, value]: done->buffers[i]->records())
+        contexts[i]->write(key, value);
+    }
+  };
+
+  auto submit = [&]() {
+    for (size_t i = 0; i < contexts.size(); ++i) {
+      auto writer = std::make_unique<mapreduce::proc::BufferWriter<OK, OV>>();
+      batch->buffers.push_back(writer.get());
+      batch->outputs.push_back(std::make_unique<mapreduce::Context<OK, OV>>(std::move(writer)));
+    }
+    batch->done = pool.submit([this, &select, target = batch.get()] {
+      for (size_t i = 0; i < target->keys.size(); ++i) {
+        mapreduce::VectorValueSource<IV> values(target->values[i]);
+        auto& key = target->keys[i];
+        reduce(key, mapreduce::ValueRange<IV>(values), *target->outputs[select ? select(key) : 0]);
+        std::vector<IV>().swap(target->values[i]);
+      }
+    });
+    pending.push_back(std::move(batch));
+    batch = std::make_unique<Batch>();
+
+    /// Batches waiting for the threads are bounded to keep memory
+    while (pending.size() > pool.size() * 2)
+      write();
+  };
+
+  sorter.run([&](const IK& key, mapreduce::ValueRange<IV> range) {
+    auto& values = batch->values.emplace_back();
+    for (auto& value: range) {
+      batch->bytes += mapreduce::data::approx_bytes(value);
+      values.push_back(std::move(value));
+    }
+    batch->keys.push_back(key);
+    if (batch->keys.size() >= kReduceBatchKeys || batch->bytes >= kReduceBatchBytes)
+      submit();
+  });
+  if (!batch->keys.empty())
+    submit();
+  while (!pending.empty())
+    write();
+}
+
+template <typename IK, typename IV, typename OK, typename OV>
+void Reducer<IK, IV, OK, OV>::merge_salted_keys_() {
+  if constexpr (std::is_same_v<IK, OK> && std::is_same_v<IV, OV>) {
+    if (partial_mq_ == nullptr)
+      partial_mq_ = std::make_shared<mapreduce::data::MessageQueue>();
+    partial_mq_->end();
+
+    /// Partial outputs are sent to the group of the key by the hash as the first shuffle
+    auto merged_mq = std::make_shared<mapreduce::data::MessageQueue>();
+    {
+      mapreduce::proc::MPIShuffle<IK, IV> shuffle(partial_mq_, conf_);
+      shuffle.set_output(merged_mq);
+      shuffle.run();
+    }
+    partial_mq_.reset();
 
-  for (const auto& [key, values] : *container) {
-    reduce(key, values, *context);
+    this->get_sorter(merged_mq)->run([&](const IK& key, mapreduce::ValueRange<IV> values) {
+      /// The group of this worker may be reduced by another worker with file shuffle,
+      /// so that merged keys are written to a file of this worker not to overwrite the output
+      if (output_ == nullptr) {
+        auto path = get_output_filepath(conf_->worker_rank);
+        output_ = this->get_context(path.replace_filename("salted-" + path.filename().string()));
+      }
+      reduce(key, values, *output_);
+    });
+  } else {
+    throw std::logic_error("Outputs of Reducer cannot be reduced again to merge salted keys.");
   }
 }
 
@@ -1,10 +1,15 @@
 #ifndef SIMPLEMAPREDUCE_REDUCER_H_
 #define SIMPLEMAPREDUCE_REDUCER_H_
 
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "simplemapreduce/commons.h"
@@ -13,6 +18,8 @@
 #include "simplemapreduce/data/queue.h"
 #include "simplemapreduce/ops/context.h"
 #include "simplemapreduce/ops/job.h"
+#include "simplemapreduce/ops/value_range.h"
+#include "simplemapreduce/util/thread_pool.h"
 
 namespace mapreduce {
 
@@ -22,25 +29,58 @@ template <typename /* Input key datatype    */ IKeyType,
           typename /* Output value datatype */ OValueType>
 class Reducer : public mapreduce::base::ReduceTask {
  public:
+  /// Max number of keys and approximate bytes of values in a batch reduced on a thread
+  static constexpr size_t kReduceBatchKeys = 1024;
+  static constexpr size_t kReduceBatchBytes = 1 << 20;
+
   /**
    * Reducer function
+   * Either this or reduce() with ValueRange must be overridden.
+   * With Config::reduce_threads, this is called from multiple threads at once.
    *
    *  @param key      Input mapped key
    *  @param value[]  Input mapped value
    *  @param context& Context used for sending data
    */
-  virtual void reduce(const IKeyType&, const std::vector<IValueType>&, const Context<OKeyType, OValueType>&) = 0;
+  virtual void reduce(const IKeyType&, const std::vector<IValueType>&, const Context<OKeyType, OValueType>&) {
+    throw std::logic_error("Reducer must override reduce().");
+  }
+
+  /**
+   * Reducer function streaming the values.
+   * Values are read as the range is iterated, so that all values of a key are not held in memory.
+   * Override this for keys with too many values. By default, the values are collected into a vector
+   * and passed to reduce() with the vector.
+   *
+   *  @param key      Input mapped key
+   *  @param values   Input mapped values, which can be read only once
+   *  @param context& Context used for sending data
+   */
+  virtual void reduce(const IKeyType& key, ValueRange<IValueType> values, const Context<OKeyType, OValueType>& context) {
+    std::vector<IValueType> collected;
+    for (auto& value: values)
+      collected.push_back(std::move(value));
+    reduce(key, collected, context);
+  }
 
  private:
   /**
    * Set file path to write data and return it.
-   * The file name will be defined based on worker rank.
+   * The file name will be defined based on the group ID.
+   *
+   *  @param id   group ID
    */
-  std::filesystem::path get_output_filepath();
+  std::filesystem::path get_output_filepath(int);
+
+  /** Get the group to reduce. */
+  int get_group() const { return group_ < 0 ? conf_->worker_rank : group_; }
 
   /** Run main reduce task. */
   void run() override;
 
+  /** Merge partial outputs of salted keys after all groups. */
+  void finish() override;
+
   /**
    * Run reduce task.
    *
@@ -57,8 +97,41 @@ class Reducer : public mapreduce::base::ReduceTask {
    */
   void set_mq(std::shared_ptr<mapreduce::data::MessageQueue> mq) override { mq_ = mq; };
 
+  std::shared_ptr<mapreduce::proc::SortTask> get_local_sorter() override;
+
   void as_combiner() override { is_combiner_ = true; }
 
+  bool can_reduce_outputs() const override {
+    return std::is_same_v<IKeyType, OKeyType> && std::is_same_v<IValueType, OValueType>;
+  }
+
+  /**
+   * Shuffle partial outputs of salted keys to the group of each key and reduce them again.
+   * The outputs are written to the output of the group of this worker kept open,
+   * or to a separate file of this worker if another worker reduced the group.
+   * Called by all workers to exchange the outputs.
+   */
+  void merge_salted_keys_();
+
+  /**
+   * Reduce all keys of a sorter.
+   * With JobConf::reduce_threads, keys are reduced batch by batch on a thread pool into buffers,
+   * and the outputs are written to the contexts in the order of batches.
+   *
+   *  @param sorter     sorter grouping values by key
+   *  @param contexts   contexts to write the outputs
+   *  @param select     function to select the context of a key, or nullptr for the first context
+   */
+  void reduce_(mapreduce::proc::Sorter<IKeyType, IValueType>&,
+               const std::vector<mapreduce::Context<OKeyType, OValueType>*>&,
+               const std::function<size_t(const IKeyType&)>& select = nullptr);
+
+  /** Get a path prefix of spill files of a new Sorter. */
+  std::filesystem::path get_spill_prefix();
+
+  /** Get the strategy to group values by key in a new Sorter. */
+  mapreduce::Grouping get_grouping();
+
   /**
    * Create output data writer.
    *
@@ -89,6 +162,18 @@ class Reducer : public mapreduce::base::ReduceTask {
   /// MessageQueue to store data
   std::shared_ptr<mapreduce::data::MessageQueue> mq_ = nullptr;
 
+  /// Sorter of the group of this worker, which groups records of the shuffle and the queue
+  std::shared_ptr<mapreduce::proc::Sorter<IKeyType, IValueType>> local_sorter_ = nullptr;
+
+  /// Partial outputs of salted keys of all groups reduced on this worker
+  std::shared_ptr<mapreduce::data::MessageQueue> partial_mq_ = nullptr;
+
+  /// Output of the group of this worker kept open to write merged outputs of salted keys
+  std::unique_ptr<mapreduce::Context<OKeyType, OValueType>> output_ = nullptr;
+
+  /// Number of Sorters created to name the spill files
+  int n_sorters_{0};
+
   bool is_combiner_{false};
 };
 
@@ -0,0 +1,57 @@
+#ifndef SIMPLEMAPREDUCE_UTIL_THREAD_POOL_H_
+#define SIMPLEMAPREDUCE_UTIL_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mapreduce {
+namespace util {
+
+/**
+ * Fixed number of threads running submitted tasks in the order of submission.
+ * Tasks left in the queue are run before the threads are joined on destruction.
+ */
+class ThreadPool {
+ public:
+  /**
+   * Constructor.
+   *
+   *  @param n_threads  number of threads, at least 1
+   */
+  ThreadPool(int);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * Submit a task.
+   *
+   *  @param task   function to run on a thread
+   *  @return       future to wait for the task, which has an exception thrown by the task
+   */
+  std::future<void> submit(std::function<void()>);
+
+  /** Get number of threads. */
+  size_t size() const { return threads_.size(); }
+
+ private:
+  /** Run tasks until the pool is destroyed. */
+  void work_();
+
+  std::vector<std::thread> threads_;
+  std::deque<std::packaged_task<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool stopped_{false};
+};
+
+}  // namespace util
+}  // namespace mapreduce
+
+#endif  // SIMPLEMAPREDUCE_UTIL_THREAD_POOL_H_
\ No newline at end of file
@@ -10,8 +10,12 @@ namespace util {
 template <typename T>
 using is_vector = std::is_same<T, std::vector<typename T::value_type>>;
 
+/** Helper type checking for CompositeKey. Also usable for scalar types. */
 template <typename T>
-using is_compositekey = std::is_same<T, mapreduce::type::CompositeKey<typename T::first_type, typename T::second_type>>;
+struct is_compositekey : std::false_type {};
+
+template <typename T1, typename T2>
+struct is_compositekey<mapreduce::type::CompositeKey<T1, T2>> : std::true_type {};
 
 }  // namespace util
 }  // namespace mapreduce
@@ -14,6 +14,7 @@ ArgParser::ArgParser(int& argc, char* argv[]) {
   const struct option longopts[] = {
     {"input", 1, 0, 'i'},
     {"output", 1, 0, 'o'},
+    {"grouping", 1, 0, 'g'},
     {"help", 0, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -21,7 +22,7 @@ ArgParser::ArgParser(int& argc, char* argv[]) {
   int longindex;
   int iarg = 0;
   while (iarg != -1) {
-    iarg = getopt_long(argc, argv, "i:o:h", longopts, &longindex);
+    iarg = getopt_long(argc, argv, "i:o:g:h", longopts, &longindex);
 
     switch (iarg) {
       case 'h':
@@ -29,6 +30,7 @@ ArgParser::ArgParser(int& argc, char* argv[]) {
         std::cout << "  Arguments:\n";
         std::cout << "    -i/--input:   Input directories(comma separated)\n";
         std::cout << "    -o/--output:  Output directory\n";
+        std::cout << "    -g/--grouping: Group values at reduce by \"sort\" (default) or \"hash\"\n";
         is_help_ = true;
         return;
       case 'i':
@@ -37,6 +39,9 @@ ArgParser::ArgParser(int& argc, char* argv[]) {
       case 'o':
         optvalues_.insert({"output", optarg});
         break;
+      case 'g':
+        optvalues_.insert({"grouping", optarg});
+        break;
     }
   }
 }
@@ -0,0 +1,122 @@
+#include "simplemapreduce/data/batch.h"
+
+#include <cstring>
+
+namespace mapreduce {
+namespace data {
+
+void RecordBatch::append_(ByteView key, size_t key_length,
+                          std::string_view value, size_t value_length, std::uint64_t hash) {
+  /// Records in bytes cannot be mixed with typed records
+  encode();
+
+  records_.push_back({hash,
+                      static_cast<std::uint32_t>(arena_.size()),
+                      static_cast<std::uint32_t>(key.size()),
+                      static_cast<std::uint32_t>(value.size()),
+                      static_cast<std::uint32_t>(key_length),
+                      static_cast<std::uint32_t>(value_length),
+                      key.is_composite() ? 1u : 0u});
+  arena_.insert(arena_.end(), key.data(), key.data() + key.size());
+  arena_.insert(arena_.end(), value.begin(), value.end());
+}
+
+void RecordBatch::append(const ByteData& key, const ByteData& value) {
+  append(key, value, hash_key(key.view()));
+}
+
+void RecordBatch::append(const ByteData& key, const ByteData& value, std::uint64_t hash) {
+  append_(key.view(), key.size(),
+          std::string_view(value.get_byte(), value.bsize()), value.size(), hash);
+}
+
+void RecordBatch::append(const RecordBatch& batch, size_t index) {
+  auto& record = batch.records_[index];
+  append_(batch.key(index), record.key_length, batch.value(index), record.value_length, record.hash);
+}
+
+ByteView RecordBatch::key(size_t index) const {
+  auto& record = records_[index];
+  return ByteView(arena_.data() + record.offset, record.key_size, record.key_composite != 0);
+}
+
+ByteView RecordBatch::value(size_t index) const {
+  auto& record = records_[index];
+  return ByteView(arena_.data() + record.offset + record.key_size, record.value_size);
+}
+
+BytePair RecordBatch::get_item(size_t index) const {
+  auto& record = records_[index];
+  auto key_data = key(index);
+  auto value_data = value(index);
+
+  BytePair item;
+  item.first.set_bytes(key_data.data(), key_data.size(), record.key_length, record.key_composite != 0);
+  item.second.set_bytes(value_data.data(), value_data.size(), record.value_length);
+  return item;
+}
+
+void RecordBatch::encode() {
+  if (typed_ == nullptr)
+    return;
+
+  /// Detach first since encode() appends records to this batch
+  auto typed = std::move(typed_);
+  typed->encode(*this);
+}
+
+void RecordBatch::clear() {
+  arena_.clear();
+  records_.clear();
+  typed_.reset();
+}
+
+void RecordBatch::write(std::ofstream& ofs) const {
+  /// Format: (# of records, arena size, offset table, arena)
+  std::uint64_t sizes[2] = {records_.size(), arena_.size()};
+  ofs.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+  ofs.write(reinterpret_cast<const char*>(records_.data()), sizeof(Record) * records_.size());
+  ofs.write(arena_.data(), arena_.size());
+}
+
+bool RecordBatch::read(std::ifstream& ifs) {
+  std::uint64_t sizes[2];
+  if (!ifs.read(reinterpret_cast<char*>(sizes), sizeof(sizes)))
+    return false;
+
+  records_.resize(sizes[0]);
+  arena_.resize(sizes[1]);
+  ifs.read(reinterpret_cast<char*>(records_.data()), sizeof(Record) * records_.size());
+  ifs.read(arena_.data(), arena_.size());
+  return true;
+}
+
+void RecordBatch::write(std::vector<char>& out) const {
+  std::uint64_t sizes[2] = {records_.size(), arena_.size()};
+  auto records = reinterpret_cast<const char*>(records_.data());
+
+  out.reserve(out.size() + sizeof(sizes) + sizeof(Record) * records_.size() + arena_.size());
+  out.insert(out.end(), reinterpret_cast<const char*>(sizes), reinterpret_cast<const char*>(sizes) + sizeof(sizes));
+  out.insert(out.end(), records, records + sizeof(Record) * records_.size());
+  out.insert(out.end(), arena_.begin(), arena_.end());
+}
+
+bool RecordBatch::read(const char* data, size_t size) {
+  std::uint64_t sizes[2];
+  if (size < sizeof(sizes))
+    return false;
+  std::memcpy(sizes, data, sizeof(sizes));
+
+  size_t records_size = sizeof(Record) * sizes[0];
+  if (size != sizeof(sizes) + records_size + sizes[1])
+    return false;
+
+  clear();
+  records_.resize(sizes[0]);
+  std::memcpy(records_.data(), data + sizeof(sizes), records_size);
+  arena_.assign(data + sizeof(sizes) + records_size, data + size);
+  return true;
+}
+
+}  // namespace data
+}  // namespace mapreduce
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "simplemapreduce/data/buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mapreduce {
+namespace data {
+
+ByteBuffer::ByteBuffer(const char* data, size_t size) { assign(data, size); }
+
+ByteBuffer::ByteBuffer(size_t size) {
+  resize(size);
+  std::memset(this->data(), 0, size);
+}
+
+/// Copy
+ByteBuffer::ByteBuffer(const ByteBuffer& rhs) { assign(rhs.data(), rhs.size_); }
+
+ByteBuffer& ByteBuffer::operator=(const ByteBuffer& rhs) {
+  if (this == &rhs)
+    return *this;
+
+  assign(rhs.data(), rhs.size_);
+  return *this;
+}
+
+/// Move
+ByteBuffer::ByteBuffer(ByteBuffer&& rhs) noexcept { *this = std::move(rhs); }
+
+ByteBuffer& ByteBuffer::operator=(ByteBuffer&& rhs) noexcept {
+  if (this == &rhs)
+    return *this;
+
+  release();
+  if (rhs.is_inline()) {
+    std::memcpy(local_, rhs.local_, rhs.size_);
+  } else {
+    /// Take over the heap memory and leave rhs as empty inline buffer
+    heap_ = rhs.heap_;
+    capacity_ = rhs.capacity_;
+    rhs.capacity_ = kInlineCapacity;
+  }
+  size_ = rhs.size_;
+  rhs.size_ = 0;
+  return *this;
+}
+
+bool ByteBuffer::operator==(const ByteBuffer& rhs) const {
+  return size_ == rhs.size_ && std::memcmp(data(), rhs.data(), size_) == 0;
+}
+
+bool ByteBuffer::operator<(const ByteBuffer& rhs) const {
+  /// Bytes are compared as unsigned char like memcmp
+  int cmp = std::memcmp(data(), rhs.data(), std::min(size_, rhs.size_));
+  return cmp < 0 || (cmp == 0 && size_ < rhs.size_);
+}
+
+void ByteBuffer::assign(const char* data, size_t size) {
+  size_ = 0;
+  reserve(size);
+  std::memcpy(this->data(), data, size);
+  size_ = size;
+}
+
+void ByteBuffer::append(const char* data, size_t size) {
+  reserve(size_ + size);
+  std::memcpy(this->data() + size_, data, size);
+  size_ += size;
+}
+
+void ByteBuffer::resize(size_t size) {
+  reserve(size);
+  size_ = size;
+}
+
+void ByteBuffer::reserve(size_t size) {
+  if (size <= capacity_)
+    return;
+
+  /// Grow geometrically to keep appending amortized constant
+  size_t capacity = std::max(size, capacity_ * 2);
+  char* buff = new char[capacity];
+  std::memcpy(buff, data(), size_);
+
+  release();
+  heap_ = buff;
+  capacity_ = capacity;
+}
+
+void ByteBuffer::release() noexcept {
+  if (!is_inline()) {
+    delete[] heap_;
+    capacity_ = kInlineCapacity;
+  }
+}
+
+}  // namespace data
+}  // namespace mapreduce
\ No newline at end of file
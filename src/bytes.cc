@@ -1,5 +1,6 @@
 #include "simplemapreduce/data/bytes.h"
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 
@@ -10,6 +11,15 @@ using namespace mapreduce::type;
 namespace mapreduce {
 namespace data {
 
+/** Decode values stored as an array of ordered bytes. */
+template <typename T>
+static std::vector<T> decode_array(const char* data, size_t size) {
+  std::vector<T> out(size);
+  for (size_t i = 0; i < size; ++i)
+    out[i] = decode_ordered<T>(data + sizeof(T) * i);
+  return out;
+}
+
 /// Constructor
 ByteData::ByteData(Int16 data) { set_data_<Int16>(data); }
 ByteData::ByteData(Int data) { set_data_<Int>(data); }
@@ -22,6 +32,7 @@ ByteData::ByteData(String&& data) { set_data(std::move(data)); }
 ByteData::ByteData(const ByteData& rhs) {
   this->data_ = rhs.data_;
   this->size_ = rhs.size_;
+  this->composite_ = rhs.composite_;
 }
 
 ByteData& ByteData::operator=(const ByteData& rhs) {
@@ -30,18 +41,21 @@ ByteData& ByteData::operator=(const ByteData& rhs) {
 
   this->data_ = rhs.data_;
   this->size_ = rhs.size_;
+  this->composite_ = rhs.composite_;
   return *this;
 }
 
 /// Move
-ByteData::ByteData(ByteData&& rhs) {
+ByteData::ByteData(ByteData&& rhs) noexcept {
   this->data_ = std::move(rhs.data_);
   this->size_ = rhs.size_;
+  this->composite_ = rhs.composite_;
 }
 
-ByteData& ByteData::operator=(ByteData&& rhs) {
+ByteData& ByteData::operator=(ByteData&& rhs) noexcept {
   this->data_ = std::move(rhs.data_);
   this->size_ = rhs.size_;
+  this->composite_ = rhs.composite_;
   return *this;
 }
 
@@ -53,9 +67,9 @@ void ByteData::set_data(Float data) noexcept { set_data_<Float>(data); }
 void ByteData::set_data(Double data) noexcept { set_data_<Double>(data); }
 void ByteData::set_data(String&& data) noexcept
 {
-  data_.clear();
-  data_ = std::vector<char>(data.begin(), data.end());
+  data_.assign(data.data(), data.size());
   size_ = data.size();
+  composite_ = false;
 }
 void ByteData::set_data(Int16* data, const size_t& size) { set_data_<Int16>(data, size); }
 void ByteData::set_data(Int* data, const size_t& size) { set_data_<Int>(data, size); }
@@ -63,27 +77,28 @@ void ByteData::set_data(Long* data, const size_t& size) { set_data_<Long>(data,
 void ByteData::set_data(Float* data, const size_t& size) { set_data_<Float>(data, size); }
 void ByteData::set_data(Double* data, const size_t& size) { set_data_<Double>(data, size); }
 
+void ByteData::set_bytes(const char* data, const size_t& size, const size_t& length, bool composite) {
+  data_.assign(data, size);
+  size_ = length;
+  composite_ = composite;
+}
+
 void ByteData::read_file(const std::string& path) {
   auto data_size = fs::file_size(path);
-  data_ = std::vector<char>(data_size);
+  data_.resize(data_size);
   std::ifstream ifs(path);
   ifs.read(data_.data(), data_size);
   size_ = data_size;
+  composite_ = false;
 }
 
 void ByteData::read_file(const fs::path& path) {
   auto data_size = fs::file_size(path);
-  data_ = std::vector<char>(data_size);
+  data_.resize(data_size);
   std::ifstream ifs(path);
   ifs.read(data_.data(), data_size);
   size_ = data_size;
-}
-
-template <>
-String ByteData::get_data_(size_t start, size_t end) const {
-  std::vector<char> data;
-  data.insert(data.end(), data_.begin() + start, data_.begin() + end);
-  return String(data.begin(), data.end());
+  composite_ = false;
 }
 
 template<> Int16 ByteData::get_data() const { return get_data_<Int16>(); }
@@ -96,38 +111,50 @@ template<> String ByteData::get_data() const { return String(data_.begin(), data
 /// Array
 template<>
 std::vector<Int16> ByteData::get_data() const {
-  std::vector<Int16> out(size_);
-  std::memcpy(out.data(), data_.data(), size_ * sizeof(Int16));
-  return out;
+  return decode_array<Int16>(data_.data(), size_);
 }
 template<>
 std::vector<Int> ByteData::get_data() const {
-  std::vector<Int> out(size_);
-  std::memcpy(out.data(), data_.data(), size_ * sizeof(Int));
-  return out;
+  return decode_array<Int>(data_.data(), size_);
 }
 template<>
 std::vector<Long> ByteData::get_data() const {
-  std::vector<Long> out(size_);
-  std::memcpy(out.data(), data_.data(), size_ * sizeof(Long));
-  return out;
+  return decode_array<Long>(data_.data(), size_);
 }
 template<>
 std::vector<Float> ByteData::get_data() const {
-  std::vector<Float> out(size_);
-  std::memcpy(out.data(), data_.data(), size_ * sizeof(Float));
-  return out;
+  return decode_array<Float>(data_.data(), size_);
 }
 template<>
 std::vector<Double> ByteData::get_data() const {
-  std::vector<Double> out(size_);
-  std::memcpy(out.data(), data_.data(), size_ * sizeof(Double));
-  return out;
+  return decode_array<Double>(data_.data(), size_);
+}
+
+size_t composite_first_size(const char* data, size_t size) {
+  if (size < kCompositeTrailerSize + 1)
+    return size;
+
+  size_t first_size = 0;
+  auto trailer = reinterpret_cast<const unsigned char*>(data + size - kCompositeTrailerSize);
+  for (size_t i = 0; i < kCompositeTrailerSize; ++i)
+    first_size = (first_size << 8) | trailer[i];
+
+  /// Check the separator placed right after the first data
+  if (first_size + 1 + kCompositeTrailerSize > size || data[first_size] != '\1')
+    return size;
+  return first_size;
+}
+
+ByteView ByteView::primary_key() const {
+  /// Only bytes flagged as CompositeKey are split, so that other bytes ending like the trailer are not
+  if (!composite_)
+    return *this;
+  return ByteView(data_.substr(0, composite_first_size(data_.data(), data_.size())));
 }
 
 mapreduce::type::String ByteData::get_key() const {
-  /// If this is not CompositeKey, read primary key, otherwise read all data
-  return mapreduce::type::String(data_.begin(), std::find(data_.begin(), data_.end(), '\1'));
+  /// If this is CompositeKey, read primary key, otherwise read all data
+  return mapreduce::type::String(get_key_view());
 }
 
 template<> void ByteData::push_back(Int16& value) { push_back_<Int16>(value); }
@@ -136,7 +163,7 @@ template<> void ByteData::push_back(Long& value) { push_back_<Long>(value); }
 template<> void ByteData::push_back(Float& value) { push_back_<Float>(value); }
 template<> void ByteData::push_back(Double& value) { push_back_<Double>(value); }
 template<> void ByteData::push_back(String& value) {
-  data_.insert(data_.end(), value.begin(), value.end());
+  data_.append(value.data(), value.size());
 }
 
 bool ByteData::operator==(const ByteData& rhs) const {
@@ -148,31 +175,11 @@ bool ByteData::operator!=(const ByteData& rhs) const {
 }
 
 bool ByteData::operator<(const ByteData& rhs) const {
-  if (size_ == 1 && rhs.size() == 1 && data_.size() == rhs.bsize()) {
-    if (data_.size() == 2) {
-      return get_data<Int16>() < rhs.get_data<Int16>();
-    } else if (data_.size() == 4) {
-      return get_data<Int32>() < rhs.get_data<Int32>();
-    } else if (data_.size() == 8) {
-      return get_data<Int64>() < rhs.get_data<Int64>();
-    }
-  }
-
   return data_ < rhs.data_;
 }
 
 bool ByteData::operator>(const ByteData& rhs) const {
-  if (size_ == 1 && rhs.size() == 1 && data_.size() == rhs.bsize()) {
-    if (data_.size() == 2) {
-      return get_data<Int16>() > rhs.get_data<Int16>();
-    } else if (data_.size() == 4) {
-      return get_data<Int32>() > rhs.get_data<Int32>();
-    } else if (data_.size() == 8) {
-      return get_data<Int64>() > rhs.get_data<Int64>();
-    }
-  }
-
-  return data_ > rhs.data_;
+  return rhs.data_ < data_;
 }
 
 }  // namespace data
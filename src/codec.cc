@@ -0,0 +1,392 @@
+#include "simplemapreduce/data/codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif  // HAS_ZLIB
+
+namespace mapreduce {
+namespace data {
+
+namespace {
+
+/// LZ4 block format parameters
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 65535;
+constexpr int kHashLog = 14;
+
+/// Last bytes are always literals, and a match must start before the limit
+constexpr size_t kLastLiterals = 5;
+constexpr size_t kMatchStartLimit = 12;
+
+inline std::uint32_t read32(const char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline std::uint32_t hash32(std::uint32_t value) {
+  return (value * 2654435761u) >> (32 - kHashLog);
+}
+
+/** Write a length over the 4 bits of the token in bytes of 255. */
+inline void write_length(size_t length, std::vector<char>& out) {
+  for (; length >= 255; length -= 255)
+    out.push_back(static_cast<char>(255));
+  out.push_back(static_cast<char>(length));
+}
+
+/** Write a sequence of literals followed by a match, which is omitted if length is 0. */
+void write_sequence(const char* literals, size_t n_literals, size_t offset, size_t length, std::vector<char>& out) {
+  size_t match = length > 0 ? length - kMinMatch : 0;
+  out.push_back(static_cast<char>((std::min<size_t>(n_literals, 15) << 4) | std::min<size_t>(match, 15)));
+  if (n_literals >= 15)
+    write_length(n_literals - 15, out);
+  out.insert(out.end(), literals, literals + n_literals);
+
+  if (length == 0)
+    return;
+  out.push_back(static_cast<char>(offset & 0xff));
+  out.push_back(static_cast<char>(offset >> 8));
+  if (match >= 15)
+    write_length(match - 15, out);
+}
+
+/** Read a length following the token, which is added to the value. */
+inline bool read_length(const unsigned char*& p, const unsigned char* end, size_t& value) {
+  unsigned char byte;
+  do {
+    if (p >= end)
+      return false;
+    byte = *p++;
+    value += byte;
+  } while (byte == 255);
+  return true;
+}
+
+inline void write32(std::uint32_t value, std::vector<char>& out) {
+  auto bytes = reinterpret_cast<const char*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+}  // namespace
+
+void LZCodec::compress(const char* data, size_t size, std::vector<char>& out) const {
+  out.reserve(out.size() + size + size / 255 + 16);
+
+  size_t anchor = 0;
+  if (size > kMatchStartLimit) {
+    std::vector<std::uint32_t> table(1 << kHashLog, 0);
+    size_t limit = size - kMatchStartLimit;
+    size_t pos = 1;
+
+    while (pos < limit) {
+      std::uint32_t& entry = table[hash32(read32(data + pos))];
+      size_t candidate = entry;
+      entry = pos;
+
+      if (pos - candidate > kMaxOffset || read32(data + candidate) != read32(data + pos)) {
+        /// Skip faster over bytes not compressed
+        pos += 1 + ((pos - anchor) >> 6);
+        continue;
+      }
+
+      size_t length = kMinMatch;
+      while (pos + length < size - kLastLiterals && data[candidate + length] == data[pos + length])
+        ++length;
+
+      write_sequence(data + anchor, pos - anchor, pos - candidate, length, out);
+      pos += length;
+      anchor = pos;
+    }
+  }
+  write_sequence(data + anchor, size - anchor, 0, 0, out);
+}
+
+bool LZCodec::decompress(const char* data, size_t size, char* out, size_t out_size) const {
+  auto p = reinterpret_cast<const unsigned char*>(data);
+  auto end = p + size;
+  size_t pos = 0;
+
+  while (p < end) {
+    unsigned char token = *p++;
+
+    size_t n_literals = token >> 4;
+    if (n_literals == 15 && !read_length(p, end, n_literals))
+      return false;
+    if (static_cast<size_t>(end - p) < n_literals || out_size - pos < n_literals)
+      return false;
+    std::memcpy(out + pos, p, n_literals);
+    p += n_literals;
+    pos += n_literals;
+
+    /// The last sequence has only literals
+    if (p == end)
+      break;
+
+    if (end - p < 2)
+      return false;
+    size_t offset = p[0] | (p[1] << 8);
+    p += 2;
+    size_t length = token & 0x0f;
+    if (length == 15 && !read_length(p, end, length))
+      return false;
+    length += kMinMatch;
+    if (offset == 0 || offset > pos || out_size - pos < length)
+      return false;
+
+    /// Matches may overlap the bytes being written
+    const char* match = out + pos - offset;
+    if (offset >= length) {
+      std::memcpy(out + pos, match, length);
+    } else {
+      for (size_t i = 0; i < length; ++i)
+        out[pos + i] = match[i];
+    }
+    pos += length;
+  }
+  return pos == out_size;
+}
+
+#ifdef HAS_ZLIB
+void ZlibCodec::compress(const char* data, size_t size, std::vector<char>& out) const {
+  size_t start = out.size();
+  uLongf out_size = compressBound(size);
+  out.resize(start + out_size);
+  if (compress2(reinterpret_cast<Bytef*>(out.data() + start), &out_size,
+                reinterpret_cast<const Bytef*>(data), size, Z_DEFAULT_COMPRESSION) != Z_OK)
+    throw std::runtime_error("Failed to compress data by zlib");
+  out.resize(start + out_size);
+}
+
+bool ZlibCodec::decompress(const char* data, size_t size, char* out, size_t out_size) const {
+  uLongf n_written = out_size;
+  return uncompress(reinterpret_cast<Bytef*>(out), &n_written, reinterpret_cast<const Bytef*>(data), size) == Z_OK
+    && n_written == out_size;
+}
+#else
+void ZlibCodec::compress(const char*, size_t, std::vector<char>&) const {
+  throw std::runtime_error("Not built with zlib");
+}
+
+bool ZlibCodec::decompress(const char*, size_t, char*, size_t) const {
+  throw std::runtime_error("Not built with zlib");
+}
+#endif  // HAS_ZLIB
+
+std::shared_ptr<Codec> get_codec(mapreduce::Compression type) {
+  switch (type) {
+    case mapreduce::Compression::none:
+      return nullptr;
+    case mapreduce::Compression::lz:
+      return std::make_shared<LZCodec>();
+    case mapreduce::Compression::zlib:
+#ifdef HAS_ZLIB
+      return std::make_shared<ZlibCodec>();
+#else
+      throw std::invalid_argument("zlib codec is not available");
+#endif  // HAS_ZLIB
+  }
+  throw std::invalid_argument("Invalid compression type");
+}
+
+void write_block(const Codec& codec, const char* data, size_t size, std::vector<char>& out) {
+  if (size > std::numeric_limits<std::uint32_t>::max())
+    throw std::length_error("Block is too large to compress");
+
+  size_t start = out.size();
+  write32(size, out);
+  write32(0, out);
+  codec.compress(data, size, out);
+
+  /// Store the original bytes if not compressed
+  size_t stored_size = out.size() - start - 2 * sizeof(std::uint32_t);
+  if (stored_size >= size) {
+    out.resize(start + 2 * sizeof(std::uint32_t));
+    out.insert(out.end(), data, data + size);
+    stored_size = size;
+  }
+  std::uint32_t stored = stored_size;
+  std::memcpy(out.data() + start + sizeof(std::uint32_t), &stored, sizeof(stored));
+}
+
+bool read_block(const Codec& codec, const char* data, size_t size, std::vector<char>& out) {
+  if (size < 2 * sizeof(std::uint32_t))
+    return false;
+  std::uint32_t raw_size = read32(data), stored_size = read32(data + sizeof(std::uint32_t));
+  data += 2 * sizeof(std::uint32_t);
+  if (size - 2 * sizeof(std::uint32_t) != stored_size)
+    return false;
+
+  out.resize(raw_size);
+  if (stored_size == raw_size) {
+    std::memcpy(out.data(), data, raw_size);
+    return true;
+  }
+  return codec.decompress(data, stored_size, out.data(), raw_size);
+}
+
+CompressBuffer::CompressBuffer(std::streambuf* out, std::shared_ptr<Codec> codec) : out_(out), codec_(codec) {
+  char type = static_cast<char>(codec_->type());
+  out_->sputn(kCompressedMagic, kCompressedMagicSize);
+  out_->sputn(&type, 1);
+  stats_.stored_bytes += kCompressedMagicSize + 1;
+
+  block_.resize(kBlockBytes);
+  setp(block_.data(), block_.data() + block_.size());
+}
+
+CompressBuffer::int_type CompressBuffer::overflow(int_type ch) {
+  if (!write_block_())
+    return traits_type::eof();
+
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+int CompressBuffer::sync() {
+  if (!write_block_())
+    return -1;
+  return out_->pubsync();
+}
+
+bool CompressBuffer::write_block_() {
+  size_t size = pptr() - pbase();
+  if (size == 0)
+    return true;
+
+  stored_.clear();
+  write_block(*codec_, pbase(), size, stored_);
+  setp(block_.data(), block_.data() + block_.size());
+
+  stats_.raw_bytes += size;
+  stats_.stored_bytes += stored_.size();
+  return out_->sputn(stored_.data(), stored_.size()) == static_cast<std::streamsize>(stored_.size());
+}
+
+DecompressBuffer::DecompressBuffer(std::shared_ptr<std::istream> in, std::shared_ptr<Codec> codec)
+    : in_(in), codec_(codec) {
+  /// Read only the headers of blocks to build the index
+  auto blocks = std::make_shared<std::vector<Block>>();
+  std::uint64_t offset = 0;
+  std::uint32_t header[2];
+  while (in_->read(reinterpret_cast<char*>(header), sizeof(header))) {
+    std::streamoff file_offset = in_->tellg();
+    blocks->push_back({offset, header[0], file_offset, header[1]});
+    offset += header[0];
+    in_->seekg(file_offset + header[1]);
+  }
+  in_->clear();
+  blocks_ = blocks;
+  current_ = blocks_->size();
+}
+
+DecompressBuffer::DecompressBuffer(const DecompressBuffer& other)
+    : std::streambuf(), in_(other.in_), codec_(other.codec_), blocks_(other.blocks_), current_(blocks_->size()) {}
+
+void DecompressBuffer::load_(size_t index) {
+  const Block& block = (*blocks_)[index];
+  stored_.resize(block.stored_size);
+  in_->clear();
+  in_->seekg(block.file_offset);
+  if (!in_->read(stored_.data(), block.stored_size))
+    throw std::runtime_error("Failed to read a compressed block");
+
+  buffer_.resize(block.size);
+  if (block.stored_size == block.size)
+    buffer_.swap(stored_);
+  else if (!codec_->decompress(stored_.data(), stored_.size(), buffer_.data(), block.size))
+    throw std::runtime_error("Corrupted compressed block");
+
+  current_ = index;
+  setg(buffer_.data(), buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+DecompressBuffer::int_type DecompressBuffer::underflow() {
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+
+  /// Load the next block, skipping empty ones
+  size_t next = current_ < blocks_->size() ? current_ + 1 : 0;
+  for (; next < blocks_->size(); ++next) {
+    if ((*blocks_)[next].size > 0) {
+      load_(next);
+      return traits_type::to_int_type(*gptr());
+    }
+  }
+  return traits_type::eof();
+}
+
+DecompressBuffer::pos_type DecompressBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+  std::uint64_t total = blocks_->empty() ? 0 : blocks_->back().offset + blocks_->back().size;
+  std::uint64_t position = current_ < blocks_->size() ? (*blocks_)[current_].offset + (gptr() - eback()) : 0;
+
+  if (dir == std::ios_base::beg)
+    return seekpos(off, which);
+  if (dir == std::ios_base::cur)
+    return seekpos(position + off, which);
+  return seekpos(total + off, which);
+}
+
+DecompressBuffer::pos_type DecompressBuffer::seekpos(pos_type pos, std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in) || pos < 0)
+    return pos_type(off_type(-1));
+
+  /// Find the block including the position
+  std::uint64_t offset = static_cast<std::uint64_t>(off_type(pos));
+  if (blocks_->empty() && offset == 0)
+    return pos;
+  auto found = std::upper_bound(blocks_->begin(), blocks_->end(), offset,
+                                [](std::uint64_t value, const Block& block) { return value < block.offset; });
+  if (found == blocks_->begin())
+    return pos_type(off_type(-1));
+  size_t index = found - blocks_->begin() - 1;
+  const Block& block = (*blocks_)[index];
+  if (offset > block.offset + block.size)
+    return pos_type(off_type(-1));
+
+  if (index != current_)
+    load_(index);
+  setg(eback(), eback() + (offset - block.offset), egptr());
+  return pos;
+}
+
+InputFile::InputFile(const std::filesystem::path& path)
+    : InputFile(std::make_shared<std::ifstream>(path, std::ios::binary)) {}
+
+InputFile::InputFile(std::shared_ptr<std::istream> file) : std::istream(nullptr), file_(file) {
+  /// Check the header, otherwise read from the beginning
+  char header[kCompressedMagicSize + 1];
+  file_->read(header, sizeof(header));
+  if (file_->gcount() == sizeof(header) && std::equal(header, header + kCompressedMagicSize, kCompressedMagic)) {
+    buffer_ = std::make_unique<DecompressBuffer>(file_, get_codec(mapreduce::Compression(header[kCompressedMagicSize])));
+    rdbuf(buffer_.get());
+  } else {
+    file_->clear();
+    file_->seekg(0);
+    rdbuf(file_->rdbuf());
+  }
+  /// Not opened, or not seekable
+  if (file_->fail())
+    setstate(std::ios::failbit);
+}
+
+InputFile::InputFile(std::shared_ptr<std::istream> file, std::unique_ptr<DecompressBuffer> buffer)
+    : std::istream(nullptr), file_(file), buffer_(std::move(buffer)) {
+  rdbuf(buffer_ != nullptr ? static_cast<std::streambuf*>(buffer_.get()) : file_->rdbuf());
+}
+
+std::unique_ptr<InputFile> InputFile::share() const {
+  auto buffer = buffer_ != nullptr ? std::make_unique<DecompressBuffer>(*buffer_) : nullptr;
+  return std::unique_ptr<InputFile>(new InputFile(file_, std::move(buffer)));
+}
+
+}  // namespace data
+}  // namespace mapreduce
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "simplemapreduce/data/hash.h"
+
+namespace mapreduce {
+namespace data {
+
+/// Constants of wyhash
+static constexpr std::uint64_t kSecret[4] = {
+  0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+/** Multiply and fold 128-bit product into 64-bit. */
+static inline std::uint64_t mix(std::uint64_t lhs, std::uint64_t rhs) {
+  __uint128_t product = static_cast<__uint128_t>(lhs) * rhs;
+  return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+}
+
+/** Read bytes in little-endian. */
+template <size_t N>
+static inline std::uint64_t read_le(const unsigned char* data) {
+  std::uint64_t value = 0;
+  for (size_t i = 0; i < N; ++i)
+    value |= static_cast<std::uint64_t>(data[i]) << (8 * i);
+  return value;
+}
+
+std::uint64_t hash_bytes(const char* data, size_t size, std::uint64_t seed) {
+  auto ptr = reinterpret_cast<const unsigned char*>(data);
+  seed ^= mix(seed ^ kSecret[0], kSecret[1]);
+
+  std::uint64_t a = 0, b = 0;
+  if (size <= 16) {
+    if (size >= 4) {
+      size_t offset = (size >> 3) << 2;
+      a = (read_le<4>(ptr) << 32) | read_le<4>(ptr + offset);
+      b = (read_le<4>(ptr + size - 4) << 32) | read_le<4>(ptr + size - 4 - offset);
+    } else if (size > 0) {
+      a = (static_cast<std::uint64_t>(ptr[0]) << 16)
+          | (static_cast<std::uint64_t>(ptr[size >> 1]) << 8) | ptr[size - 1];
+    }
+  } else {
+    size_t remains = size;
+    if (remains > 48) {
+      /// Process 48 bytes at a time in three independent lanes
+      std::uint64_t seed1 = seed, seed2 = seed;
+      do {
+        seed = mix(read_le<8>(ptr) ^ kSecret[1], read_le<8>(ptr + 8) ^ seed);
+        seed1 = mix(read_le<8>(ptr + 16) ^ kSecret[2], read_le<8>(ptr + 24) ^ seed1);
+        seed2 = mix(read_le<8>(ptr + 32) ^ kSecret[3], read_le<8>(ptr + 40) ^ seed2);
+        ptr += 48;
+        remains -= 48;
+      } while (remains > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (remains > 16) {
+      seed = mix(read_le<8>(ptr) ^ kSecret[1], read_le<8>(ptr + 8) ^ seed);
+      ptr += 16;
+      remains -= 16;
+    }
+    a = read_le<8>(ptr + remains - 16);
+    b = read_le<8>(ptr + remains - 8);
+  }
+
+  a ^= kSecret[1];
+  b ^= seed;
+  __uint128_t product = static_cast<__uint128_t>(a) * b;
+  a = static_cast<std::uint64_t>(product);
+  b = static_cast<std::uint64_t>(product >> 64);
+  return mix(a ^ kSecret[0] ^ size, b ^ kSecret[1]);
+}
+
+std::uint64_t hash_key(ByteView data) {
+  auto key = data.primary_key();
+  return hash_bytes(key.data(), key.size());
+}
+
+}  // namespace data
+}  // namespace mapreduce
\ No newline at end of file
@@ -7,8 +7,11 @@
 #include <sstream>
 #include <stdexcept>
 
+#include <unistd.h>
+
 #include "simplemapreduce/commons.h"
 #include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/codec.h"
 #include "simplemapreduce/local/fileformat.h"
 #include "simplemapreduce/local/manager.h"
 #include "simplemapreduce/local/runner.h"
@@ -27,6 +30,10 @@ using namespace mapreduce::util;
 
 namespace mapreduce {
 
+/// Options given on command line are set in the constructor
+template <>
+void Job::set_config(mapreduce::Config, std::string&&);
+
 /* --------------------------------------------------
  *   Constructor/Destructor
  * -------------------------------------------------- */
@@ -35,7 +42,10 @@ Job::Job() {
   file_fmt_ = std::make_unique<LocalFileFormat>();
 
   /// Start networking
-  MPI_Init(nullptr, nullptr);
+  /// Shuffle overlapping with map calls MPI from another thread
+  int provided;
+  MPI_Init_thread(nullptr, nullptr, MPI_THREAD_MULTIPLE, &provided);
+  conf_->mpi_thread_multiple = provided >= MPI_THREAD_MULTIPLE;
   start_up();
 }
 
@@ -52,7 +62,10 @@ Job::Job(int &argc, char *argv[]) {
   file_fmt_ = std::make_unique<LocalFileFormat>();
 
   /// Start networking
-  MPI_Init(&argc, &argv);
+  /// Shuffle overlapping with map calls MPI from another thread
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  conf_->mpi_thread_multiple = provided >= MPI_THREAD_MULTIPLE;
   start_up();
 
   auto inputs = parse_string(parser.get_option("input"));
@@ -61,6 +74,10 @@ Job::Job(int &argc, char *argv[]) {
   
   auto output = parser.get_option("output");
   file_fmt_->set_output_path(std::move(output));
+
+  auto grouping = parser.get_option("grouping");
+  if (!grouping.empty())
+    set_config(mapreduce::Config::grouping, std::move(grouping));
 }
 
 void Job::start_up() {
@@ -76,6 +93,9 @@ void Job::start_up() {
   conf_->worker_size = mpi_size - 1;
   conf_->n_groups = mpi_size - 1;
 
+  /// Spill files are written to a local disk of each node, not to tmpdir shared by workers
+  conf_->spill_dirpath = get_spill_dirpath(fs::temp_directory_path());
+
   if (conf_->mpi_rank == 0) {
     /// Set up master node
     is_master_ = true;
@@ -95,6 +115,10 @@ void Job::start_up() {
   }
 }
 
+fs::path Job::get_spill_dirpath(const fs::path& parent) const {
+  return parent / ("simplemapreduce-" + std::to_string(getpid()));
+}
+
 Job::~Job() {
   /// Close connection
   if (is_valid_)
@@ -105,27 +129,75 @@ Job::~Job() {
  *   Setup
  * -------------------------------------------------- */
 // TODO: remove hardcoded key name
+template <>
+void Job::set_config(mapreduce::Config key, mapreduce::Compression&& value) {
+  std::string keyname;
+  switch (key) {
+    case mapreduce::Config::compression: {
+      /// Keep the current codec if the given one is not built
+      try {
+        get_codec(value);
+      } catch (const std::invalid_argument& e) {
+        if (is_master_)
+          mapreduce::util::logger.warning("Invalid compression: ", e.what());
+        return;
+      }
+      conf_->compression = value;
+      keyname = "compression";
+      break;
+    }
+
+    default: {
+      if (is_master_)
+        mapreduce::util::logger.warning("Invalid parameter key: ", key);
+      return;
+    }
+  }
+
+  /// Only show the change from master node to avoid duplicates
+  if (is_master_)
+    mapreduce::util::logger.info("[Master] Config: ", keyname, "=", static_cast<int>(value));
+}
+
+template <>
+void Job::set_config(mapreduce::Config key, mapreduce::Grouping&& value) {
+  std::string keyname;
+  switch (key) {
+    case mapreduce::Config::grouping: {
+      conf_->grouping = value;
+      keyname = "grouping";
+      break;
+    }
+
+    default: {
+      if (is_master_)
+        mapreduce::util::logger.warning("Invalid parameter key: ", key);
+      return;
+    }
+  }
+
+  /// Only show the change from master node to avoid duplicates
+  if (is_master_)
+    mapreduce::util::logger.info("[Master] Config: ", keyname, "=", value == mapreduce::Grouping::hash ? "hash" : "sort");
+}
+
 template <>
 void Job::set_config(mapreduce::Config key, int&& value) {
   std::string keyname;
   switch (key) {
     case mapreduce::Config::n_groups: {
       keyname = "n_groups";
-      if (value > conf_->worker_size || value < 1) {
-        /// Group size can be at most the number of workers
+      if (value < 1) {
         conf_->n_groups = conf_->worker_size;
         if (is_master_) {
-          if (value > conf_->n_groups) {
-            mapreduce::util::logger.warning("Group size exceeds the number of worker nodes. Use the number of worker nodes instead.");
-          } else if (value == 0) {
-            mapreduce::util::logger.warning("Group size must be non-zero. Use the number of worker nodes instead.");
-          }
+          mapreduce::util::logger.warning("Group size must be positive. Use the number of worker nodes instead.");
           mapreduce::util::logger.info("[Master] Config: ", keyname, "=", conf_->worker_size);
         }
         return;
-      } else {
-        conf_->n_groups = value;
       }
+
+      /// Groups more than workers are assigned to workers at reduce, which needs shuffle via files
+      conf_->n_groups = value;
       break;
     }
 
@@ -141,6 +213,138 @@ void Job::set_config(mapreduce::Config key, int&& value) {
       break;
     }
 
+    case mapreduce::Config::mq_max_bytes: {
+      /// Non-positive value means no limit
+      conf_->mq_max_bytes = value > 0 ? value : 0;
+      keyname = "mq_max_bytes";
+      break;
+    }
+
+    case mapreduce::Config::sort_max_bytes: {
+      /// Non-positive value means no limit
+      conf_->sort_max_bytes = value > 0 ? value : 0;
+      keyname = "sort_max_bytes";
+      break;
+    }
+
+    case mapreduce::Config::front_coding: {
+      conf_->front_coding = value != 0;
+      keyname = "front_coding";
+      break;
+    }
+
+    case mapreduce::Config::mpi_shuffle: {
+      conf_->mpi_shuffle = value != 0;
+      keyname = "mpi_shuffle";
+      break;
+    }
+
+    case mapreduce::Config::sort_output: {
+      conf_->sort_output = value != 0;
+      keyname = "sort_output";
+      break;
+    }
+
+    case mapreduce::Config::sort_runs: {
+      conf_->sort_runs = value != 0;
+      keyname = "sort_runs";
+      break;
+    }
+
+    case mapreduce::Config::compression: {
+      set_config(key, mapreduce::Compression(value));
+      return;
+    }
+
+    case mapreduce::Config::hot_key_salts: {
+      /// Non-positive value disables salting
+      conf_->hot_key_salts = value > 0 ? value : 0;
+      keyname = "hot_key_salts";
+      break;
+    }
+
+    case mapreduce::Config::grouping: {
+      set_config(key, mapreduce::Grouping(value));
+      return;
+    }
+
+    case mapreduce::Config::reduce_threads: {
+      /// Non-positive value means reducing on the calling thread
+      conf_->reduce_threads = value > 1 ? value : 1;
+      keyname = "reduce_threads";
+      break;
+    }
+
+    default: {
+      if (is_master_)
+        mapreduce::util::logger.warning("Invalid parameter key: ", key);
+      return;
+    }
+  }
+
+  /// Only show the change from master node to avoid duplicates
+  if (is_master_)
+    mapreduce::util::logger.info("[Master] Config: ", keyname, "=", value);
+}
+
+template <>
+void Job::set_config(mapreduce::Config key, long&& value) {
+  std::string keyname;
+  switch (key) {
+    case mapreduce::Config::mq_max_bytes: {
+      /// Non-positive value means no limit
+      conf_->mq_max_bytes = value > 0 ? value : 0;
+      keyname = "mq_max_bytes";
+      break;
+    }
+
+    case mapreduce::Config::sort_max_bytes: {
+      /// Non-positive value means no limit
+      conf_->sort_max_bytes = value > 0 ? value : 0;
+      keyname = "sort_max_bytes";
+      break;
+    }
+
+    default: {
+      if (is_master_)
+        mapreduce::util::logger.warning("Invalid parameter key: ", key);
+      return;
+    }
+  }
+
+  /// Only show the change from master node to avoid duplicates
+  if (is_master_)
+    mapreduce::util::logger.info("[Master] Config: ", keyname, "=", value);
+}
+
+template <>
+void Job::set_config(mapreduce::Config key, bool&& value) {
+  std::string keyname;
+  switch (key) {
+    case mapreduce::Config::front_coding: {
+      conf_->front_coding = value;
+      keyname = "front_coding";
+      break;
+    }
+
+    case mapreduce::Config::mpi_shuffle: {
+      conf_->mpi_shuffle = value;
+      keyname = "mpi_shuffle";
+      break;
+    }
+
+    case mapreduce::Config::sort_output: {
+      conf_->sort_output = value;
+      keyname = "sort_output";
+      break;
+    }
+
+    case mapreduce::Config::sort_runs: {
+      conf_->sort_runs = value;
+      keyname = "sort_runs";
+      break;
+    }
+
     default: {
       if (is_master_)
         mapreduce::util::logger.warning("Invalid parameter key: ", key);
@@ -189,6 +393,23 @@ void Job::set_config(mapreduce::Config key, std::string&& value) {
       break;
     }
 
+    case mapreduce::Config::spill_dirpath: {
+      /// A directory of this process is made under the given one, which is removed after the job
+      conf_->spill_dirpath = get_spill_dirpath(value);
+      keyname = "spill_dirpath";
+      value = conf_->spill_dirpath.string();
+      break;
+    }
+
+    case mapreduce::Config::grouping: {
+      /// Grouping is given by name on command line
+      if (value == "sort" || value == "hash")
+        set_config(key, value == "hash" ? mapreduce::Grouping::hash : mapreduce::Grouping::sort);
+      else if (is_master_)
+        mapreduce::util::logger.warning("Invalid grouping: ", value);
+      return;
+    }
+
     default: {
       return;
     }
@@ -238,6 +459,14 @@ int Job::run() {
   /// Not run when -h/--help option is passed
   if (!is_valid_) return 0;
 
+  /// Groups shuffled over MPI are bound to the workers receiving them
+  if (conf_->mpi_shuffle && conf_->n_groups > conf_->worker_size) {
+    if (is_master_)
+      logger.warning("Group size exceeds the number of worker nodes, which needs shuffle via files. "
+                     "Use the number of worker nodes instead.");
+    conf_->n_groups = conf_->worker_size;
+  }
+
   /// send target file to each node
   if (is_master_) {
     if (!has_mapper_ || !has_reducer_)
@@ -255,6 +484,7 @@ int Job::run() {
   } else {
     conf_->output_dirpath = file_fmt_->get_output_path();
     job_runner_->start();
+    fs::remove_all(conf_->spill_dirpath);
     logger.debug("[Worker] Finished all tasks on worker ", conf_->worker_rank);
   }
 
@@ -19,5 +19,9 @@ void JobRunner::set_reducer(std::unique_ptr<mapreduce::base::ReduceTask> reducer
   reducer_->set_conf(conf_);
 };
 
+void JobRunner::set_partitioner(std::unique_ptr<mapreduce::base::PartitionTask> partitioner) {
+  partitioner_ = std::move(partitioner);
+};
+
 }  // namespace base
 }  // namespace mapreduce
\ No newline at end of file
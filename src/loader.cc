@@ -1,5 +1,10 @@
 #include "simplemapreduce/proc/loader.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
 #include <string>
 
 #include "simplemapreduce/commons.h"
@@ -12,7 +17,7 @@ namespace mapreduce {
 namespace proc {
 
 template <typename T>
-inline ByteData load_byte_data_(std::ifstream& fin) {
+inline ByteData load_byte_data_(std::istream& fin) {
   char buffer[sizeof(T)];
   fin.read(&buffer[0], sizeof(T));
   if (fin.eof())
@@ -24,32 +29,32 @@ inline ByteData load_byte_data_(std::ifstream& fin) {
 }
 
 template<>
-ByteData load_byte_data<Int16>(std::ifstream& fin) {
+ByteData load_byte_data<Int16>(std::istream& fin) {
   return load_byte_data_<Int16>(fin);
 }
 
 template<>
-ByteData load_byte_data<Int>(std::ifstream& fin) {
+ByteData load_byte_data<Int>(std::istream& fin) {
   return load_byte_data_<Int>(fin);
 }
 
 template<>
-ByteData load_byte_data<Long>(std::ifstream& fin) {
+ByteData load_byte_data<Long>(std::istream& fin) {
   return load_byte_data_<Long>(fin);
 }
 
 template<>
-ByteData load_byte_data<Float>(std::ifstream& fin) {
+ByteData load_byte_data<Float>(std::istream& fin) {
   return load_byte_data_<Float>(fin);
 }
 
 template<>
-ByteData load_byte_data<Double>(std::ifstream& fin) {
+ByteData load_byte_data<Double>(std::istream& fin) {
   return load_byte_data_<Double>(fin);
 }
 
 template<>
-ByteData load_byte_data<String>(std::ifstream& fin) {
+ByteData load_byte_data<String>(std::istream& fin) {
   Size_t data_size;
   fin.read(reinterpret_cast<char*>(&data_size), sizeof(Size_t));
 
@@ -64,11 +69,231 @@ ByteData load_byte_data<String>(std::ifstream& fin) {
   return data;
 }
 
+bool read_varint(std::istream& fin, std::uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    char byte;
+    if (!fin.get(byte))
+      return false;
+
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+namespace {
+
+/**
+ * Input stream buffer of the segments of a partition, which are read by pread.
+ * The position is the offset in the concatenated bytes of the segments.
+ */
+class SegmentBuffer : public std::streambuf {
+ public:
+  SegmentBuffer(std::shared_ptr<const int> fd, const std::vector<FileSegment>& segments)
+      : fd_(fd), segments_(segments) {
+    starts_.reserve(segments_.size() + 1);
+    starts_.push_back(0);
+    for (auto& segment: segments_)
+      starts_.push_back(starts_.back() + segment.size);
+  }
+
+ protected:
+  int_type underflow() override {
+    if (gptr() < egptr())
+      return traits_type::to_int_type(*gptr());
+
+    /// Read a chunk from the segment of the next position, not crossing the end of the segment
+    std::uint64_t next = pos_ + (egptr() - eback());
+    if (next >= starts_.back())
+      return traits_type::eof();
+
+    size_t i = std::upper_bound(starts_.begin(), starts_.end(), next) - starts_.begin() - 1;
+    size_t size = std::min<std::uint64_t>(PartitionedFileReader::kChunkBytes, starts_[i + 1] - next);
+    buffer_.resize(PartitionedFileReader::kChunkBytes);
+    ssize_t n_read = ::pread(*fd_, buffer_.data(), size, segments_[i].offset + (next - starts_[i]));
+    if (n_read <= 0)
+      return traits_type::eof();
+
+    pos_ = next;
+    setg(buffer_.data(), buffer_.data(), buffer_.data() + n_read);
+    return traits_type::to_int_type(*gptr());
+  }
+
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+    if (dir == std::ios_base::cur)
+      off += pos_ + (gptr() - eback());
+    else if (dir == std::ios_base::end)
+      off += starts_.back();
+    return seekpos(off, which);
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    off_type off = pos;
+    if (!(which & std::ios_base::in) || off < 0 || static_cast<std::uint64_t>(off) > starts_.back())
+      return pos_type(off_type(-1));
+
+    /// Keep the buffer if the position is in it
+    if (static_cast<std::uint64_t>(off) >= pos_ && static_cast<std::uint64_t>(off) <= pos_ + (egptr() - eback())) {
+      setg(eback(), eback() + (off - pos_), egptr());
+    } else {
+      pos_ = off;
+      setg(nullptr, nullptr, nullptr);
+    }
+    return pos;
+  }
+
+ private:
+  std::shared_ptr<const int> fd_;
+  std::vector<FileSegment> segments_;
+
+  /// Offsets of the segments in the partition bytes, followed by the total size
+  std::vector<std::uint64_t> starts_;
+
+  /// Offset of the buffer in the partition bytes
+  std::uint64_t pos_{0};
+  std::vector<char> buffer_;
+};
+
+/** Input stream owning SegmentBuffer. */
+class SegmentStream : public std::istream {
+ public:
+  SegmentStream(std::shared_ptr<const int> fd, const std::vector<FileSegment>& segments)
+      : std::istream(nullptr), buffer_(fd, segments) {
+    rdbuf(&buffer_);
+  }
+
+ private:
+  SegmentBuffer buffer_;
+};
+
+}  // namespace
+
+PartitionedFileReader::PartitionedFileReader(const std::filesystem::path& path) {
+  std::ifstream fin(PartitionedFileWriter::index_path(path), std::ios::binary);
+  if (!fin.is_open())
+    return;
+
+  char header[kPartitionIndexMagicSize];
+  fin.read(header, kPartitionIndexMagicSize);
+  std::uint64_t n_partitions;
+  if (fin.gcount() != kPartitionIndexMagicSize
+      || !std::equal(header, header + kPartitionIndexMagicSize, kPartitionIndexMagic)
+      || !read_varint(fin, n_partitions))
+    throw std::runtime_error("Invalid partition index of " + path.string());
+
+  index_.resize(n_partitions);
+  for (auto& segments: index_) {
+    std::uint64_t n_segments;
+    if (!read_varint(fin, n_segments))
+      throw std::runtime_error("Invalid partition index of " + path.string());
+
+    segments.resize(n_segments);
+    for (auto& segment: segments) {
+      if (!read_varint(fin, segment.offset) || !read_varint(fin, segment.size))
+        throw std::runtime_error("Invalid partition index of " + path.string());
+    }
+  }
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Failed to open " + path.string());
+  fd_ = std::shared_ptr<const int>(new int(fd), [](const int* fd) {
+    ::close(*fd);
+    delete fd;
+  });
+}
+
+std::shared_ptr<std::istream> PartitionedFileReader::open(int id) const {
+  if (id < 0 || id >= size() || index_[id].empty())
+    return nullptr;
+  return std::make_shared<SegmentStream>(fd_, index_[id]);
+}
+
+bool RunReader::fill_(size_t size) {
+  size_t available = buffer_.size() - pos_;
+  if (available >= size)
+    return true;
+  if (size - available > n_bytes_)
+    return false;
+
+  /// Drop consumed bytes and read at least a chunk
+  buffer_.erase(buffer_.begin(), buffer_.begin() + pos_);
+  pos_ = 0;
+  size_t n_read = std::min<std::uint64_t>(std::max(size - available, kChunkBytes), n_bytes_);
+  buffer_.resize(available + n_read);
+
+  fin_->clear();
+  fin_->seekg(offset_);
+  fin_->read(buffer_.data() + available, n_read);
+  if (static_cast<size_t>(fin_->gcount()) != n_read)
+    return false;
+
+  offset_ += n_read;
+  n_bytes_ -= n_read;
+  return true;
+}
+
+bool RunReader::read_varint_(std::uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (!fill_(1))
+      return false;
+
+    char byte = buffer_[pos_++];
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool RunReader::next() {
+  if (n_records_ == 0)
+    return false;
+  --n_records_;
+
+  /// Restore the key from the prefix of the previous key
+  std::uint64_t shared, suffix;
+  if (!read_varint_(shared) || !read_varint_(suffix) || shared > key_.size() || !fill_(suffix))
+    return false;
+  key_.resize(shared);
+  key_.append(buffer_.data() + pos_, suffix);
+  pos_ += suffix;
+
+  if (!read_varint_(value_size_) || !fill_(value_size_))
+    return false;
+  value_pos_ = pos_;
+  pos_ += value_size_;
+  return true;
+}
+
+RecordBatch DataLoader::get_batch() {
+  RecordBatch batch;
+  if (finished_)
+    return batch;
+
+  while (batch.bytes() < RecordBatch::kDefaultCapacity) {
+    auto item = get_item();
+    if (item.first.empty()) {
+      finished_ = true;
+      break;
+    }
+    batch.append(item.first, item.second);
+  }
+  return batch;
+}
+
 BytePair MQDataLoader::get_item() {
   /// Fetch data from MessageQueue
   /// A key of last element will be empty.
   return mq_->receive();
 }
 
+RecordBatch MQDataLoader::get_batch() {
+  return mq_->receive_batch();
+}
+
 } // namespace proc
 } // namespace mapreduce
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <mpi.h>
 
 #include "simplemapreduce/base/job_tasks.h"
+#include "simplemapreduce/proc/mpi_channel.h"
 #include "simplemapreduce/util/log.h"
 
 using namespace mapreduce::base;
@@ -67,6 +68,14 @@ void LocalJobManager::start_mapper_tasks() {
   for (int i = 0; i < conf_->worker_size; ++i)
     MPI_Isend("\0", 1, MPI_CHAR, i+1, TaskType::ready, MPI_COMM_WORLD, &mpi_reqs[i]);
 
+  /// Compute ranges of keys to partition for sorted output
+  if (conf_->sort_output)
+    mapreduce::proc::broadcast_split_points(*conf_);
+
+  /// Collect hot keys salted at shuffle to merge them after reduce
+  if (conf_->hot_key_salts > 1 && !conf_->sort_output)
+    mapreduce::proc::broadcast_hot_keys(*conf_);
+
   /// Get signals of finished tasks up to shuffle
   for (int i = 0; i < conf_->worker_size; ++i)
     MPI_Irecv(&tmp, 1, MPI_CHAR, i+1, TaskType::shuffle_end, MPI_COMM_WORLD, &mpi_reqs[i]);
@@ -83,6 +92,10 @@ void LocalJobManager::start_reducer_tasks() {
   for (int i = 1; i <= conf_->worker_size; ++i)
     MPI_Send("\0", 1, MPI_CHAR, i, TaskType::sort_start, MPI_COMM_WORLD);
 
+  /// Groups in files can be reduced on any worker
+  if (!conf_->mpi_shuffle)
+    assign_groups();
+
   /// Check all process have been finished
   char tmp;
   for (int i = 0; i < conf_->worker_size; ++i)
@@ -94,5 +107,31 @@ void LocalJobManager::start_reducer_tasks() {
   logger.debug("[Master] All Reduces finished");
 }
 
+void LocalJobManager::assign_groups() {
+  /// Find available workers from the beginning,
+  /// so that each worker first takes the group of its rank, whose records of the worker are in memory
+  mpi_reqs.clear();
+  mpi_worker_statuses.clear();
+
+  char tmp;
+  for (int id = 0; id < conf_->n_groups; ++id) {
+    int worker_id = find_available_worker();
+    MPI_Send(&id, 1, MPI_INT, worker_id+1, TaskType::reduce_data, MPI_COMM_WORLD);
+
+    /// Wait for the worker becomes free
+    MPI_Irecv(&tmp, 1, MPI_CHAR, worker_id+1, TaskType::reduce_end, MPI_COMM_WORLD, &mpi_reqs[worker_id]);
+  }
+
+  MPI_Waitall(mpi_reqs.size(), mpi_reqs.data(), mpi_worker_statuses.data());
+
+  while (static_cast<int>(mpi_reqs.size()) < conf_->worker_size)
+    find_available_worker();
+
+  /// Notify no group is left, then workers send reduce_end again once all tasks finished
+  int end = -1;
+  for (int i = 1; i <= conf_->worker_size; ++i)
+    MPI_Send(&end, 1, MPI_INT, i, TaskType::reduce_data, MPI_COMM_WORLD);
+}
+
 }  // namespace local
 }  // namespace mapreduce
\ No newline at end of file
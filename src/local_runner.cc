@@ -1,13 +1,19 @@
 #include "simplemapreduce/local/runner.h"
 
+#include <cstdint>
 #include <future>
+#include <iomanip>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <mpi.h>
 
 #include "simplemapreduce/commons.h"
 #include "simplemapreduce/base/job_tasks.h"
 #include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/proc/mpi_channel.h"
 
 namespace fs = std::filesystem;
 
@@ -39,6 +45,10 @@ void LocalJobRunner::start() {
   run_map_tasks();
   run_shuffle_tasks();
 
+  /// The master waits for hot keys from all workers whenever salting is configured
+  if (conf_->hot_key_salts > 1 && !conf_->sort_output)
+    share_hot_keys();
+
   /// Send signal to notify finished tasks up to shuffle
   MPI_Send("\0", 1, MPI_CHAR, 0, TaskType::shuffle_end, MPI_COMM_WORLD);
 
@@ -56,6 +66,25 @@ void LocalJobRunner::start() {
 void LocalJobRunner::run_map_tasks() {
   /// Send signal to notify enqueue step is finished
   auto mq = mapper_->get_mq();
+  reduce_mq_ = std::make_shared<MessageQueue>();
+  mapper_->set_partitioner(partitioner_);
+
+  /// Spill data when the queue exceeds the memory limit.
+  /// Files are stored in a node-local directory of this process, not in tmpdir shared by workers.
+  if (conf_->mq_max_bytes > 0) {
+    auto& spill_dir = conf_->spill_dirpath;
+    fs::create_directories(spill_dir);
+
+    std::ostringstream oss;
+    oss << std::setw(4) << std::setfill('0') << conf_->worker_rank;
+    mq->set_max_bytes(conf_->mq_max_bytes, spill_dir / oss.str());
+    reduce_mq_->set_max_bytes(conf_->mq_max_bytes, spill_dir / (oss.str() + "-reduce"));
+  }
+  reducer_->set_mq(reduce_mq_);
+
+  /// Keys taking over a quarter of the average records per group are spread over groups
+  if (can_salt_hot_keys())
+    sketch_ = std::make_shared<mapreduce::proc::HotKeySketch>(16 * conf_->n_groups, 0.25 / conf_->n_groups);
 
   std::future<void> combiner_ftr;
 
@@ -65,6 +94,13 @@ void LocalJobRunner::run_map_tasks() {
     combiner_ftr = std::async(std::launch::async, [&]{ combiner_->run(); });
   }
 
+  /// Partition and write records as soon as mapper emits them,
+  /// so that the end of map only flushes buffered records
+  if (can_overlap_shuffle()) {
+    logger.debug("[Worker] Running Shuffle with Map on worker ", conf_->worker_rank);
+    shuffle_ftr_ = std::async(std::launch::async, [shuffle = get_shuffle()]{ shuffle->run(); });
+  }
+
   while (true) {
     char req;
     MPI_Recv(&req, 1, MPI_CHAR, 0, TaskType::ready, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
@@ -102,18 +138,90 @@ void LocalJobRunner::run_map_tasks() {
     combiner_ftr.get();
   }
 
-  reducer_->set_mq(mq);
-
   logger.debug("[Worker] Finished Map on worker ", conf_->worker_rank);
 }
 
-void LocalJobRunner::run_shuffle_tasks() {
+bool LocalJobRunner::can_overlap_shuffle() const {
+  if (combiner_ != nullptr || conf_->sort_output)
+    return false;
+  return !conf_->mpi_shuffle || conf_->mpi_thread_multiple;
+}
+
+std::unique_ptr<mapreduce::proc::ShuffleTask> LocalJobRunner::get_shuffle() {
   auto shuffle = mapper_->get_shuffle();
-  shuffle->run();
+  shuffle->set_output(reduce_mq_);
+  shuffle->set_sketch(sketch_);
+
+  /// Records of this worker are grouped for the reducer without passing the queue,
+  /// and the sorter spills them to files over the memory limit
+  shuffle->set_local_sorter(reducer_->get_local_sorter());
+  return shuffle;
+}
+
+bool LocalJobRunner::can_salt_hot_keys() const {
+  if (conf_->hot_key_salts < 2 || conf_->sort_output)
+    return false;
+
+  /// Partial outputs are merged on the worker of the group, so that groups must not exceed workers
+  if (partitioner_ != nullptr || !reducer_->can_reduce_outputs() || conf_->n_groups > conf_->worker_size) {
+    if (conf_->worker_rank == 0)
+      logger.warning("Hot keys are not salted, which needs the default Partitioner, "
+                     "Reducer with the same input and output types, and groups not more than workers.");
+    return false;
+  }
+  return true;
+}
+
+void LocalJobRunner::share_hot_keys() {
+  /// Workers not salting keys report nothing
+  static const std::unordered_map<std::uint64_t, std::uint64_t> no_keys;
+  auto salted = sketch_ == nullptr ? mapreduce::proc::exchange_hot_keys(no_keys, 0)
+                                   : mapreduce::proc::exchange_hot_keys(sketch_->hot_keys(), sketch_->count());
+
+  if (!salted.empty())
+    logger.debug("[Worker] Merging ", salted.size(), " salted keys after reduce on worker ", conf_->worker_rank);
+  reducer_->set_salted_keys(std::move(salted));
+}
+
+void LocalJobRunner::run_shuffle_tasks() {
+  if (shuffle_ftr_.valid()) {
+    /// Remaining records are flushed once the shuffle reaches the end of map
+    shuffle_ftr_.get();
+    return;
+  }
+
+  if (conf_->sort_output) {
+    /// Partition by ranges of keys sampled on all workers so that group i has smaller keys than group i+1
+    auto sampler = mapper_->get_sampler();
+    auto splits = mapreduce::proc::exchange_samples(sampler ? sampler->samples() : std::vector<std::string>{});
+    mapper_->set_range_partitioner(std::move(splits));
+  }
+
+  get_shuffle()->run();
 }
 
 void LocalJobRunner::run_reduce_tasks() {
-  reducer_->run();
+  if (conf_->mpi_shuffle) {
+    /// Records of the group of this worker are already sent to this worker
+    reducer_->run();
+  } else {
+    /// Reduce groups assigned by the master until it sends a negative ID
+    while (true) {
+      int id;
+      MPI_Recv(&id, 1, MPI_INT, 0, TaskType::reduce_data, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      if (id < 0)
+        break;
+
+      logger.debug("[Worker] Assigned group ", id, " to worker ", conf_->worker_rank);
+      reducer_->set_group(id);
+      reducer_->run();
+
+      /// Notify the group is reduced
+      MPI_Send("\1", 1, MPI_CHAR, 0, TaskType::reduce_end, MPI_COMM_WORLD);
+    }
+  }
+
+  reducer_->finish();
 }
 
 }  // namespace local
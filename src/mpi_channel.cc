@@ -0,0 +1,243 @@
+#include "simplemapreduce/proc/mpi_channel.h"
+
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include "simplemapreduce/base/job_tasks.h"
+#include "simplemapreduce/proc/sampler.h"
+#include "simplemapreduce/util/log.h"
+
+using namespace mapreduce::base;
+using namespace mapreduce::data;
+
+namespace mapreduce {
+namespace proc {
+
+/** Convert a worker rank to MPI rank, where rank 0 is the master. */
+static inline int to_mpi_rank(int worker) { return worker + 1; }
+
+MPIChannel::MPIChannel(std::shared_ptr<MessageQueue> mq, std::shared_ptr<mapreduce::JobConf> conf)
+    : mq_(std::move(mq)), conf_(std::move(conf)), codec_(get_codec(conf_->compression)),
+      outboxes_(conf_->worker_size) {}
+
+MPIChannel::~MPIChannel() {
+  /// Buffers must not be released while sending
+  for (auto& outbox: outboxes_) {
+    for (auto& request: outbox.requests) {
+      if (request != MPI_REQUEST_NULL)
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+    }
+  }
+}
+
+void MPIChannel::send(int worker, RecordBatch& batch) {
+  if (batch.empty())
+    return;
+
+  auto& outbox = outboxes_[worker];
+  auto& buffer = outbox.buffers[outbox.next];
+  auto& request = outbox.requests[outbox.next];
+  outbox.next ^= 1;
+
+  /// Reuse the buffer once the previous send from it completes
+  wait_(request);
+
+  buffer.clear();
+  batch.encode();
+  if (codec_ != nullptr) {
+    /// Serialize and compress the batch to reduce bytes sent over the network
+    packed_.clear();
+    batch.write(packed_);
+    write_block(*codec_, packed_.data(), packed_.size(), buffer);
+    stats_.raw_bytes += packed_.size();
+    stats_.stored_bytes += buffer.size();
+  } else {
+    batch.write(buffer);
+  }
+  batch.clear();
+
+  MPI_Isend(buffer.data(), buffer.size(), MPI_CHAR, to_mpi_rank(worker),
+            TaskType::shuffle_data, MPI_COMM_WORLD, &request);
+}
+
+void MPIChannel::poll() {
+  int arrived;
+  MPI_Status status;
+  while (true) {
+    MPI_Iprobe(MPI_ANY_SOURCE, TaskType::shuffle_data, MPI_COMM_WORLD, &arrived, &status);
+    if (!arrived)
+      break;
+    receive_(status);
+  }
+}
+
+void MPIChannel::finish() {
+  if (finished_)
+    return;
+  finished_ = true;
+
+  /// Empty message notifies the end of data, which arrives after all batches from the same worker
+  std::vector<MPI_Request> end_requests;
+  for (int worker = 0; worker < conf_->worker_size; ++worker) {
+    if (worker == conf_->worker_rank)
+      continue;
+
+    auto& outbox = outboxes_[worker];
+    end_requests.emplace_back(MPI_REQUEST_NULL);
+    MPI_Isend(nullptr, 0, MPI_CHAR, to_mpi_rank(worker),
+              TaskType::shuffle_data, MPI_COMM_WORLD, &end_requests.back());
+
+    for (auto& request: outbox.requests)
+      wait_(request);
+  }
+
+  /// Nothing left to send, so block until other workers finish
+  while (n_finished_ < conf_->worker_size - 1) {
+    MPI_Status status;
+    MPI_Probe(MPI_ANY_SOURCE, TaskType::shuffle_data, MPI_COMM_WORLD, &status);
+    receive_(status);
+  }
+
+  for (auto& request: end_requests)
+    wait_(request);
+
+  if (codec_ != nullptr)
+    mapreduce::util::logger.info("[Worker] Compressed shuffled data over MPI: ", stats_.raw_bytes, " bytes to ",
+                                 stats_.stored_bytes, " bytes (ratio ", stats_.ratio(), ") on worker ", conf_->worker_rank);
+}
+
+void MPIChannel::receive_(const MPI_Status& status) {
+  int size;
+  MPI_Get_count(&status, MPI_CHAR, &size);
+
+  inbox_.resize(size);
+  MPI_Recv(inbox_.data(), size, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+  if (size == 0) {
+    ++n_finished_;
+    return;
+  }
+
+  const char* data = inbox_.data();
+  size_t data_size = inbox_.size();
+  if (codec_ != nullptr) {
+    if (!read_block(*codec_, data, data_size, unpacked_))
+      throw std::runtime_error("Invalid compressed shuffle data is received.");
+    data = unpacked_.data();
+    data_size = unpacked_.size();
+  }
+
+  RecordBatch batch;
+  if (!batch.read(data, data_size))
+    throw std::runtime_error("Invalid shuffle data is received.");
+  mq_->send_batch(std::move(batch));
+}
+
+void MPIChannel::wait_(MPI_Request& request) {
+  int done = 0;
+  while (true) {
+    MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+    if (done)
+      break;
+    poll();
+  }
+}
+
+/** Broadcast bytes from the master to all ranks. */
+static void broadcast_bytes(std::vector<char>& data) {
+  unsigned long size = data.size();
+  MPI_Bcast(&size, 1, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+  data.resize(size);
+  MPI_Bcast(data.data(), size, MPI_CHAR, 0, MPI_COMM_WORLD);
+}
+
+std::vector<std::string> exchange_samples(const std::vector<std::string>& samples) {
+  std::vector<char> data;
+  write_keys(samples, data);
+  MPI_Send(data.data(), data.size(), MPI_CHAR, 0, TaskType::shuffle_start, MPI_COMM_WORLD);
+
+  data.clear();
+  broadcast_bytes(data);
+  return read_keys(data.data(), data.size());
+}
+
+void broadcast_split_points(const mapreduce::JobConf& conf) {
+  std::vector<std::string> samples;
+  std::vector<char> data;
+  for (int i = 0; i < conf.worker_size; ++i) {
+    MPI_Status status;
+    MPI_Probe(MPI_ANY_SOURCE, TaskType::shuffle_start, MPI_COMM_WORLD, &status);
+
+    int size;
+    MPI_Get_count(&status, MPI_CHAR, &size);
+    data.resize(size);
+    MPI_Recv(data.data(), size, MPI_CHAR, status.MPI_SOURCE, status.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    auto keys = read_keys(data.data(), size);
+    samples.insert(samples.end(), std::make_move_iterator(keys.begin()), std::make_move_iterator(keys.end()));
+  }
+
+  data.clear();
+  write_keys(split_points(std::move(samples), conf.n_groups), data);
+  broadcast_bytes(data);
+}
+
+/** Broadcast 64-bit words from the master to all ranks. */
+static void broadcast_words(std::vector<std::uint64_t>& data) {
+  unsigned long size = data.size();
+  MPI_Bcast(&size, 1, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+  data.resize(size);
+  MPI_Bcast(data.data(), size, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+}
+
+std::unordered_set<std::uint64_t> exchange_hot_keys(const std::unordered_map<std::uint64_t, std::uint64_t>& hot_keys,
+                                                    std::uint64_t n_records) {
+  /// Send the number of records followed by pairs of (hash, count)
+  std::vector<std::uint64_t> data{n_records};
+  for (auto& [hash, count]: hot_keys) {
+    data.push_back(hash);
+    data.push_back(count);
+  }
+  MPI_Send(data.data(), data.size(), MPI_UINT64_T, 0, TaskType::shuffle_hot_keys, MPI_COMM_WORLD);
+
+  data.clear();
+  broadcast_words(data);
+  return std::unordered_set<std::uint64_t>(data.begin(), data.end());
+}
+
+void broadcast_hot_keys(const mapreduce::JobConf& conf) {
+  std::unordered_map<std::uint64_t, std::uint64_t> counts;
+  std::uint64_t n_records = 0;
+  std::vector<std::uint64_t> data;
+  for (int i = 0; i < conf.worker_size; ++i) {
+    MPI_Status status;
+    MPI_Probe(MPI_ANY_SOURCE, TaskType::shuffle_hot_keys, MPI_COMM_WORLD, &status);
+
+    int size;
+    MPI_Get_count(&status, MPI_UINT64_T, &size);
+    data.resize(size);
+    MPI_Recv(data.data(), size, MPI_UINT64_T, status.MPI_SOURCE, status.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    if (data.empty() || data.size() % 2 == 0)
+      throw std::runtime_error("Invalid hot key data is received.");
+    n_records += data[0];
+    for (size_t j = 1; j < data.size(); j += 2)
+      counts[data[j]] += data[j + 1];
+  }
+
+  data.clear();
+  std::uint64_t n_hot_records = 0;
+  for (auto& [hash, count]: counts) {
+    data.push_back(hash);
+    n_hot_records += count;
+  }
+
+  if (!counts.empty())
+    mapreduce::util::logger.info("[Master] Salted ", counts.size(), " hot keys over ", conf.hot_key_salts,
+                                 " groups, which have about ", n_hot_records, " of ", n_records, " records");
+  broadcast_words(data);
+}
+
+}  // namespace proc
+}  // namespace mapreduce
\ No newline at end of file
@@ -1,43 +1,222 @@
 #include "simplemapreduce/data/queue.h"
 
+#include <stdexcept>
 #include <string>
+#include <system_error>
 
 namespace mapreduce {
 namespace data {
 
-MessageQueue::MessageQueue(const MessageQueue& rhs) {
-  this->queue_ = std::move(rhs.queue_);
+/// Number of checks before the consumer starts sleeping
+constexpr int kSpinCount = 1024;
+
+MessageQueue::MessageQueue() {
+  head_ = tail_ = new Segment();
+}
+
+MessageQueue::~MessageQueue() {
+  /// Remove spill files not replayed
+  std::error_code err;
+  if (spill_out_.is_open()) {
+    spill_out_.close();
+    std::filesystem::remove(spill_path_, err);
+  }
+  if (replay_in_.is_open()) {
+    replay_in_.close();
+    std::filesystem::remove(replay_path_, err);
+  }
+
+  while (head_ != nullptr) {
+    for (auto& slot: head_->slots)
+      if (!slot.spill.empty())
+        std::filesystem::remove(slot.spill, err);
+
+    auto next = head_->next.load(std::memory_order_relaxed);
+    delete head_;
+    head_ = next;
+  }
+}
+
+void MessageQueue::set_max_bytes(size_t max_bytes, const std::filesystem::path& prefix) {
+  max_bytes_ = max_bytes;
+  spill_prefix_ = prefix;
 }
 
 BytePair MessageQueue::receive() {
-  std::unique_lock<std::mutex> lock{mq_mutex_};
-  cond_.wait(lock, [this] { return !queue_.empty(); });
+  if (cursor_ >= current_.size()) {
+    current_ = pop_();
+    current_.encode();
+    cursor_ = 0;
 
-  BytePair data = std::move(queue_.front());
-  queue_.pop_front();
+    /// Return empty data when received the end signal
+    if (current_.empty())
+      return BytePair();
+  }
 
-  return data;
+  return current_.get_item(cursor_++);
+}
+
+RecordBatch MessageQueue::receive_batch() {
+  /// Return rest of records partially read by receive()
+  if (cursor_ < current_.size()) {
+    RecordBatch batch;
+    for (; cursor_ < current_.size(); ++cursor_)
+      batch.append(current_, cursor_);
+    return batch;
+  }
+
+  return pop_();
 }
 
 void MessageQueue::send(ByteData&& key, ByteData&& value) {
-  this->send(std::make_pair(std::move(key), std::move(value)));
+  RecordBatch batch;
+  batch.append(key, value);
+  send_batch(std::move(batch));
 }
 
 void MessageQueue::send(BytePair&& data) {
-  std::lock_guard<std::mutex> lock{mq_mutex_};
+  this->send(std::move(data.first), std::move(data.second));
+}
+
+void MessageQueue::send_batch(RecordBatch&& batch) {
+  if (batch.empty())
+    return;
+
+  /// A producer writing a spill file holds the lock for long, so that others sleep instead of spinning
+  std::lock_guard<std::mutex> lock{producer_mutex_};
 
   /// Data is stored with format encoded by context
-  queue_.push_back(std::move(data));
-  cond_.notify_one();
+  send_(std::move(batch));
 }
 
 void MessageQueue::end() {
-  std::lock_guard<std::mutex> lock{mq_mutex_};
+  std::lock_guard<std::mutex> lock{producer_mutex_};
+
+  if (spill_out_.is_open())
+    close_spill_();
+
+  /// Send empty batch to tell the end of the process
+  push_(Slot());
+}
+
+void MessageQueue::send_(RecordBatch&& batch) {
+  if (max_bytes_ > 0) {
+    auto bytes = bytes_.load(std::memory_order_relaxed);
+
+    /// Keep spilling until the consumer reads half of the batches in memory
+    if (spill_out_.is_open() && bytes <= max_bytes_ / 2)
+      close_spill_();
+
+    /// Keep at least one batch in memory so that the consumer can proceed
+    if (spill_out_.is_open() || (bytes > 0 && bytes + batch.bytes() > max_bytes_)) {
+      if (!spill_out_.is_open()) {
+        spill_path_ = spill_prefix_.string() + "-" + std::to_string(n_spills_++);
+        spill_out_.open(spill_path_, std::ios::binary);
+        if (!spill_out_)
+          throw std::runtime_error("Failed to open a spill file: " + spill_path_.string());
+      }
+      batch.encode();
+      batch.write(spill_out_);
+      spill_bytes_ += batch.bytes();
+
+      /// Publish spill files in limited size so that the consumer can replay them early
+      if (spill_bytes_ >= max_bytes_)
+        close_spill_();
+      return;
+    }
+  }
+
+  bytes_.fetch_add(batch.bytes(), std::memory_order_relaxed);
+  push_(Slot{std::move(batch), {}});
+}
+
+void MessageQueue::close_spill_() {
+  spill_out_.close();
+  if (!spill_out_)
+    throw std::runtime_error("Failed to write a spill file: " + spill_path_.string());
+
+  push_(Slot{RecordBatch(), std::move(spill_path_)});
+  spill_path_.clear();
+  spill_bytes_ = 0;
+}
+
+void MessageQueue::push_(Slot&& slot) {
+
+  /// Link a new segment when the current one is full.
+  /// The link is visible to the consumer by publishing the first batch of the segment.
+  if (tail_index_ == kSegmentSize) {
+    auto segment = new Segment();
+    tail_->next.store(segment, std::memory_order_relaxed);
+    tail_ = segment;
+    tail_index_ = 0;
+  }
+  tail_->slots[tail_index_++] = std::move(slot);
+  n_written_.fetch_add(1, std::memory_order_seq_cst);
+
+  /// Wake up the consumer only when it is sleeping
+  if (waiting_.load(std::memory_order_seq_cst)) {
+    std::lock_guard<std::mutex> lock{wait_mutex_};
+    cond_.notify_one();
+  }
+}
+
+RecordBatch MessageQueue::pop_() {
+  RecordBatch batch;
+
+  /// Replay spilled batches in order before the following slots
+  if (replay_in_.is_open()) {
+    if (batch.read(replay_in_))
+      return batch;
+
+    replay_in_.close();
+    std::filesystem::remove(replay_path_);
+  }
+
+  Slot slot = pop_slot_();
+  if (slot.spill.empty()) {
+    bytes_.fetch_sub(slot.batch.bytes(), std::memory_order_relaxed);
+    return std::move(slot.batch);
+  }
+
+  /// Spill file contains at least one batch
+  replay_path_ = std::move(slot.spill);
+  replay_in_.open(replay_path_, std::ios::binary);
+  if (!batch.read(replay_in_))
+    throw std::runtime_error("Failed to read a spill file: " + replay_path_.string());
+  return batch;
+}
+
+MessageQueue::Slot MessageQueue::pop_slot_() {
+  wait_();
+
+  /// Move to the next segment after consuming all batches in the current one
+  if (head_index_ == kSegmentSize) {
+    auto segment = head_->next.load(std::memory_order_relaxed);
+    delete head_;
+    head_ = segment;
+    head_index_ = 0;
+  }
+  Slot slot = std::move(head_->slots[head_index_]);
+  head_->slots[head_index_++].spill.clear();
+  n_read_.store(n_read_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+  return slot;
+}
+
+void MessageQueue::wait_() {
+  auto read = n_read_.load(std::memory_order_relaxed);
+  auto has_data = [this, read] { return n_written_.load(std::memory_order_acquire) > read; };
+
+  for (int i = 0; i < kSpinCount; ++i) {
+    if (has_data())
+      return;
+    std::this_thread::yield();
+  }
 
-  /// Send empty data to tell the end of the process
-  /// by sending default values
-  queue_.emplace_back(ByteData(), ByteData());
-  cond_.notify_one();
+  std::unique_lock<std::mutex> lock{wait_mutex_};
+  waiting_.store(true, std::memory_order_seq_cst);
+  cond_.wait(lock, [&] { return n_written_.load(std::memory_order_seq_cst) > read; });
+  waiting_.store(false, std::memory_order_relaxed);
 }
 
 } // namespace data
@@ -0,0 +1,105 @@
+#include "simplemapreduce/proc/sampler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include "simplemapreduce/commons.h"
+
+using namespace mapreduce::data;
+using namespace mapreduce::type;
+
+namespace mapreduce {
+namespace proc {
+
+void KeySampler::add(ByteView key) {
+  size_t slot = next_slot_();
+  if (slot < capacity_)
+    store_(slot, key.primary_key());
+}
+
+size_t KeySampler::next_slot_() {
+  ++count_;
+  if (samples_.size() < capacity_)
+    return samples_.size();
+
+  /// Keep the key with probability capacity / count
+  return std::uniform_int_distribution<size_t>(0, count_ - 1)(rng_);
+}
+
+void KeySampler::store_(size_t slot, ByteView key) {
+  if (slot == samples_.size())
+    samples_.emplace_back(key);
+  else
+    samples_[slot].assign(key.data(), key.size());
+}
+
+bool HotKeySketch::add(std::uint64_t hash) {
+  ++count_;
+  auto hot = hot_.find(hash);
+  if (hot != hot_.end()) {
+    ++hot->second;
+    return true;
+  }
+
+  auto found = counters_.find(hash);
+  if (found != counters_.end()) {
+    ++found->second;
+  } else if (counters_.size() < capacity_) {
+    found = counters_.emplace(hash, 1).first;
+  } else {
+    /// Decrement all counters instead of counting the new key, which costs O(1) in amortized
+    for (auto it = counters_.begin(); it != counters_.end();)
+      it = --it->second == 0 ? counters_.erase(it) : std::next(it);
+    return false;
+  }
+
+  if (count_ < min_count_ || found->second < min_share_ * count_)
+    return false;
+
+  hot_.emplace(hash, found->second);
+  counters_.erase(found);
+  return true;
+}
+
+std::vector<std::string> split_points(std::vector<std::string> samples, int n_groups) {
+  std::vector<std::string> splits;
+  if (samples.empty() || n_groups < 2)
+    return splits;
+
+  /// std::string is compared in unsigned bytes as memcmp
+  std::sort(samples.begin(), samples.end());
+  for (int i = 1; i < n_groups; ++i)
+    splits.push_back(samples[samples.size() * i / n_groups]);
+  return splits;
+}
+
+void write_keys(const std::vector<std::string>& keys, std::vector<char>& out) {
+  for (auto& key: keys) {
+    Size_t size = key.size();
+    auto size_bytes = reinterpret_cast<const char*>(&size);
+    out.insert(out.end(), size_bytes, size_bytes + sizeof(Size_t));
+    out.insert(out.end(), key.begin(), key.end());
+  }
+}
+
+std::vector<std::string> read_keys(const char* data, size_t size) {
+  std::vector<std::string> keys;
+  for (size_t pos = 0; pos < size;) {
+    Size_t key_size;
+    if (size - pos < sizeof(Size_t))
+      throw std::runtime_error("Invalid key data is received.");
+    std::memcpy(&key_size, data + pos, sizeof(Size_t));
+    pos += sizeof(Size_t);
+
+    if (size - pos < key_size)
+      throw std::runtime_error("Invalid key data is received.");
+    keys.emplace_back(data + pos, key_size);
+    pos += key_size;
+  }
+  return keys;
+}
+
+}  // namespace proc
+}  // namespace mapreduce
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "simplemapreduce/util/thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace mapreduce {
+namespace util {
+
+ThreadPool::ThreadPool(int n_threads) {
+  for (int i = 0; i < std::max(n_threads, 1); ++i)
+    threads_.emplace_back([this] { work_(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  cond_.notify_all();
+  for (auto& thread: threads_)
+    thread.join();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+  std::packaged_task<void()> packaged(std::move(task));
+  auto future = packaged.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(packaged));
+  }
+  cond_.notify_one();
+  return future;
+}
+
+void ThreadPool::work_() {
+  while (true) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return stopped_ || !tasks_.empty(); });
+      if (tasks_.empty())
+        return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+
+    /// Exceptions are stored in the future of the task
+    task();
+  }
+}
+
+}  // namespace util
+}  // namespace mapreduce
\ No newline at end of file
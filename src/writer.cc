@@ -1,8 +1,11 @@
 #include "simplemapreduce/proc/writer.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <limits>
 #include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <thread>
 #include <utility>
 
@@ -19,6 +22,41 @@ using lim_double = std::numeric_limits<Double>;
 namespace mapreduce {
 namespace proc {
 
+std::filesystem::path shuffle_file_path(const std::filesystem::path& dir, int rank) {
+  std::ostringstream oss;
+  oss << std::setw(4) << std::setfill('0') << rank << ".data";
+  return dir / oss.str();
+}
+
+void write_varint(std::ofstream& fout, std::uint64_t value) {
+  char buffer[10];
+  size_t size = 0;
+  do {
+    char byte = value & 0x7f;
+    value >>= 7;
+    buffer[size++] = value ? (byte | 0x80) : byte;
+  } while (value);
+  fout.write(buffer, size);
+}
+
+void write_varint(std::vector<char>& out, std::uint64_t value) {
+  do {
+    char byte = value & 0x7f;
+    value >>= 7;
+    out.push_back(value ? (byte | 0x80) : byte);
+  } while (value);
+}
+
+void write_binary(std::vector<char>& out, const ByteData& bdata) {
+  /// Same format as write_binary(std::ofstream&, ByteData&&)
+  if (bdata.size() > 1 || bdata.bsize() == 1) {
+    Size_t data_size = bdata.bsize();
+    auto size_bytes = reinterpret_cast<const char*>(&data_size);
+    out.insert(out.end(), size_bytes, size_bytes + sizeof(Size_t));
+  }
+  out.insert(out.end(), bdata.get_byte(), bdata.get_byte() + bdata.bsize());
+}
+
 template<>
 void write_binary(std::ofstream& fout, ByteData&& bdata) {
   /// Write size for array type (e.g. vector, string)
@@ -40,61 +78,180 @@ void write_binary(std::ofstream& fout, const String& data) {
 
 template<>
 void write_binary(std::ofstream& fout, Int16&& data) {
-  fout.write(reinterpret_cast<char*>(const_cast<Int16*>(&data)), sizeof(Int16));
+  char buffer[sizeof(Int16)];
+  encode_ordered(data, buffer);
+  fout.write(buffer, sizeof(Int16));
 }
 
 template<>
 void write_binary(std::ofstream& fout, Int&& data) {
-  fout.write(reinterpret_cast<char*>(const_cast<Int*>(&data)), sizeof(Int));
+  char buffer[sizeof(Int)];
+  encode_ordered(data, buffer);
+  fout.write(buffer, sizeof(Int));
 }
 
 template<>
 void write_binary(std::ofstream& fout, Long&& data) {
-  fout.write(reinterpret_cast<char*>(const_cast<Long*>(&data)), sizeof(Long));
+  char buffer[sizeof(Long)];
+  encode_ordered(data, buffer);
+  fout.write(buffer, sizeof(Long));
 }
 
 template<>
 void write_binary(std::ofstream& fout, Float&& data) {
-  fout.write(reinterpret_cast<char*>(const_cast<Float*>(&data)), sizeof(Float));
+  char buffer[sizeof(Float)];
+  encode_ordered(data, buffer);
+  fout.write(buffer, sizeof(Float));
 }
 
 template<>
 void write_binary(std::ofstream& fout, Double&& data) {
-  fout.write(reinterpret_cast<char*>(const_cast<Double*>(&data)), sizeof(Double));
+  char buffer[sizeof(Double)];
+  encode_ordered(data, buffer);
+  fout.write(buffer, sizeof(Double));
 }
 
 template<>
-void write_output(std::ofstream& fout, const String& data) {
+void write_output(std::ostream& fout, const String& data) {
   fout << std::left << std::setw(10) << data;
 }
 
 template<>
-void write_output(std::ofstream& fout, const Int16& data) {
+void write_output(std::ostream& fout, const Int16& data) {
   fout << std::right << std::setw(6) << data;
 }
 
 template<>
-void write_output(std::ofstream& fout, const Int& data) {
+void write_output(std::ostream& fout, const Int& data) {
   fout << std::right << std::setw(6) << data;
 }
 
 template<>
-void write_output(std::ofstream& fout, const Long& data) {
+void write_output(std::ostream& fout, const Long& data) {
   fout << std::right << std::setw(10) << data;
 }
 
 template<>
-void write_output(std::ofstream& fout, const Float& data) {
+void write_output(std::ostream& fout, const Float& data) {
   fout << std::right << std::fixed << std::setprecision(lim_float::max_digits10) << data;
 }
 
 template<>
-void write_output(std::ofstream& fout, const Double& data) {
+void write_output(std::ostream& fout, const Double& data) {
   fout << std::right << std::fixed << std::setprecision(lim_double::max_digits10) << data;
 }
 
+PartitionedFileWriter::PartitionedFileWriter(const std::filesystem::path& path, int n_partitions)
+    : path_(path), fout_(path, std::ios::binary | std::ios::trunc), index_(n_partitions) {
+  for (int i = 0; i < n_partitions; ++i)
+    buffers_.push_back(std::make_unique<PartitionBuffer>(this, i));
+}
+
+std::filesystem::path PartitionedFileWriter::index_path(const std::filesystem::path& path) {
+  return std::filesystem::path(path).replace_extension(".index");
+}
+
+void PartitionedFileWriter::append_(int id, const char* data, size_t size) {
+  if (!fout_.is_open() || size == 0)
+    return;
+
+  fout_.write(data, size);
+  auto& segments = index_[id];
+  if (!segments.empty() && segments.back().offset + segments.back().size == size_)
+    segments.back().size += size;
+  else
+    segments.push_back(FileSegment{size_, size});
+  size_ += size;
+}
+
+void PartitionedFileWriter::close() {
+  if (!fout_.is_open())
+    return;
+  fout_.close();
+
+  std::vector<char> buffer(kPartitionIndexMagic, kPartitionIndexMagic + kPartitionIndexMagicSize);
+  write_varint(buffer, index_.size());
+  for (auto& segments: index_) {
+    write_varint(buffer, segments.size());
+    for (auto& segment: segments) {
+      write_varint(buffer, segment.offset);
+      write_varint(buffer, segment.size);
+    }
+  }
+
+  std::ofstream index(index_path(path_), std::ios::binary | std::ios::trunc);
+  index.write(buffer.data(), buffer.size());
+}
+
+std::streamsize PartitionedFileWriter::PartitionBuffer::xsputn(const char* data, std::streamsize size) {
+  file_->append_(id_, data, size);
+  return size;
+}
+
+PartitionedFileWriter::PartitionBuffer::int_type PartitionedFileWriter::PartitionBuffer::overflow(int_type ch) {
+  if (traits_type::eq_int_type(ch, traits_type::eof()))
+    return traits_type::not_eof(ch);
+
+  char byte = traits_type::to_char_type(ch);
+  file_->append_(id_, &byte, 1);
+  return ch;
+}
+
+RunWriter::RunWriter(const std::filesystem::path& path) : path_(path) {
+  fout_.open(path_, std::ios::binary | std::ios::trunc);
+  if (!fout_)
+    throw std::runtime_error("Failed to open a run file: " + path_.string());
+  buffer_.reserve(kBufferBytes);
+}
+
+void RunWriter::write(std::string_view key, std::string_view value) {
+  /// Same record format as runs of BinaryFileWriter with front coding
+  size_t shared = std::mismatch(prev_.begin(), prev_.end(), key.begin(), key.end()).first - prev_.begin();
+  auto size = buffer_.size();
+  write_varint(buffer_, shared);
+  write_varint(buffer_, key.size() - shared);
+  buffer_.insert(buffer_.end(), key.data() + shared, key.data() + key.size());
+  write_varint(buffer_, value.size());
+  buffer_.insert(buffer_.end(), value.begin(), value.end());
+
+  prev_.assign(key);
+  n_bytes_ += buffer_.size() - size;
+  ++n_records_;
+  if (buffer_.size() >= kBufferBytes) {
+    fout_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+  }
+}
+
+void RunWriter::close() {
+  if (!fout_.is_open())
+    return;
+
+  fout_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+  fout_.close();
+  if (!fout_)
+    throw std::runtime_error("Failed to write a run file: " + path_.string());
+}
+
 void MQWriter::write(ByteData&& key, ByteData&& value) {
-  mq_->send(std::make_pair(std::move(key), std::move(value)));
+  if (sampler_ != nullptr)
+    sampler_->add(key.view());
+
+  /// Typed records are encoded by appending bytes
+  typed_records_ = nullptr;
+  batch_.append(key, value);
+  if (batch_.bytes() >= batch_bytes_)
+    flush();
+}
+
+void MQWriter::flush() {
+  if (batch_.empty())
+    return;
+
+  mq_->send_batch(std::move(batch_));
+  batch_.clear();
+  typed_records_ = nullptr;
 }
 
 }  // namespace proc
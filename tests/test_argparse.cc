@@ -43,4 +43,15 @@ TEST_CASE("ArgParser", "[argparse][options][config]") {
 
     REQUIRE(parser.get_option("output") == "./outputs");
   }
+
+  SECTION("Grouping") {
+    int argc = 3;
+    char name[]{"test_argparse"};
+    char opt[]{"-g"};
+    char value[]{"hash"};
+    char* argv[]{&name[0], &opt[0], &value[0]};
+    ArgParser parser{argc, argv};
+
+    REQUIRE(parser.get_option("grouping") == "hash");
+  }
 }
\ No newline at end of file
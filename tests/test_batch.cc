@@ -0,0 +1,212 @@
+#include "simplemapreduce/data/batch.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/type.h"
+#include "utils.h"
+
+using namespace mapreduce::data;
+using namespace mapreduce::type;
+
+template <typename K, typename V>
+void test_batch(std::vector<K> keys, std::vector<V> values) {
+  RecordBatch batch;
+  for (size_t i = 0; i < keys.size(); ++i)
+    batch.append(ByteData{K(keys[i])}, ByteData{V(values[i])});
+
+  REQUIRE(batch.size() == keys.size());
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    REQUIRE(batch.get_key<K>(i) == keys[i]);
+    REQUIRE(batch.get_value<V>(i) == values[i]);
+
+    /// Converted data keeps the original format
+    auto item = batch.get_item(i);
+    REQUIRE(item.first == ByteData{K(keys[i])});
+    REQUIRE(item.first.size() == ByteData{K(keys[i])}.size());
+    REQUIRE(item.second.get_data<V>() == values[i]);
+    REQUIRE(item.second.size() == 1);
+  }
+}
+
+TEST_CASE("RecordBatch", "[batch][data]") {
+
+  SECTION("String/Int") {
+    test_batch<String, Int>({"test", "example", "batch"}, {1, -20, 300});
+  }
+
+  SECTION("Long/Double") {
+    test_batch<Long, Double>({123456789l, -1l, 0l}, {0.123456789, -1234.5, 10.0});
+  }
+
+  SECTION("CompositeKey") {
+    using KeyType = CompositeKey<String, Int>;
+
+    RecordBatch batch;
+    batch.append(ByteData{KeyType{"key", 10}}, ByteData{Long{5}});
+
+    auto [first, second] = batch.get_key<KeyType>(0);
+    REQUIRE(first == "key");
+    REQUIRE(second == 10);
+    REQUIRE(batch.get_value<Long>(0) == 5);
+
+    /// Only the key flagged as CompositeKey is split, even for the same bytes
+    batch.append(ByteData{CompositeKey<String, String>{"a", "b"}}, ByteData{Long{1}});
+    batch.append(ByteData{String("a\1b\0\0\0\1", 7)}, ByteData{Long{2}});
+    RecordBatch copied;
+    copied.append(batch, 1);
+    copied.append(batch, 2);
+    REQUIRE(copied.key(0) == copied.key(1));
+    REQUIRE(copied.key(0).primary_key() == ByteView("a", 1));
+    REQUIRE(copied.key(1).primary_key().size() == 7);
+    REQUIRE(copied.get_item(0).first.is_composite());
+    REQUIRE_FALSE(copied.get_item(1).first.is_composite());
+  }
+
+  SECTION("Copy records from another batch") {
+    RecordBatch batch1, batch2;
+    batch1.append(ByteData{String{"first"}}, ByteData{Int{1}});
+    batch1.append(ByteData{String{"second"}}, ByteData{Int{2}});
+
+    batch2.append(batch1, 1);
+    REQUIRE(batch2.size() == 1);
+    REQUIRE(batch2.get_key<String>(0) == "second");
+    REQUIRE(batch2.get_value<Int>(0) == 2);
+  }
+
+  SECTION("Clear") {
+    RecordBatch batch;
+    batch.append(ByteData{String{"test"}}, ByteData{Int{1}});
+    REQUIRE(batch.bytes() == 8);
+
+    batch.clear();
+    REQUIRE(batch.empty());
+    REQUIRE(batch.bytes() == 0);
+  }
+
+  SECTION("Write and read file") {
+    auto fpath = tmpdir / "test_batch" / "batch";
+    std::filesystem::create_directories(fpath.parent_path());
+
+    RecordBatch batch1, batch2;
+    batch1.append(ByteData{String{"first"}}, ByteData{Int{1}});
+    batch1.append(ByteData{String{"second"}}, ByteData{Int{2}});
+    batch2.append(ByteData{String{"third"}}, ByteData{Int{3}});
+
+    {
+      std::ofstream ofs(fpath, std::ios::binary);
+      batch1.write(ofs);
+      batch2.write(ofs);
+    }
+
+    std::ifstream ifs(fpath, std::ios::binary);
+    RecordBatch batch;
+    REQUIRE(batch.read(ifs));
+    REQUIRE(batch.size() == 2);
+    REQUIRE(batch.get_key<String>(1) == "second");
+    REQUIRE(batch.get_item(1).first.size() == 6);
+
+    REQUIRE(batch.read(ifs));
+    REQUIRE(batch.size() == 1);
+    REQUIRE(batch.get_value<Int>(0) == 3);
+
+    REQUIRE_FALSE(batch.read(ifs));
+
+    std::filesystem::remove_all(fpath.parent_path());
+  }
+
+  SECTION("Write and read byte array") {
+    RecordBatch batch1;
+    batch1.append(ByteData{String{"first"}}, ByteData{Int{1}});
+    batch1.append(ByteData{String{"second"}}, ByteData{Int{2}});
+
+    std::vector<char> data;
+    batch1.write(data);
+
+    RecordBatch batch;
+    REQUIRE(batch.read(data.data(), data.size()));
+    REQUIRE(batch.size() == 2);
+    REQUIRE(batch.get_key<String>(1) == "second");
+    REQUIRE(batch.get_value<Int>(0) == 1);
+    REQUIRE(batch.hash(1) == batch1.hash(1));
+
+    /// Truncated data is rejected
+    REQUIRE_FALSE(batch.read(data.data(), data.size() - 1));
+  }
+
+  SECTION("Typed records") {
+    RecordBatch batch;
+    batch.emplace_back(String{"first"}, Int{1});
+    batch.emplace_back(String{"second"}, Int{2});
+
+    REQUIRE(batch.is_typed());
+    REQUIRE(batch.size() == 2);
+    REQUIRE(batch.typed<String, Long>() == nullptr);
+
+    auto records = batch.typed<String, Int>();
+    REQUIRE(records != nullptr);
+    REQUIRE((*records)[1].first == "second");
+    REQUIRE((*records)[1].second == 2);
+
+    /// Encoded data is the same as records appended in bytes
+    batch.encode();
+    REQUIRE_FALSE(batch.is_typed());
+    REQUIRE(batch.typed<String, Int>() == nullptr);
+    REQUIRE(batch.size() == 2);
+    REQUIRE(batch.get_item(1).first == ByteData{String{"second"}});
+    REQUIRE(batch.get_value<Int>(0) == 1);
+  }
+
+  SECTION("Typed storage") {
+    RecordBatch batch;
+    auto records = batch.typed_records<String, Int>();
+    REQUIRE(records != nullptr);
+    REQUIRE(batch.typed_records<String, Long>() == nullptr);
+
+    records->emplace_back(String{"first"}, Int{1}, hash_key(String{"first"}));
+    batch.emplace_back(String{"second"}, Int{2});
+    REQUIRE(batch.typed_records<String, Int>() == records);
+    REQUIRE(batch.size() == 2);
+    REQUIRE(batch.hash(0) == hash_key(String{"first"}));
+
+    /// No typed storage for a batch with records in bytes
+    batch.encode();
+    REQUIRE(batch.typed_records<String, Int>() == nullptr);
+    REQUIRE(batch.get_key<String>(1) == "second");
+  }
+
+  SECTION("Mix typed and encoded records") {
+    RecordBatch batch;
+    batch.emplace_back(String{"first"}, Int{1});
+    batch.append(ByteData{String{"second"}}, ByteData{Int{2}});
+    batch.emplace_back(String{"third"}, Int{3});
+
+    REQUIRE_FALSE(batch.is_typed());
+    REQUIRE(batch.size() == 3);
+    REQUIRE(batch.get_key<String>(0) == "first");
+    REQUIRE(batch.get_key<String>(2) == "third");
+  }
+
+  SECTION("Key hash kept with records") {
+    RecordBatch batch;
+    batch.emplace_back(String{"first"}, Int{1});
+    batch.emplace_back(String{"second"}, Int{2});
+    REQUIRE(batch.hash(0) == hash_key(String{"first"}));
+
+    /// Hashes are not changed by encoding and copying
+    batch.encode();
+    REQUIRE(batch.hash(1) == hash_key(String{"second"}));
+
+    RecordBatch copied;
+    copied.append(batch, 1);
+    copied.append(ByteData{String{"third"}}, ByteData{Int{3}});
+    REQUIRE(copied.hash(0) == hash_key(String{"second"}));
+    REQUIRE(copied.hash(1) == hash_key(String{"third"}));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "simplemapreduce/data/buffer.h"
+
+#include <string>
+#include <utility>
+
+#include "catch.hpp"
+
+using namespace mapreduce::data;
+
+TEST_CASE("ByteBuffer", "[buffer][data]") {
+
+  SECTION("Inline storage") {
+    long value = 1234567890;
+    ByteBuffer buffer(reinterpret_cast<char*>(&value), sizeof(long));
+
+    REQUIRE(buffer.size() == sizeof(long));
+    REQUIRE(buffer.is_inline());
+    REQUIRE(*reinterpret_cast<const long*>(buffer.data()) == value);
+  }
+
+  SECTION("Heap storage") {
+    std::string text(ByteBuffer::kInlineCapacity * 3, 'x');
+    ByteBuffer buffer(text.data(), text.size());
+
+    REQUIRE(buffer.size() == text.size());
+    REQUIRE_FALSE(buffer.is_inline());
+    REQUIRE(std::string(buffer.begin(), buffer.end()) == text);
+  }
+
+  SECTION("Append beyond inline capacity") {
+    ByteBuffer buffer;
+    std::string target;
+    for (int i = 0; i < 100; ++i) {
+      char c = 'a' + (i % 26);
+      buffer.push_back(c);
+      target.push_back(c);
+    }
+
+    REQUIRE_FALSE(buffer.is_inline());
+    REQUIRE(std::string(buffer.begin(), buffer.end()) == target);
+  }
+
+  SECTION("Copy and move") {
+    std::string short_text{"word"};
+    std::string long_text(ByteBuffer::kInlineCapacity + 1, 'y');
+
+    for (auto& text: {short_text, long_text}) {
+      ByteBuffer buffer1(text.data(), text.size());
+      ByteBuffer buffer2(buffer1);
+      REQUIRE(buffer1 == buffer2);
+
+      ByteBuffer buffer3(std::move(buffer1));
+      REQUIRE(buffer3 == buffer2);
+      REQUIRE(buffer1.empty());
+
+      buffer1 = buffer3;
+      REQUIRE(buffer1 == buffer3);
+
+      buffer2 = std::move(buffer3);
+      REQUIRE(std::string(buffer2.begin(), buffer2.end()) == text);
+    }
+  }
+
+  SECTION("Compare") {
+    std::string text1{"example"}, text2{"test"};
+    ByteBuffer buffer1(text1.data(), text1.size());
+    ByteBuffer buffer2(text2.data(), text2.size());
+
+    REQUIRE(buffer1 < buffer2);
+    REQUIRE(buffer2 > buffer1);
+    REQUIRE(buffer1 != buffer2);
+  }
+}
\ No newline at end of file
@@ -1,7 +1,11 @@
 #include "simplemapreduce/data/bytes.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -240,8 +244,9 @@ TEST_CASE("ByteData", "[byte][data]") {
 
     /// Create byte array to store
     std::vector<Double> target{1.23456, 2.34567, -3.45678, 4.56789};
-    char *buff = reinterpret_cast<char *>(target.data());
-    std::vector<char> buffer(buff, buff + target.size() * sizeof(Double));
+    std::vector<char> buffer(target.size() * sizeof(Double));
+    for (size_t i = 0; i < target.size(); ++i)
+      encode_ordered(target[i], buffer.data() + sizeof(Double) * i);
 
     /// Store original bytes
     bdata1.set_bytes<Double>(buffer.data(), buffer.size());
@@ -252,8 +257,124 @@ TEST_CASE("ByteData", "[byte][data]") {
   }
 }
 
+/** Check ByteData is sorted in the same order as the original values. */
+template <typename T>
+bool check_byte_order(std::vector<T> values) {
+  std::vector<ByteData> bdata;
+  for (auto& value: values)
+    bdata.emplace_back(T(value));
+
+  std::sort(values.begin(), values.end());
+  std::sort(bdata.begin(), bdata.end());
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (bdata[i].template get_data<T>() != values[i])
+      return false;
+  }
+  return true;
+}
+
+TEST_CASE("ByteData order", "[byte][data][order]") {
+
+  SECTION("Integers") {
+    REQUIRE(check_byte_order<Int16>({10, -20, 0, 256, -1, 32767, -32768, 1}));
+    REQUIRE(check_byte_order<Int>({100, -401, 0, 65536, -1, 1, 2147483647, -2147483647 - 1}));
+    REQUIRE(check_byte_order<Long>({123456789l, -123456789l, 0, 1l << 40, -(1l << 40), -1, 255, 256}));
+  }
+
+  SECTION("Floating points") {
+    REQUIRE(check_byte_order<Float>({0.1f, -74.904f, 10.987f, 0.0f, -0.5f, 1e30f, -1e30f, 1e-30f}));
+    REQUIRE(check_byte_order<Double>({0.5, -502.012345657, 1.23456789, -1e-300, 1e300, 0.0, -1.0}));
+  }
+
+  SECTION("Equal floating points") {
+    /// Equal keys are encoded in the same bytes
+    REQUIRE(ByteData{Double{-0.0}} == ByteData{Double{0.0}});
+    REQUIRE(ByteData{Float{-0.0f}} == ByteData{Float{0.0f}});
+    REQUIRE(std::signbit(ByteData{Double{-0.0}}.get_data<Double>()) == false);
+
+    Double nan = std::numeric_limits<Double>::quiet_NaN();
+    REQUIRE(ByteData{Double{-nan}} == ByteData{Double{nan}});
+    REQUIRE(ByteData{Double{std::numeric_limits<Double>::infinity()}} < ByteData{Double{-nan}});
+    REQUIRE(std::isnan(ByteData{Double{-nan}}.get_data<Double>()));
+  }
+
+  SECTION("Round trip") {
+    for (Double value: {0.0, 1.5, -1.5, 1e-310, -1e-310}) {
+      char buffer[sizeof(Double)];
+      encode_ordered(value, buffer);
+      Double res = decode_ordered<Double>(buffer);
+      REQUIRE(std::memcmp(&value, &res, sizeof(Double)) == 0);
+    }
+  }
+
+  SECTION("Strings with non ASCII bytes") {
+    REQUIRE(check_byte_order<String>({"abc", "ab", "\xe3\x81\x82", "z", "", "b"}));
+  }
+
+  SECTION("CompositeKey") {
+    using KeyType = CompositeKey<Int, Float>;
+    REQUIRE(check_byte_order<KeyType>({{1, 0.5f}, {-1, 2.0f}, {1, -0.5f}, {256, 0.0f}, {-256, -1.0f}}));
+
+    using StrKeyType = CompositeKey<String, Long>;
+    REQUIRE(check_byte_order<StrKeyType>({{"b", 1}, {"a", -1}, {"a", 1}, {"ab", -5}}));
+  }
+}
+
 TEST_CASE("ByteData CompositeKey", "[byte][data][pair]") {
 
+  SECTION("Numeric first data containing separator byte") {
+    using KeyType = CompositeKey<Int, String>;
+
+    /// Encoded bytes of these values contain SOH
+    for (Int first: {1, 256, 257, -255}) {
+      ByteData bdata(KeyType(first, "value"));
+      auto [res_first, res_second] = bdata.get_data<KeyType>();
+      REQUIRE(res_first == first);
+      REQUIRE(res_second == "value");
+      REQUIRE(bdata.get_key_view().size() == sizeof(Int));
+      REQUIRE(bdata.get_key_view() == ByteData(Int(first)).view());
+    }
+  }
+
+  SECTION("Order of second data in different length") {
+    using KeyType = CompositeKey<String, String>;
+    ByteData bdata1(KeyType("key", "a")), bdata2(KeyType("key", "ab")), bdata3(KeyType("keys", ""));
+
+    REQUIRE(bdata1 < bdata2);
+    REQUIRE(bdata2 < bdata3);
+    REQUIRE(bdata1.get_key_view() == bdata2.get_key_view());
+  }
+
+  SECTION("Keys ending like a pair") {
+    /// Bytes of these keys end with a trailer pointing at SOH, but they are not split without the flag
+    ByteData ldata{Long(281474976710657)};
+    REQUIRE_FALSE(ldata.is_composite());
+    REQUIRE(ldata.get_key_view() == ldata.view());
+    REQUIRE(ldata.get_key_view().size() == sizeof(Long));
+
+    ByteData sdata{String("a\1b\0\0\0\1", 7)};
+    REQUIRE_FALSE(sdata.is_composite());
+    REQUIRE(sdata.get_key() == String("a\1b\0\0\0\1", 7));
+
+    /// CompositeKey of the same bytes is split by the flag
+    ByteData cdata{CompositeKey<String, String>("a", "b")};
+    REQUIRE(cdata.is_composite());
+    REQUIRE(cdata.view() == sdata.view());
+    REQUIRE(cdata.get_key() == "a");
+
+    ByteData copied;
+    copied.set_bytes(cdata.get_byte(), cdata.bsize(), cdata.size(), cdata.is_composite());
+    REQUIRE(copied.get_key() == "a");
+    copied = sdata;
+    REQUIRE(copied.get_key().size() == 7);
+  }
+
+  SECTION("Not a pair") {
+    ByteData bdata{String{"not a pair"}};
+    REQUIRE(composite_first_size(bdata.get_byte(), bdata.bsize()) == bdata.bsize());
+    REQUIRE_THROWS(bdata.get_data<CompositeKey<String, String>>());
+  }
+
   SECTION("Int/Int pair") {
     using KeyType = CompositeKey<Int, Int>;
 
@@ -417,4 +538,54 @@ TEST_CASE("ByteData Modification", "[byte][data]") {
     std::vector<Float> res = bdata.get_data<std::vector<Float>>();
     REQUIRE_THAT(res, Catch::Matchers::UnorderedEquals(target));
   }
+}
+
+TEST_CASE("ByteView", "[byte][data][view]") {
+
+  SECTION("String") {
+    ByteData bdata{String{"test"}};
+    std::string_view view = bdata.get_view<String>();
+
+    REQUIRE(view == "test");
+    /// View refers to the bytes in ByteData
+    REQUIRE(view.data() == bdata.get_byte());
+  }
+
+  SECTION("Numeric") {
+    REQUIRE(ByteData{Long{1234567890}}.get_view<Long>() == 1234567890);
+    REQUIRE(ByteData{Double{-0.125}}.get_view<Double>() == -0.125);
+  }
+
+  SECTION("CompositeKey") {
+    ByteData bdata{CompositeKey<String, Int>{"key", 10}};
+    auto [first, second] = bdata.get_view<CompositeKey<String, Int>>();
+
+    REQUIRE(first == "key");
+    REQUIRE(second == 10);
+    REQUIRE(bdata.get_key_view().get_view<String>() == "key");
+  }
+
+  SECTION("Primary key") {
+    ByteData bdata1{String{"test"}};
+    ByteData bdata2{CompositeKey<String, Int>{"test", 1}};
+
+    REQUIRE(bdata1.get_key_view() == bdata2.get_key_view());
+    REQUIRE(std::string_view(bdata1.get_key_view()) == bdata1.get_key());
+    REQUIRE(bdata1.view() != bdata2.view());
+  }
+
+  SECTION("Compare in the same order as ByteData") {
+    std::vector<ByteData> data;
+    data.emplace_back(String{"abc"});
+    data.emplace_back(String{"abd"});
+    data.emplace_back(Int{-1});
+    data.emplace_back(Int{1});
+
+    for (auto& lhs: data) {
+      for (auto& rhs: data) {
+        REQUIRE((lhs < rhs) == (lhs.view() < rhs.view()));
+        REQUIRE((lhs == rhs) == (lhs.view() == rhs.view()));
+      }
+    }
+  }
 }
\ No newline at end of file
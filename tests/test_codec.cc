@@ -0,0 +1,210 @@
+#include "simplemapreduce/data/codec.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+using namespace mapreduce;
+using namespace mapreduce::data;
+
+/**
+ * Compress and decompress bytes with a codec.
+ *
+ *  @param codec  codec to test
+ *  @param input  original bytes
+ */
+std::vector<char> round_trip(const Codec& codec, const std::vector<char>& input) {
+  std::vector<char> stored;
+  codec.compress(input.data(), input.size(), stored);
+
+  std::vector<char> output(input.size());
+  REQUIRE(codec.decompress(stored.data(), stored.size(), output.data(), output.size()));
+  return output;
+}
+
+std::vector<char> random_bytes(size_t size) {
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::vector<char> bytes(size);
+  for (auto& c: bytes)
+    c = static_cast<char>(dist(engine));
+  return bytes;
+}
+
+std::vector<char> repetitive_bytes(size_t size) {
+  std::vector<char> bytes;
+  for (size_t i = 0; bytes.size() < size; ++i) {
+    std::string word = "word" + std::to_string(i % 100) + " ";
+    bytes.insert(bytes.end(), word.begin(), word.end());
+  }
+  bytes.resize(size);
+  return bytes;
+}
+
+TEST_CASE("LZCodec", "[codec]") {
+  LZCodec codec;
+
+  SECTION("Empty") {
+    REQUIRE(round_trip(codec, {}).empty());
+  }
+
+  SECTION("Short") {
+    std::vector<char> input{'a', 'b', 'c'};
+    REQUIRE(round_trip(codec, input) == input);
+  }
+
+  SECTION("Random bytes") {
+    auto input = random_bytes(100000);
+    REQUIRE(round_trip(codec, input) == input);
+  }
+
+  SECTION("Repetitive bytes") {
+    auto input = repetitive_bytes(100000);
+    REQUIRE(round_trip(codec, input) == input);
+
+    std::vector<char> stored;
+    codec.compress(input.data(), input.size(), stored);
+    REQUIRE(stored.size() * 4 < input.size());
+  }
+
+  SECTION("Corrupted bytes") {
+    auto input = repetitive_bytes(10000);
+    std::vector<char> stored;
+    codec.compress(input.data(), input.size(), stored);
+
+    std::vector<char> output(input.size());
+    REQUIRE_FALSE(codec.decompress(stored.data(), stored.size() / 2, output.data(), output.size()));
+    REQUIRE_FALSE(codec.decompress(stored.data(), stored.size(), output.data(), output.size() - 1));
+  }
+}
+
+#ifdef HAS_ZLIB
+TEST_CASE("ZlibCodec", "[codec]") {
+  ZlibCodec codec;
+
+  SECTION("Random bytes") {
+    auto input = random_bytes(100000);
+    REQUIRE(round_trip(codec, input) == input);
+  }
+
+  SECTION("Repetitive bytes") {
+    auto input = repetitive_bytes(100000);
+    REQUIRE(round_trip(codec, input) == input);
+  }
+}
+#endif
+
+TEST_CASE("get_codec", "[codec]") {
+  REQUIRE(get_codec(Compression::none) == nullptr);
+  REQUIRE(get_codec(Compression::lz)->type() == Compression::lz);
+#ifdef HAS_ZLIB
+  REQUIRE(get_codec(Compression::zlib)->type() == Compression::zlib);
+#else
+  REQUIRE_THROWS_AS(get_codec(Compression::zlib), std::invalid_argument);
+#endif
+}
+
+TEST_CASE("write_block", "[codec]") {
+  LZCodec codec;
+  std::vector<char> output;
+
+  SECTION("Compressed") {
+    auto input = repetitive_bytes(10000);
+    std::vector<char> block;
+    write_block(codec, input.data(), input.size(), block);
+    REQUIRE(block.size() < input.size());
+    REQUIRE(read_block(codec, block.data(), block.size(), output));
+    REQUIRE(output == input);
+  }
+
+  SECTION("Stored as it is") {
+    auto input = random_bytes(10000);
+    std::vector<char> block;
+    write_block(codec, input.data(), input.size(), block);
+    REQUIRE(block.size() == input.size() + 2 * sizeof(std::uint32_t));
+    REQUIRE(read_block(codec, block.data(), block.size(), output));
+    REQUIRE(output == input);
+  }
+
+  SECTION("Truncated") {
+    auto input = repetitive_bytes(10000);
+    std::vector<char> block;
+    write_block(codec, input.data(), input.size(), block);
+    REQUIRE_FALSE(read_block(codec, block.data(), block.size() - 1, output));
+    REQUIRE_FALSE(read_block(codec, block.data(), 3, output));
+  }
+}
+
+TEST_CASE("CompressBuffer and InputFile", "[codec][file]") {
+  fs::path fpath{tmpdir / "test_codec" / "tmp_bin"};
+  fs::create_directories(fpath.parent_path());
+
+  /// Several blocks of CompressBuffer::kBlockBytes
+  auto input = repetitive_bytes(CompressBuffer::kBlockBytes * 3 + 100);
+
+  SECTION("Read compressed file") {
+    {
+      std::ofstream ofs(fpath, std::ios::binary);
+      CompressBuffer buffer(ofs.rdbuf(), get_codec(Compression::lz));
+      std::ostream out(&buffer);
+      out.write(input.data(), input.size());
+      out.flush();
+      REQUIRE(buffer.stats().raw_bytes == input.size());
+      REQUIRE(buffer.stats().ratio() > 1.0);
+    }
+    REQUIRE(fs::file_size(fpath) < input.size());
+
+    InputFile fin(fpath);
+    REQUIRE(fin.is_compressed());
+    std::vector<char> output(input.size());
+    fin.read(output.data(), output.size());
+    REQUIRE(fin.gcount() == static_cast<std::streamsize>(input.size()));
+    REQUIRE(output == input);
+    REQUIRE(fin.get() == std::char_traits<char>::eof());
+
+    /// Seek across blocks with shared streams
+    auto shared = fin.share();
+    size_t pos = CompressBuffer::kBlockBytes * 2 - 10;
+    shared->seekg(pos);
+    std::vector<char> part(20);
+    shared->read(part.data(), part.size());
+    REQUIRE(std::equal(part.begin(), part.end(), input.begin() + pos));
+    REQUIRE(static_cast<size_t>(shared->tellg()) == pos + part.size());
+  }
+
+  SECTION("Read plain file") {
+    {
+      std::ofstream ofs(fpath, std::ios::binary);
+      ofs.write(input.data(), input.size());
+    }
+
+    InputFile fin(fpath);
+    REQUIRE_FALSE(fin.is_compressed());
+    std::vector<char> output(input.size());
+    fin.read(output.data(), output.size());
+    REQUIRE(output == input);
+  }
+
+  SECTION("Empty compressed file") {
+    {
+      std::ofstream ofs(fpath, std::ios::binary);
+      CompressBuffer buffer(ofs.rdbuf(), get_codec(Compression::lz));
+    }
+
+    InputFile fin(fpath);
+    REQUIRE(fin.is_compressed());
+    REQUIRE(fin.get() == std::char_traits<char>::eof());
+  }
+
+  fs::remove_all(tmpdir);
+}
\ No newline at end of file
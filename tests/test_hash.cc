@@ -0,0 +1,92 @@
+#include "simplemapreduce/data/hash.h"
+
+#include <set>
+#include <string>
+#include <utility>
+
+#include "catch.hpp"
+
+#include "simplemapreduce/data/type.h"
+
+using namespace mapreduce::data;
+using namespace mapreduce::type;
+
+/** Check a key hash in the original type matches the hash of the encoded key. */
+template <typename K>
+bool check_same_hash(K key) {
+  auto hash = hash_key(key);
+  ByteData bdata{K(key)};
+  return hash == hash_key(bdata.view());
+}
+
+TEST_CASE("hash_bytes", "[hash]") {
+
+  SECTION("Deterministic") {
+    std::string text{"mapreduce"};
+    REQUIRE(hash_bytes(text.data(), text.size()) == hash_bytes(text.data(), text.size()));
+    REQUIRE(hash_bytes(text.data(), text.size(), 1) != hash_bytes(text.data(), text.size(), 2));
+  }
+
+  SECTION("Stable across platforms") {
+    /// Partitions must match on all ranks, so the values are fixed
+    REQUIRE(hash_bytes("", 0) == 0x545f23ddcfe838c4ull);
+    REQUIRE(hash_bytes("a", 1) == 0x6a40478b6d07690bull);
+    REQUIRE(hash_bytes("mapreduce", 9) == 0xc1b4ab0a29d03df5ull);
+  }
+
+  SECTION("All input lengths") {
+    /// Cover each branch of short, middle and long inputs
+    std::string text(200, 'x');
+    std::set<std::uint64_t> hashes;
+    for (size_t size = 0; size <= text.size(); ++size)
+      hashes.insert(hash_bytes(text.data(), size));
+    REQUIRE(hashes.size() == text.size() + 1);
+
+    std::string other(text);
+    for (size_t i = 0; i < text.size(); ++i) {
+      other[i] = 'y';
+      REQUIRE(hash_bytes(text.data(), text.size()) != hash_bytes(other.data(), other.size()));
+      other[i] = 'x';
+    }
+  }
+}
+
+TEST_CASE("hash_key", "[hash]") {
+
+  SECTION("Same hash in original type and bytes") {
+    REQUIRE(check_same_hash<String>("key"));
+    REQUIRE(check_same_hash<Int16>(-12));
+    REQUIRE(check_same_hash<Int>(256));
+    REQUIRE(check_same_hash<Long>(-123456789l));
+    REQUIRE(check_same_hash<Float>(0.5f));
+    REQUIRE(check_same_hash<Double>(-1.25));
+    REQUIRE(check_same_hash<CompositeKey<String, Int>>({"key", 1}));
+    REQUIRE(check_same_hash<CompositeKey<Int, String>>({456, "value"}));
+    REQUIRE(check_same_hash<CompositeKey<Long, Double>>({-1, 0.5}));
+  }
+
+  SECTION("Keys ending like a pair") {
+    /// Whole bytes are hashed for keys other than CompositeKey
+    Long lkey = 281474976710657;
+    REQUIRE(check_same_hash<Long>(lkey));
+    ByteData ldata{Long(lkey)};
+    REQUIRE(hash_key(lkey) == hash_bytes(ldata.get_byte(), ldata.bsize()));
+
+    String skey("a\1b\0\0\0\1", 7);
+    REQUIRE(check_same_hash<String>(skey));
+    REQUIRE(hash_key(skey) == hash_bytes(skey.data(), skey.size()));
+    REQUIRE(hash_key(skey) != hash_key(CompositeKey<String, String>{"a", "b"}));
+  }
+
+  SECTION("Primary key") {
+    REQUIRE(hash_key(String{"key"}) == hash_key(CompositeKey<String, Int>{"key", 1}));
+    REQUIRE(hash_key(CompositeKey<String, Int>{"key", 1}) == hash_key(CompositeKey<String, Int>{"key", 2}));
+  }
+
+  SECTION("Hashed view") {
+    String key{"key"};
+    HashedView view{key, hash_key(key)};
+    REQUIRE(view == HashedView{"key", 0});
+    REQUIRE(HashedView::Hash{}(view) == hash_key(key));
+  }
+}
\ No newline at end of file
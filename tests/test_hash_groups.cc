@@ -0,0 +1,103 @@
+#include "simplemapreduce/data/hash_groups.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "simplemapreduce/data/hash.h"
+#include "simplemapreduce/data/type.h"
+
+using namespace mapreduce::data;
+using namespace mapreduce::type;
+
+TEST_CASE("HashGroups", "[hash][groups][data]") {
+
+  SECTION("String/Int with views of keys") {
+    HashGroups<String, Int> groups;
+    std::vector<String> keys{"test", "example", "groups", "test", "groups", "test"};
+    for (size_t i = 0; i < keys.size(); ++i) {
+      std::string_view view(keys[i]);
+      bool is_new = groups.add(view, hash_key(keys[i]), Int(i));
+      REQUIRE(is_new == (i < 3));
+    }
+
+    REQUIRE(groups.size() == 3);
+    REQUIRE(groups.n_values() == keys.size());
+
+    /// Groups are in the order of first appearance, and values in the order added
+    std::vector<std::vector<Int>> targets{{0, 3, 5}, {1}, {2, 4}};
+    for (size_t group = 0; group < groups.size(); ++group) {
+      REQUIRE(groups.key(group) == keys[group]);
+      std::vector<Int> values;
+      groups.take(group, values);
+      REQUIRE(values == targets[group]);
+    }
+  }
+
+  SECTION("Long/Double over growing table") {
+    HashGroups<Long, Double> groups;
+    const Long n_keys = 10000;
+    for (int round = 0; round < 3; ++round) {
+      for (Long key = -n_keys / 2; key < n_keys / 2; ++key)
+        groups.add(Long(key * 7), hash_key(key * 7), Double(round));
+    }
+
+    REQUIRE(groups.size() == static_cast<size_t>(n_keys));
+    for (size_t group = 0; group < groups.size(); ++group) {
+      REQUIRE(groups.key(group) == (static_cast<Long>(group) - n_keys / 2) * 7);
+      std::vector<Double> values;
+      groups.take(group, values);
+      REQUIRE(values == std::vector<Double>{0, 1, 2});
+    }
+  }
+
+  SECTION("Keys of the same hash") {
+    HashGroups<String, Int> groups;
+    groups.add(String("a"), 1, 1);
+    groups.add(String("b"), 1, 2);
+    groups.add(String("a"), 1, 3);
+
+    REQUIRE(groups.size() == 2);
+    std::vector<Int> values;
+    groups.take(0, values);
+    REQUIRE(values == std::vector<Int>{1, 3});
+  }
+
+  SECTION("Clear") {
+    HashGroups<Int, Int> groups;
+    for (Int i = 0; i < 100; ++i)
+      groups.add(Int(i % 10), hash_key(i % 10), Int(i));
+    groups.clear();
+    REQUIRE(groups.empty());
+    REQUIRE(groups.n_values() == 0);
+
+    groups.add(Int(5), hash_key(5), 1);
+    REQUIRE(groups.size() == 1);
+    REQUIRE(groups.key(0) == 5);
+  }
+
+  SECTION("Next values of a group") {
+    HashGroups<Int, Long> groups;
+    for (Long i = 0; i < 6; ++i)
+      groups.add(Int(i % 2), hash_key(Int(i % 2)), Long(i));
+
+    /// Values are moved one by one in the order added, and added again after all are taken
+    Long value;
+    std::vector<Long> values;
+    while (groups.next(1, value))
+      values.push_back(value);
+    REQUIRE(values == std::vector<Long>{1, 3, 5});
+
+    groups.add(Int(1), hash_key(Int(1)), 7);
+    REQUIRE(groups.next(1, value));
+    REQUIRE(value == 7);
+    REQUIRE_FALSE(groups.next(1, value));
+
+    values.clear();
+    groups.take(0, values);
+    REQUIRE(values == std::vector<Long>{0, 2, 4});
+    REQUIRE_FALSE(groups.next(0, value));
+  }
+}
\ No newline at end of file
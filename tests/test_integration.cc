@@ -1,9 +1,12 @@
 #include "simplemapreduce/ops/job.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <mpi.h>
@@ -12,8 +15,10 @@
 #include "utils.h"
 #include "simplemapreduce/mapper.h"
 #include "simplemapreduce/reducer.h"
+#include "simplemapreduce/data/codec.h"
 #include "simplemapreduce/data/type.h"
 #include "simplemapreduce/ops/context.h"
+#include "simplemapreduce/ops/partitioner.h"
 
 namespace fs = std::filesystem;
 
@@ -70,15 +75,59 @@ class TestReducer: public Reducer<IK, IV, OK, OV> {
   }
 };
 
+/** Reducer counting values streamed without a vector. */
+template <typename IK, typename IV, typename OK, typename OV>
+class TestStreamReducer: public Reducer<IK, IV, OK, OV> {
+ public:
+  void reduce(const IK& ikey, ValueRange<IV> ivalues, const Context<OK, OV>& context) override {
+    OK key(ikey);
+    OV value = 0;
+    for (auto it = ivalues.begin(); it != ivalues.end(); ++it)
+      ++value;
+    context.write(key, value);
+  }
+};
+
+/** Reducer summing values, whose outputs can be reduced again. */
+template <typename K, typename V>
+class SumReducer: public Reducer<K, V, K, V> {
+ public:
+  void reduce(const K& ikey, const std::vector<V>& values, const Context<K, V>& context) override {
+    K key(ikey);
+    V sum = 0;
+    for (auto& value: values)
+      sum += value;
+    context.write(key, sum);
+  }
+};
+
+/** Partitioner sending all keys to the first reducer. */
+template <typename K>
+class FirstGroupPartitioner : public Partitioner<K> {
+ public:
+  int partition(const K&, std::uint64_t, int) const override { return 0; }
+};
+
 /**
  * Integration test.
  * This will test with given types.
+ * If Partitioner type is given other than void, it is set to the job.
  *
  *  @param target_keys&   data used as key
  *  @param count&         number of times to generate data per key
+ *  @param mpi_shuffle    shuffle over MPI if true, otherwise via files
+ *  @param sort_output    check output files are sorted in the order of file names
+ *  @param compression    codec of shuffled data and output files
+ *  @param n_groups       number of groups, or 0 for the number of workers
+ *  @param grouping       strategy to group values at reduce
+ *  @param reduce_threads number of threads to reduce on each worker
  */
-template <typename IK, typename IV, typename OK, typename OV>
-void test_mapreduce(std::vector<OK>& target_keys, const unsigned int& count) {
+template <typename IK, typename IV, typename OK, typename OV, typename P = void,
+          typename R = TestReducer<IK, IV, OK, OV>>
+void test_mapreduce(std::vector<OK>& target_keys, const unsigned int& count,
+                    bool mpi_shuffle = true, bool sort_output = false,
+                    Compression compression = Compression::none, int n_groups = 0,
+                    Grouping grouping = Grouping::sort, int reduce_threads = 1) {
   fs::path input_dir = tmpdir / "test_job" / "inputs";
   fs::path output_dir = tmpdir / "test_job" / "outputs";
 
@@ -88,9 +137,18 @@ void test_mapreduce(std::vector<OK>& target_keys, const unsigned int& count) {
   job.set_output_path(output_dir);
 
   job.set_config(Config::log_level, 4);
+  job.set_config(Config::mpi_shuffle, bool(mpi_shuffle));
+  job.set_config(Config::sort_output, bool(sort_output));
+  job.set_config(Config::compression, Compression(compression));
+  if (n_groups > 0)
+    job.set_config(Config::n_groups, int(n_groups));
+  job.set_config(Config::grouping, Grouping(grouping));
+  job.set_config(Config::reduce_threads, int(reduce_threads));
 
   job.template set_mapper<TestMapper<IK, IV>>();
-  job.template set_reducer<TestReducer<IK, IV, OK, OV>>();
+  job.template set_reducer<R>();
+  if constexpr (!std::is_void_v<P>)
+    job.template set_partitioner<P>();
 
   int rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -117,9 +175,20 @@ void test_mapreduce(std::vector<OK>& target_keys, const unsigned int& count) {
     /// Check if output directory is created
     REQUIRE(fs::is_directory(output_dir));
 
-    /// Parse output data
-    for (auto& path: fs::directory_iterator(output_dir)) {
-      std::ifstream ifs(path.path());
+    /// Parse output data in the order of file names
+    std::vector<fs::path> paths;
+    for (auto& path: fs::directory_iterator(output_dir))
+      paths.push_back(path.path());
+    std::sort(paths.begin(), paths.end());
+
+    /// An output file is written for each group
+    if (n_groups > 0)
+      REQUIRE(paths.size() == static_cast<size_t>(n_groups));
+
+    for (auto& path: paths) {
+      /// Read compressed output files as well
+      InputFile ifs(path);
+      REQUIRE(ifs.is_compressed() == (compression != Compression::none));
       std::string line;
       OK key;
       OV value;
@@ -135,6 +204,8 @@ void test_mapreduce(std::vector<OK>& target_keys, const unsigned int& count) {
 
     /// Check the result
     REQUIRE_THAT(res, Catch::Matchers::UnorderedEquals(target_keys));
+    if (sort_output)
+      REQUIRE(std::is_sorted(res.begin(), res.end()));
   } else {
     /// For child nodes
     job.run();
@@ -147,10 +218,19 @@ void test_mapreduce(std::vector<OK>& target_keys, const unsigned int& count) {
  *
  *  @param target_keys&   data used as key
  *  @param count&         number of times to generate data per key
+ *  @param mpi_shuffle    shuffle over MPI if true, otherwise via files
+ *  @param sort_output    check output files are sorted in the order of file names
+ *  @param compression    codec of shuffled data and output files
+ *  @param n_groups       number of groups, or 0 for the number of workers
+ *  @param grouping       strategy to group values at reduce
+ *  @param reduce_threads number of threads to reduce on each worker
  */
-template <typename K, typename V>
-void test_mapreduce(std::vector<K>& target_keys, const unsigned int& count) {
-  test_mapreduce<K, V, K, V>(target_keys, count);
+template <typename K, typename V, typename P = void>
+void test_mapreduce(std::vector<K>& target_keys, const unsigned int& count,
+                    bool mpi_shuffle = true, bool sort_output = false,
+                    Compression compression = Compression::none, int n_groups = 0,
+                    Grouping grouping = Grouping::sort, int reduce_threads = 1) {
+  test_mapreduce<K, V, K, V, P>(target_keys, count, mpi_shuffle, sort_output, compression, n_groups, grouping, reduce_threads);
 }
 
 /**
@@ -230,6 +310,74 @@ void test_mapreduce_with_combiner(std::vector<K>& target_keys, const unsigned in
   }
 }
 
+/**
+ * Integration test with skewed keys salted at shuffle.
+ * Output values of each key must be merged into one.
+ *
+ *  @param hot_count    number of times to generate the hot key per file
+ *  @param cold_keys    keys generated once per file
+ *  @param n_files      number of input files
+ *  @param mpi_shuffle  shuffle over MPI if true, otherwise via files
+ */
+void test_mapreduce_with_hot_keys(unsigned int hot_count, std::vector<String>& cold_keys, unsigned int n_files,
+                                  bool mpi_shuffle = true) {
+  fs::path input_dir = tmpdir / "test_job" / "inputs";
+  fs::path output_dir = tmpdir / "test_job" / "outputs";
+
+  /// Setup MapReduce Job
+  Job job;
+  job.add_input_path(input_dir);
+  job.set_output_path(output_dir);
+  job.set_config(Config::log_level, 4);
+  job.set_config(Config::hot_key_salts, 2);
+  job.set_config(Config::mpi_shuffle, bool(mpi_shuffle));
+
+  job.set_mapper<TestMapper<String, Int>>();
+  job.set_reducer<SumReducer<String, Int>>();
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  /// Test only on root node
+  if (rank == 0) {
+    fs::remove_all(input_dir);
+    fs::create_directories(input_dir);
+
+    for (unsigned int i = 0; i < n_files; ++i) {
+      std::ofstream ofs(input_dir / std::to_string(i));
+      for (unsigned int j = 0; j < hot_count; ++j)
+        ofs << "hot ";
+      for (auto& key: cold_keys)
+        ofs << key << " ";
+    }
+
+    job.run();
+
+    /// Each key is written once with the total count
+    std::map<String, Int> res;
+    for (auto& path: fs::directory_iterator(output_dir)) {
+      std::ifstream ifs(path.path());
+      std::string line;
+      String key;
+      Int value;
+      while (std::getline(ifs, line)) {
+        std::istringstream iss(line);
+        iss >> key >> value;
+        REQUIRE(res.count(key) == 0);
+        res[key] = value;
+      }
+    }
+
+    REQUIRE(res.size() == cold_keys.size() + 1);
+    REQUIRE(res["hot"] == static_cast<Int>(hot_count * n_files));
+    for (auto& key: cold_keys)
+      REQUIRE(res[key] == static_cast<Int>(n_files));
+  } else {
+    /// For child nodes
+    job.run();
+  }
+}
+
 TEST_CASE("Integration Test", "[job][mapreduce][integrate]") {
 #ifdef INTEGRATION1
   SECTION("Job:String/Int") {
@@ -255,6 +403,85 @@ TEST_CASE("Integration Test", "[job][mapreduce][integrate]") {
     test_mapreduce<String, Int, String, Long>(keys, 3);
   }
 #endif  // INTEGRATION4
+#ifdef INTEGRATION8
+  SECTION("Job:String/Int with file shuffle") {
+    std::vector<String> keys{"test", "example", "mapreduce"};
+    test_mapreduce<String, Int>(keys, 3, false);
+  }
+#endif  // INTEGRATION8
+#ifdef INTEGRATION9
+  SECTION("Job:String/Int with Partitioner") {
+    std::vector<String> keys{"test", "example", "mapreduce"};
+    test_mapreduce<String, Int, FirstGroupPartitioner<String>>(keys, 3);
+  }
+#endif  // INTEGRATION9
+#ifdef INTEGRATION10
+  SECTION("Job:Long/Int with sorted output") {
+    std::vector<Long> keys;
+    for (Long key = -50; key < 50; ++key)
+      keys.push_back(key * 1000);
+    test_mapreduce<Long, Int>(keys, 3, true, true);
+  }
+#endif  // INTEGRATION10
+#ifdef INTEGRATION11
+  SECTION("Job:String/Int with compression") {
+    std::vector<String> keys{"test", "example", "mapreduce"};
+    test_mapreduce<String, Int>(keys, 3, true, false, Compression::lz);
+  }
+#endif  // INTEGRATION11
+#ifdef INTEGRATION12
+  SECTION("Job:String/Int with file shuffle and compression") {
+    std::vector<String> keys{"test", "example", "mapreduce"};
+    test_mapreduce<String, Int>(keys, 3, false, false, Compression::lz);
+  }
+#endif  // INTEGRATION12
+#ifdef INTEGRATION13
+  SECTION("Job:String/Int with hot keys") {
+    std::vector<String> keys{"test", "example", "mapreduce"};
+    test_mapreduce_with_hot_keys(5000, keys, 4);
+  }
+#endif  // INTEGRATION13
+#ifdef INTEGRATION14
+  SECTION("Job:Long/Int with more groups than workers") {
+    std::vector<Long> keys;
+    for (Long key = -50; key < 50; ++key)
+      keys.push_back(key * 1000);
+    test_mapreduce<Long, Int>(keys, 3, false, true, Compression::none, 7);
+  }
+#endif  // INTEGRATION14
+#ifdef INTEGRATION15
+  SECTION("Job:String/Int with grouping by hash") {
+    std::vector<String> keys{"test", "example", "mapreduce", "hash", "group"};
+    test_mapreduce<String, Int>(keys, 3, false, false, Compression::none, 0, Grouping::hash);
+  }
+#endif  // INTEGRATION15
+#ifdef INTEGRATION16
+  SECTION("Job:String/Int with streaming reducer") {
+    std::vector<String> keys{"test", "example", "mapreduce", "stream"};
+    test_mapreduce<String, Int, String, Int, void, TestStreamReducer<String, Int, String, Int>>(keys, 5, false);
+  }
+#endif  // INTEGRATION16
+#ifdef INTEGRATION17
+  SECTION("Job:Long/Int with sorted output reduced on threads") {
+    /// Keys of each group are more than a batch of a thread
+    std::vector<Long> keys;
+    for (Long key = -3000; key < 3000; ++key)
+      keys.push_back(key * 7);
+    test_mapreduce<Long, Int>(keys, 2, true, true, Compression::none, 0, Grouping::sort, 4);
+  }
+#endif  // INTEGRATION17
+#ifdef INTEGRATION18
+  SECTION("Job:String/Int with hot keys over workers with file shuffle") {
+    /// Salted keys are merged across workers only with two or more workers besides the master.
+    /// With file shuffle, the group of a worker can be reduced by another worker.
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    REQUIRE(size >= 3);
+
+    std::vector<String> keys{"test", "example", "mapreduce", "salt", "merge"};
+    test_mapreduce_with_hot_keys(5000, keys, 8, false);
+  }
+#endif  // INTEGRATION18
   fs::remove_all(tmpdir);
 }
 
@@ -1,7 +1,9 @@
 #include "simplemapreduce/proc/loader.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <string>
@@ -12,6 +14,7 @@
 
 #include "utils.h"
 #include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/codec.h"
 #include "simplemapreduce/data/queue.h"
 #include "simplemapreduce/data/type.h"
 #include "simplemapreduce/ops/conf.h"
@@ -163,6 +166,58 @@ TEST_CASE("load_data", "[binary][read][file]") {
   fs::remove_all(tmpdir);
 }
 
+TEST_CASE("PartitionedFileReader", "[binary][read][file]") {
+  fs::path dir{tmpdir / "test_loader"};
+  fs::create_directories(dir);
+  auto path = shuffle_file_path(dir, 0);
+
+  /// Partitions are written in turns, so that each has several segments in the file
+  std::vector<std::string> targets(3);
+  {
+    PartitionedFileWriter file(path, targets.size() + 1);
+    for (int i = 0; i < 50000; ++i) {
+      int id = i % 7 % targets.size();
+      std::string bytes = std::to_string(i) + ",";
+      if (i % 5 == 0) {
+        for (auto c: bytes)
+          file.partition(id)->sputc(c);
+      } else {
+        file.partition(id)->sputn(bytes.data(), bytes.size());
+      }
+      targets[id] += bytes;
+    }
+  }
+  REQUIRE(fs::exists(PartitionedFileWriter::index_path(path)));
+
+  PartitionedFileReader reader(path);
+  REQUIRE(reader.is_open());
+  REQUIRE(reader.size() == static_cast<int>(targets.size() + 1));
+  REQUIRE(reader.open(targets.size()) == nullptr);
+
+  for (size_t id = 0; id < targets.size(); ++id) {
+    auto fin = reader.open(id);
+    REQUIRE(fin != nullptr);
+    std::string bytes(std::istreambuf_iterator<char>(*fin), {});
+    REQUIRE(bytes == targets[id]);
+
+    /// Seek across segments and chunks
+    for (size_t pos: {size_t(0), targets[id].size() / 3, targets[id].size() - 10}) {
+      fin->clear();
+      fin->seekg(pos);
+      char part[10];
+      fin->read(part, sizeof(part));
+      REQUIRE(fin->gcount() == sizeof(part));
+      REQUIRE(std::string(part, sizeof(part)) == targets[id].substr(pos, sizeof(part)));
+      REQUIRE(static_cast<size_t>(fin->tellg()) == pos + sizeof(part));
+    }
+  }
+
+  /// No file is written by the worker
+  REQUIRE_FALSE(PartitionedFileReader(shuffle_file_path(dir, 1)).is_open());
+
+  fs::remove_all(tmpdir);
+}
+
 TEST_CASE("DataLoader", "[data_loader]") {
   /// Target key-value pairs
   std::vector<BytePair> targets{
@@ -186,7 +241,8 @@ TEST_CASE("DataLoader", "[data_loader]") {
 
 /** Test BinaryFileDataLoader. */
 template <typename K, typename V>
-void test_binary_file_data_loader(std::vector<K>& keys, std::vector<V>& values) {
+void test_binary_file_data_loader(std::vector<K>& keys, std::vector<V>& values,
+                                  bool front_coding = false) {
   std::shared_ptr<JobConf> conf = std::make_shared<JobConf>();
   conf->n_groups = 1;
   conf->worker_rank = 0;
@@ -194,9 +250,6 @@ void test_binary_file_data_loader(std::vector<K>& keys, std::vector<V>& values)
   conf->tmpdir = tmpdir / "test_loader";
 
   fs::create_directories(conf->tmpdir);
-  fs::path fname{"0000-00000"};
-
-  clear_file(conf->tmpdir / fname);
 
   /// Used for value check
   std::vector<ByteData> target_keys;
@@ -204,7 +257,8 @@ void test_binary_file_data_loader(std::vector<K>& keys, std::vector<V>& values)
 
   /// Write binary data to a target file
   {
-    BinaryFileWriter<String, Int> writer(conf->tmpdir / fname);
+    PartitionedFileWriter file(shuffle_file_path(conf->tmpdir, 0), conf->n_groups);
+    BinaryFileWriter<String, Int> writer(file.partition(0), front_coding);
 
     for (auto& key: keys) {
       std::vector<ByteData> vals;
@@ -269,6 +323,214 @@ TEST_CASE("BinaryFileDataLoader", "[data_loader][binary]") {
     test_binary_file_data_loader<Long, Double>(keys, values);
   }
 
+  SECTION("String/Int front coded") {
+    std::vector<String> keys{"prefix-b", "prefix-a", "prefix-ab", "other"};
+    std::vector<Int> values{1, 4321, -1234};
+
+    test_binary_file_data_loader<String, Int>(keys, values, true);
+  }
+
+  SECTION("Int/Long front coded") {
+    std::vector<Int> keys{123, 234, 0, 345, -401};
+    std::vector<Long> values{1, 123456789l, 123456789l};
+
+    test_binary_file_data_loader<Int, Long>(keys, values, true);
+  }
+
+  fs::remove_all(tmpdir);
+}
+
+TEST_CASE("BinaryFileDataLoader mixed encodings", "[data_loader][binary]") {
+  std::shared_ptr<JobConf> conf = std::make_shared<JobConf>();
+  conf->n_groups = 1;
+  conf->worker_rank = 0;
+  conf->worker_size = 2;
+  conf->tmpdir = tmpdir / "test_loader_mixed";
+
+  fs::create_directories(conf->tmpdir);
+
+  /// Enough records to flush several front coded runs
+  const int n_records = 300000;
+  std::map<ByteData, std::vector<ByteData>> targets;
+  {
+    /// Files written by two workers, whose group 0 is reduced on this worker
+    PartitionedFileWriter file0(shuffle_file_path(conf->tmpdir, 0), conf->n_groups);
+    PartitionedFileWriter file1(shuffle_file_path(conf->tmpdir, 1), conf->n_groups);
+    BinaryFileWriter<String, Int> plain(file0.partition(0));
+    BinaryFileWriter<String, Int> coded(file1.partition(0), true);
+
+    for (int i = 0; i < n_records; ++i) {
+      ByteData key(String{"key-" + std::to_string(i % 1000)});
+      ByteData value(Int{i});
+      targets[key].push_back(value);
+      if (i % 2 == 0)
+        plain.write(ByteData(key), ByteData(value));
+      else
+        coded.write(ByteData(key), ByteData(value));
+    }
+  }
+
+  std::unique_ptr<DataLoader> loader =
+      std::make_unique<BinaryFileDataLoader<String, Int>>(conf);
+  REQUIRE_FALSE(loader->is_sorted());
+
+  std::map<ByteData, std::vector<ByteData>> res;
+  BytePair data;
+  while (!(data = loader->get_item()).first.empty())
+    res[data.first].push_back(data.second);
+
+  REQUIRE(res.size() == targets.size());
+  for (auto& [key, values]: targets) {
+    auto& got = res[key];
+    REQUIRE_THAT(got, Catch::Matchers::UnorderedEquals(values));
+  }
+
+  fs::remove_all(tmpdir);
+}
+
+TEST_CASE("BinaryFileDataLoader merging sorted runs", "[data_loader][binary]") {
+  std::shared_ptr<JobConf> conf = std::make_shared<JobConf>();
+  conf->n_groups = 1;
+  conf->worker_rank = 0;
+  conf->worker_size = 2;
+  conf->tmpdir = tmpdir / "test_loader_sorted";
+
+  fs::create_directories(conf->tmpdir);
+
+  /// Enough records to write several runs read in chunks
+  const int n_records = 300000;
+  std::map<ByteData, std::vector<ByteData>> targets;
+  {
+    /// Files written by two workers, whose group 0 is reduced on this worker
+    PartitionedFileWriter file0(shuffle_file_path(conf->tmpdir, 0), conf->n_groups);
+    PartitionedFileWriter file1(shuffle_file_path(conf->tmpdir, 1), conf->n_groups);
+    BinaryFileWriter<Int, Int> sorted(file0.partition(0), false, true);
+    BinaryFileWriter<Int, Int> coded(file1.partition(0), true);
+
+    for (int i = 0; i < n_records; ++i) {
+      ByteData key(Int{i % 5000 * 7919 % 5000 - 2500});
+      ByteData value(Int{i});
+      targets[key].push_back(value);
+      if (i % 3 == 0)
+        sorted.write(ByteData(key), ByteData(value));
+      else
+        coded.write(ByteData(key), ByteData(value));
+    }
+  }
+
+  std::unique_ptr<DataLoader> loader =
+      std::make_unique<BinaryFileDataLoader<Int, Int>>(conf);
+  REQUIRE(loader->is_sorted());
+
+  /// Items are returned in the order of keys
+  std::map<ByteData, std::vector<ByteData>> res;
+  std::vector<Int> keys;
+  BytePair data;
+  while (!(data = loader->get_item()).first.empty()) {
+    keys.push_back(data.first.get_data<Int>());
+    res[data.first].push_back(data.second);
+  }
+
+  REQUIRE(keys.size() == n_records);
+  REQUIRE(std::is_sorted(keys.begin(), keys.end()));
+  REQUIRE(res.size() == targets.size());
+  for (auto& [key, values]: targets)
+    REQUIRE_THAT(res[key], Catch::Matchers::UnorderedEquals(values));
+
+  fs::remove_all(tmpdir);
+}
+
+TEST_CASE("BinaryFileDataLoader of a group", "[data_loader][binary]") {
+  std::shared_ptr<JobConf> conf = std::make_shared<JobConf>();
+  conf->n_groups = 5;
+  conf->worker_rank = 0;
+  conf->worker_size = 2;
+  conf->tmpdir = tmpdir / "test_loader_group";
+
+  fs::create_directories(conf->tmpdir);
+
+  /// Files of two workers, whose records are in the group of the key
+  {
+    for (int rank = 0; rank < conf->worker_size; ++rank) {
+      PartitionedFileWriter file(shuffle_file_path(conf->tmpdir, rank), conf->n_groups);
+      std::vector<std::unique_ptr<BinaryFileWriter<Int, Int>>> writers;
+      for (int id = 0; id < conf->n_groups; ++id)
+        writers.push_back(std::make_unique<BinaryFileWriter<Int, Int>>(file.partition(id), false, true));
+      for (int key = 0; key < 100; ++key)
+        writers[key % conf->n_groups]->write(ByteData(Int{key}), ByteData(Int{rank}));
+    }
+  }
+
+  /// Groups more than workers can be loaded on any worker
+  for (int id: {0, 3}) {
+    auto loader = std::make_unique<BinaryFileDataLoader<Int, Int>>(conf, id);
+    size_t count = 0;
+    BytePair data;
+    while (!(data = loader->get_item()).first.empty()) {
+      REQUIRE(data.first.get_data<Int>() % conf->n_groups == id);
+      ++count;
+    }
+    REQUIRE(count == static_cast<size_t>(100 / conf->n_groups * conf->worker_size));
+  }
+
+  fs::remove_all(tmpdir);
+}
+
+TEST_CASE("BinaryFileDataLoader compressed files", "[data_loader][binary][codec]") {
+  std::shared_ptr<JobConf> conf = std::make_shared<JobConf>();
+  conf->n_groups = 1;
+  conf->worker_rank = 0;
+  conf->worker_size = 2;
+  conf->tmpdir = tmpdir / "test_loader_compressed";
+
+  fs::create_directories(conf->tmpdir);
+
+  const int n_records = 100000;
+  auto codec = get_codec(mapreduce::Compression::lz);
+  std::map<ByteData, std::vector<ByteData>> targets;
+  CompressionStats stats;
+  {
+    /// Files written by two workers, whose group 0 is reduced on this worker
+    PartitionedFileWriter file0(shuffle_file_path(conf->tmpdir, 0), conf->n_groups);
+    PartitionedFileWriter file1(shuffle_file_path(conf->tmpdir, 1), conf->n_groups);
+    BinaryFileWriter<String, Int> sorted(file0.partition(0), true, true, codec);
+    BinaryFileWriter<String, Int> plain(file1.partition(0), false, false, codec);
+
+    for (int i = 0; i < n_records; ++i) {
+      ByteData key(String{"key" + std::to_string(i % 1000)});
+      ByteData value(Int{i});
+      targets[key].push_back(value);
+      if (i % 2 == 0)
+        sorted.write(ByteData(key), ByteData(value));
+      else
+        plain.write(ByteData(key), ByteData(value));
+    }
+    sorted.close();
+    plain.close();
+    stats += sorted.stats();
+    stats += plain.stats();
+  }
+
+  /// Repetitive keys are stored in fewer bytes
+  REQUIRE(stats.stored_bytes < stats.raw_bytes);
+  REQUIRE(InputFile(PartitionedFileReader(shuffle_file_path(conf->tmpdir, 0)).open(0)).is_compressed());
+
+  std::unique_ptr<DataLoader> loader =
+      std::make_unique<BinaryFileDataLoader<String, Int>>(conf);
+
+  std::map<ByteData, std::vector<ByteData>> res;
+  BytePair data;
+  size_t count = 0;
+  while (!(data = loader->get_item()).first.empty()) {
+    res[data.first].push_back(data.second);
+    ++count;
+  }
+
+  REQUIRE(count == n_records);
+  REQUIRE(res.size() == targets.size());
+  for (auto& [key, values]: targets)
+    REQUIRE_THAT(res[key], Catch::Matchers::UnorderedEquals(values));
+
   fs::remove_all(tmpdir);
 }
 
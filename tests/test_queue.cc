@@ -1,5 +1,6 @@
 #include "simplemapreduce/data/queue.h"
 
+#include <filesystem>
 #include <string>
 #include <thread>
 #include <utility>
@@ -8,6 +9,9 @@
 #include "catch.hpp"
 
 #include "simplemapreduce/data/bytes.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
 
 using namespace mapreduce::data;
 
@@ -98,4 +102,135 @@ TEST_CASE("MessageQueue with threads", "[mq][threads]") {
   }
 
   REQUIRE(res == sum);
+}
+
+TEST_CASE("MessageQueue with batches", "[mq][batch]") {
+  MessageQueue mq;
+
+  RecordBatch batch;
+  for (int i = 0; i < 10; ++i)
+    batch.append(ByteData{std::string("test")}, ByteData{i});
+  mq.send_batch(std::move(batch));
+
+  /// Single records are received in order after the batch
+  mq.send(ByteData{std::string("single")}, ByteData{10});
+  mq.end();
+
+  /// Read partially as records and take rest of them as a batch
+  for (int i = 0; i < 3; ++i) {
+    BytePair pair = mq.receive();
+    REQUIRE(pair.second.get_data<int>() == i);
+  }
+
+  auto rest = mq.receive_batch();
+  REQUIRE(rest.size() == 7);
+  for (size_t i = 0; i < rest.size(); ++i)
+    REQUIRE(rest.get_value<int>(i) == static_cast<int>(i) + 3);
+
+  auto single = mq.receive_batch();
+  REQUIRE(single.size() == 1);
+  REQUIRE(single.get_key<std::string>(0) == "single");
+
+  REQUIRE(mq.receive_batch().empty());
+}
+
+TEST_CASE("MessageQueue with concurrent producer and consumer", "[mq][threads][batch]") {
+  MessageQueue mq;
+
+  /// Send batches more than a segment while the consumer is reading
+  size_t n_batches = MessageQueue::kSegmentSize * 3 + 1;
+  std::thread producer([&mq, n_batches] {
+    for (size_t i = 0; i < n_batches; ++i) {
+      RecordBatch batch;
+      batch.append(ByteData{std::string("test")}, ByteData{long(i)});
+      batch.append(ByteData{std::string("test")}, ByteData{long(i)});
+      mq.send_batch(std::move(batch));
+    }
+    mq.end();
+  });
+
+  long expected = 0;
+  bool ordered = true;
+  for (auto batch = mq.receive_batch(); !batch.empty(); batch = mq.receive_batch()) {
+    ordered &= batch.size() == 2 && batch.get_value<long>(0) == expected;
+    ++expected;
+  }
+  producer.join();
+
+  REQUIRE(ordered);
+  REQUIRE(expected == static_cast<long>(n_batches));
+}
+
+TEST_CASE("MessageQueue with memory limit", "[mq][batch]") {
+  auto spill_dir = tmpdir / "test_queue";
+  fs::create_directories(spill_dir);
+
+  auto make_batch = [](long num) {
+    RecordBatch batch;
+    for (long i = 0; i < 10; ++i)
+      batch.append(ByteData{std::string("test")}, ByteData{num});
+    return batch;
+  };
+  size_t batch_bytes = make_batch(0).bytes();
+  long n_batches = 20;
+
+  SECTION("Spill and replay in order") {
+    MessageQueue mq;
+    mq.set_max_bytes(batch_bytes * 2, spill_dir / "mq");
+
+    /// Send all data before the consumer starts
+    for (long i = 0; i < n_batches; ++i)
+      mq.send_batch(make_batch(i));
+    mq.end();
+
+    REQUIRE_FALSE(fs::is_empty(spill_dir));
+
+    long expected = 0;
+    bool ordered = true;
+    for (auto batch = mq.receive_batch(); !batch.empty(); batch = mq.receive_batch()) {
+      ordered &= batch.size() == 10 && batch.get_value<long>(9) == expected;
+      ++expected;
+    }
+
+    REQUIRE(ordered);
+    REQUIRE(expected == n_batches);
+
+    /// Spill files are removed once replayed
+    REQUIRE(fs::is_empty(spill_dir));
+  }
+
+  SECTION("Mixed with records sent while replaying") {
+    MessageQueue mq;
+    mq.set_max_bytes(batch_bytes, spill_dir / "mq");
+
+    for (long i = 0; i < n_batches; ++i)
+      mq.send_batch(make_batch(i));
+
+    /// Send data back while reading as Shuffle does
+    for (long i = 0; i < n_batches; ++i) {
+      auto batch = mq.receive_batch();
+      REQUIRE(batch.get_value<long>(0) == i);
+      mq.send_batch(std::move(batch));
+    }
+    mq.end();
+
+    long expected = 0;
+    for (auto data = mq.receive(); !data.first.empty(); data = mq.receive())
+      REQUIRE(data.second.get_data<long>() == expected++ / 10);
+    REQUIRE(expected == n_batches * 10);
+  }
+
+  SECTION("Remove spill files not replayed") {
+    {
+      MessageQueue mq;
+      mq.set_max_bytes(batch_bytes, spill_dir / "mq");
+      for (long i = 0; i < n_batches; ++i)
+        mq.send_batch(make_batch(i));
+
+      REQUIRE_FALSE(fs::is_empty(spill_dir));
+    }
+    REQUIRE(fs::is_empty(spill_dir));
+  }
+
+  fs::remove_all(spill_dir);
 }
\ No newline at end of file
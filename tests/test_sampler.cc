@@ -0,0 +1,166 @@
+#include "simplemapreduce/proc/sampler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "simplemapreduce/data/bytes.h"
+#include "simplemapreduce/data/type.h"
+#include "simplemapreduce/ops/partitioner.h"
+
+using namespace mapreduce;
+using namespace mapreduce::data;
+using namespace mapreduce::proc;
+using namespace mapreduce::type;
+
+TEST_CASE("KeySampler", "[sampler]") {
+
+  SECTION("Keep all keys under capacity") {
+    KeySampler sampler(10);
+    sampler.add(String{"b"});
+    sampler.add(String{"a"});
+    REQUIRE(sampler.count() == 2);
+    REQUIRE_THAT(sampler.samples(), Catch::Matchers::UnorderedEquals(std::vector<std::string>{"a", "b"}));
+  }
+
+  SECTION("Keep at most capacity keys") {
+    KeySampler sampler(100);
+    for (Int i = 0; i < 10000; ++i)
+      sampler.add(i);
+    REQUIRE(sampler.count() == 10000);
+    REQUIRE(sampler.samples().size() == 100);
+
+    /// Samples are spread over all keys rather than the first ones
+    auto max_key = std::max_element(sampler.samples().begin(), sampler.samples().end());
+    REQUIRE(ByteView(*max_key).get_data<Int>() > 5000);
+  }
+
+  SECTION("Same bytes from typed and encoded keys") {
+    using KeyType = CompositeKey<Long, String>;
+    KeySampler typed, encoded;
+    typed.add(KeyType(-12345l, "second"));
+    encoded.add(ByteData{KeyType(-12345l, "second")}.view());
+    REQUIRE(typed.samples() == encoded.samples());
+    REQUIRE(ByteView(typed.samples()[0]).get_data<Long>() == -12345l);
+  }
+}
+
+TEST_CASE("HotKeySketch", "[sampler][hot_keys]") {
+
+  SECTION("Detect frequent keys") {
+    HotKeySketch sketch(16, 0.1, 100);
+    for (std::uint64_t i = 0; i < 10000; ++i) {
+      /// Key 0 takes 1/2 and key 1 takes 1/4 of all keys, others are unique
+      std::uint64_t hash = i % 2 == 0 ? 0 : (i % 4 == 1 ? 1 : i);
+      sketch.add(hash);
+    }
+    REQUIRE(sketch.count() == 10000);
+    REQUIRE(sketch.hot_keys().size() == 2);
+    REQUIRE(sketch.hot_keys().count(0) == 1);
+    REQUIRE(sketch.hot_keys().count(1) == 1);
+
+    /// Counts are underestimated by at most count / capacity
+    REQUIRE(sketch.hot_keys().at(0) <= 5000);
+    REQUIRE(sketch.hot_keys().at(0) >= 5000 - 10000 / 16);
+  }
+
+  SECTION("No hot keys until min_count") {
+    HotKeySketch sketch(16, 0.1, 100);
+    for (int i = 0; i < 99; ++i)
+      REQUIRE_FALSE(sketch.add(7));
+    REQUIRE(sketch.add(7));
+    REQUIRE(sketch.hot_keys().size() == 1);
+  }
+
+  SECTION("Keep hot keys") {
+    HotKeySketch sketch(4, 0.5, 10);
+    for (int i = 0; i < 10; ++i)
+      sketch.add(7);
+    REQUIRE(sketch.add(7));
+
+    /// Still hot even if the share becomes lower
+    for (std::uint64_t i = 100; i < 1000; ++i)
+      REQUIRE_FALSE(sketch.add(i));
+    REQUIRE(sketch.add(7));
+    REQUIRE(sketch.hot_keys().at(7) == 12);
+  }
+}
+
+TEST_CASE("split_points", "[sampler]") {
+
+  SECTION("Evenly split samples") {
+    std::vector<std::string> samples;
+    for (char c = 'j'; c >= 'a'; --c)
+      samples.emplace_back(1, c);
+
+    auto splits = split_points(samples, 5);
+    REQUIRE(splits == std::vector<std::string>{"c", "e", "g", "i"});
+  }
+
+  SECTION("No samples") {
+    REQUIRE(split_points({}, 5).empty());
+    REQUIRE(split_points({"a", "b"}, 1).empty());
+  }
+
+  SECTION("Write and read keys") {
+    std::vector<std::string> keys{"", "key", std::string("\0\1", 2)};
+    std::vector<char> data;
+    write_keys(keys, data);
+    REQUIRE(read_keys(data.data(), data.size()) == keys);
+    REQUIRE_THROWS(read_keys(data.data(), data.size() - 1));
+  }
+}
+
+TEST_CASE("RangePartitioner", "[sampler][partitioner]") {
+
+  SECTION("String") {
+    RangePartitioner<String> partitioner({"c", "e"});
+    REQUIRE(partitioner.partition("a", 0, 3) == 0);
+    REQUIRE(partitioner.partition("c", 0, 3) == 1);
+    REQUIRE(partitioner.partition("dog", 0, 3) == 1);
+    REQUIRE(partitioner.partition("zoo", 0, 3) == 2);
+  }
+
+  SECTION("Numbers in the order of values") {
+    KeySampler sampler;
+    for (Int i = -500; i < 500; ++i)
+      sampler.add(i);
+
+    RangePartitioner<Int> partitioner(split_points(sampler.samples(), 4));
+    int prev = 0;
+    for (Int i = -500; i < 500; ++i) {
+      int id = partitioner.partition(i, 0, 4);
+      REQUIRE(id >= prev);
+      prev = id;
+    }
+    REQUIRE(partitioner.partition(-500, 0, 4) == 0);
+    REQUIRE(partitioner.partition(499, 0, 4) == 3);
+  }
+
+  SECTION("CompositeKey by the first data") {
+    using KeyType = CompositeKey<String, Int>;
+    RangePartitioner<KeyType> partitioner({"m"});
+    REQUIRE(partitioner.partition(KeyType("city", 100), 0, 2) == 0);
+    REQUIRE(partitioner.partition(KeyType("city", -100), 0, 2) == 0);
+    REQUIRE(partitioner.partition(KeyType("town", 0), 0, 2) == 1);
+  }
+
+  SECTION("Numbers with bytes ending like CompositeKey") {
+    /// 0x0001000000000001 is encoded with SOH at the second byte and the trailer of 1 at the end
+    std::vector<Long> keys{1l, 2l, 0x0001000000000000l, 0x0001000000000001l, 0x0002000000000000l};
+    KeySampler sampler;
+    for (auto& key: keys)
+      sampler.add(key);
+
+    /// Split points are the 2nd and 4th keys
+    RangePartitioner<Long> partitioner(split_points(sampler.samples(), 3));
+    REQUIRE(partitioner.partition(1l, 0, 3) == 0);
+    REQUIRE(partitioner.partition(2l, 0, 3) == 1);
+    REQUIRE(partitioner.partition(0x0001000000000000l, 0, 3) == 1);
+    REQUIRE(partitioner.partition(0x0001000000000001l, 0, 3) == 2);
+    REQUIRE(partitioner.partition(0x0002000000000000l, 0, 3) == 2);
+  }
+}
\ No newline at end of file
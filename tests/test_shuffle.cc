@@ -4,7 +4,9 @@
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <numeric>
 #include <string>
+#include <thread>
 #include <vector>
 #include <utility>
 
@@ -15,6 +17,8 @@
 #include "simplemapreduce/data/queue.h"
 #include "simplemapreduce/data/type.h"
 #include "simplemapreduce/ops/conf.h"
+#include "simplemapreduce/proc/loader.h"
+#include "simplemapreduce/proc/sampler.h"
 
 namespace fs = std::filesystem;
 
@@ -24,44 +28,46 @@ using namespace mapreduce::proc;
 using namespace mapreduce::type;
 
 /**
- * Read binary file.
+ * Read binary data of a group.
  * The key type is string and value type is any non-array datatype.
  */
 template <typename K, typename V>
 class BinFileReader {
  public:
-  BinFileReader(const fs::path& path) {
-    ifs.open(path, std::ios::binary | std::ios::in);
-  }
-  ~BinFileReader() { ifs.close(); }
+  BinFileReader(std::shared_ptr<std::istream> fin) : fin_(fin) {}
 
   void read_data(std::vector<BytePair>& items) {
     while (true) {
-      auto key = read_binary<K>(ifs);
-      if (ifs.eof())
+      auto key = read_binary<K>(*fin_);
+      if (fin_->eof())
         break;
 
       /// Read value data
-      auto value = read_binary<V>(ifs);
+      auto value = read_binary<V>(*fin_);
       items.emplace_back(key, value);
     }
   }
 
  private:
-  std::ifstream ifs;
+  std::shared_ptr<std::istream> fin_;
 };
 
 /**
- * Read data from given binary files.
+ * Read data of given groups from the intermediate file of a worker.
  *
- *  @param files       target files to read
+ *  @param file        intermediate file written by Shuffle
+ *  @param ids         target groups to read
  *  @param container   vector to store key-value pair read from files
  */
 template <typename K, typename V>
-void read_all_data(std::vector<fs::path>& files, std::vector<BytePair>& container) {
-  for (auto& file: files) {
-    BinFileReader<K, V> reader(file);
-    reader.read_data(container);
+void read_all_data(const fs::path& file, const std::vector<int>& ids, std::vector<BytePair>& container) {
+  PartitionedFileReader reader(file);
+  REQUIRE(reader.is_open());
+  for (auto id: ids) {
+    if (auto fin = reader.open(id)) {
+      BinFileReader<K, V> group(fin);
+      group.read_data(container);
+    }
   }
 }
 
@@ -76,7 +82,8 @@ void test_shuffle(std::vector<BytePair>& dataset) {
 
   conf->worker_rank = 0;
   conf->worker_size = 2;
-  conf->n_groups = 5;  // this will be equal to a number of output files
+  conf->n_groups = 5;  // this will be equal to a number of groups in the file
+  conf->sort_runs = false;  // files are read in plain format
 
   /// Store all shuffled results
   std::vector<BytePair> kv_items;
@@ -100,12 +107,17 @@ void test_shuffle(std::vector<BytePair>& dataset) {
     }
   }
 
-  /// Total file counts after processed by shuffler
+  /// A data file and the index after processed by shuffler
   std::vector<fs::path> bin_files;
   extract_files(conf->tmpdir, bin_files);
-  REQUIRE(bin_files.size() == conf->n_groups);
+  REQUIRE(bin_files.size() == 2);
+
+  auto file = shuffle_file_path(conf->tmpdir, conf->worker_rank);
+  REQUIRE(PartitionedFileReader(file).size() == conf->n_groups);
 
-  read_all_data<K, V>(bin_files, kv_items);
+  std::vector<int> ids(conf->n_groups);
+  std::iota(ids.begin(), ids.end(), 0);
+  read_all_data<K, V>(file, ids, kv_items);
 
   /// Check original data and stored data are the same
   REQUIRE_THAT(kv_items, Catch::Matchers::UnorderedEquals(dataset));
@@ -209,5 +221,216 @@ TEST_CASE("Shuffle with CompositeKey", "[shuffle][pair]") {
     test_shuffle<KeyType, Float>(dataset);
   }
 
+  fs::remove_all(tmpdir);
+}
+
+/** Partition keys by the first character. */
+class FirstCharPartitioner : public Partitioner<String> {
+ public:
+  int partition(const String& key, std::uint64_t, int n_groups) const override {
+    if (key[0] == 't')
+      return 0;
+    return key[0] == 'e' ? 1 : n_groups - 1;
+  }
+};
+
+TEST_CASE("Shuffle with Partitioner", "[shuffle][partitioner]") {
+  std::shared_ptr<JobConf> conf = std::make_shared<JobConf>();
+  conf->tmpdir = tmpdir / "test_shuffle";
+  fs::remove_all(conf->tmpdir);
+  fs::create_directories(conf->tmpdir);
+
+  conf->worker_rank = 0;
+  conf->worker_size = 2;
+  conf->n_groups = 5;
+  conf->sort_runs = false;
+
+  std::vector<String> keys{"test", "tab", "example", "exit", "apple"};
+
+  SECTION("Route keys by Partitioner") {
+    auto mq = std::make_shared<MessageQueue>();
+    Shuffle<String, Int> shuffle(mq, conf, std::make_shared<FirstCharPartitioner>());
+
+    for (auto& key: keys)
+      mq->send(ByteData{String(key)}, ByteData{Int{1}});
+    mq->end();
+
+    shuffle.run();
+
+    /// Keys starting with 't' are kept on this worker
+    std::vector<String> local;
+    for (auto data = mq->receive(); !data.first.empty(); data = mq->receive())
+      local.push_back(data.first.get_data<String>());
+    REQUIRE_THAT(local, Catch::Matchers::UnorderedEquals(std::vector<String>{"test", "tab"}));
+
+    auto file = shuffle_file_path(conf->tmpdir, conf->worker_rank);
+    std::vector<BytePair> items;
+    read_all_data<String, Int>(file, {1}, items);
+    REQUIRE(items.size() == 2);
+    REQUIRE(items[0].first.get_data<String>() == "example");
+    REQUIRE(items[1].first.get_data<String>() == "exit");
+
+    items.clear();
+    read_all_data<String, Int>(file, {4}, items);
+    REQUIRE(items.size() == 1);
+    REQUIRE(items[0].first.get_data<String>() == "apple");
+  }
+
+  SECTION("HashPartitioner is the same as default") {
+    HashPartitioner<String> partitioner;
+    for (auto& key: keys) {
+      auto hash = hash_key(key);
+      REQUIRE(partitioner.partition(key, hash, conf->n_groups) == static_cast<int>(hash % conf->n_groups));
+    }
+  }
+
+  fs::remove_all(tmpdir);
+}
+
+TEST_CASE("Shuffle salting hot keys", "[shuffle][hot_keys]") {
+  std::shared_ptr<JobConf> conf = std::make_shared<JobConf>();
+  conf->tmpdir = tmpdir / "test_shuffle";
+  fs::remove_all(conf->tmpdir);
+  fs::create_directories(conf->tmpdir);
+
+  conf->worker_rank = 0;
+  conf->worker_size = 2;
+  conf->n_groups = 5;
+  conf->sort_runs = false;
+  conf->hot_key_salts = 3;
+
+  auto mq = std::make_shared<MessageQueue>();
+  auto sketch = std::make_shared<HotKeySketch>(16, 0.1, 100);
+  size_t n_hot = 3000, n_cold = 1000;
+  {
+    Shuffle<String, Int> shuffle(mq, conf);
+    shuffle.set_sketch(sketch);
+
+    for (size_t i = 0; i < n_hot + n_cold; ++i) {
+      String key = i % 4 == 3 ? "cold" + std::to_string(i) : "hot";
+      mq->send(ByteData{std::move(key)}, ByteData{Int(i)});
+    }
+    mq->end();
+    shuffle.run();
+  }
+
+  auto hot_hash = hash_key(String{"hot"});
+  REQUIRE(sketch->hot_keys().size() == 1);
+  REQUIRE(sketch->hot_keys().count(hot_hash) == 1);
+
+  /// Records of the hot key are spread over the group of the key and the following groups
+  std::vector<size_t> n_records(conf->n_groups, 0);
+  size_t n_total = 0;
+  for (auto data = mq->receive(); !data.first.empty(); data = mq->receive()) {
+    ++n_records[0];
+    ++n_total;
+  }
+  for (int id = 1; id < conf->n_groups; ++id) {
+    std::vector<BytePair> items;
+    read_all_data<String, Int>(shuffle_file_path(conf->tmpdir, conf->worker_rank), {id}, items);
+    for (auto& item: items) {
+      auto hash = hash_key(item.first.view());
+      if (hash != hot_hash)
+        REQUIRE(static_cast<int>(hash % conf->n_groups) == id);
+    }
+    n_records[id] = items.size();
+    n_total += items.size();
+  }
+  REQUIRE(n_total == n_hot + n_cold);
+
+  int home = hot_hash % conf->n_groups;
+  for (int salt = 0; salt < conf->hot_key_salts; ++salt)
+    REQUIRE(n_records[(home + salt) % conf->n_groups] >= (n_hot - 100) / conf->hot_key_salts);
+
+  fs::remove_all(tmpdir);
+}
+
+TEST_CASE("Shuffle while producing data", "[shuffle][pipeline]") {
+  std::shared_ptr<JobConf> conf = std::make_shared<JobConf>();
+  conf->tmpdir = tmpdir / "test_shuffle";
+  fs::remove_all(conf->tmpdir);
+  fs::create_directories(conf->tmpdir);
+
+  conf->worker_rank = 0;
+  conf->worker_size = 2;
+  conf->n_groups = 2;
+  conf->sort_runs = false;
+
+  auto mq = std::make_shared<MessageQueue>();
+  auto out = std::make_shared<MessageQueue>();
+  size_t n_records = 10000;
+
+  {
+    Shuffle<String, Int> shuffle(mq, conf);
+    shuffle.set_output(out);
+
+    /// Shuffle consumes records while they are written
+    std::thread consumer([&shuffle]{ shuffle.run(); });
+    for (size_t i = 0; i < n_records; ++i)
+      mq->send(ByteData{String{"key" + std::to_string(i)}}, ByteData{Int(i)});
+    mq->end();
+    consumer.join();
+  }
+
+  /// Records of this worker are only in the output queue
+  size_t n_local = 0;
+  for (auto data = out->receive(); !data.first.empty(); data = out->receive()) {
+    REQUIRE(hash_key(data.first.view()) % conf->n_groups == 0);
+    ++n_local;
+  }
+
+  std::vector<BytePair> items;
+  read_all_data<String, Int>(shuffle_file_path(conf->tmpdir, conf->worker_rank), {1}, items);
+  REQUIRE(n_local + items.size() == n_records);
+  REQUIRE(n_local > 0);
+  REQUIRE(items.size() > 0);
+
+  fs::remove_all(tmpdir);
+}
+TEST_CASE("Shuffle grouping records of this worker", "[shuffle][sorter]") {
+  std::shared_ptr<JobConf> conf = std::make_shared<JobConf>();
+  conf->tmpdir = tmpdir / "test_shuffle";
+  fs::remove_all(conf->tmpdir);
+  fs::create_directories(conf->tmpdir);
+
+  conf->worker_rank = 0;
+  conf->worker_size = 2;
+  conf->n_groups = 2;
+  conf->sort_runs = false;
+
+  auto mq = std::make_shared<MessageQueue>();
+  auto out = std::make_shared<MessageQueue>();
+  auto sorter = std::make_shared<Sorter<String, Int>>(std::make_unique<MQDataLoader>(out));
+  size_t n_records = 10000;
+
+  {
+    Shuffle<String, Int> shuffle(mq, conf);
+    shuffle.set_output(out);
+    shuffle.set_local_sorter(sorter);
+
+    /// Records are typed as written by Mapper
+    RecordBatch batch;
+    for (size_t i = 0; i < n_records; ++i)
+      batch.emplace_back(String{"key" + std::to_string(i % 1000)}, Int(i));
+    mq->send_batch(std::move(batch));
+    mq->end();
+    shuffle.run();
+  }
+
+  /// Records of this worker are grouped by the sorter without passing the output queue
+  auto container = sorter->run();
+  size_t n_local = 0;
+  for (auto& [key, values]: *container) {
+    REQUIRE(hash_key(key) % conf->n_groups == 0);
+    REQUIRE(values.size() == n_records / 1000);
+    n_local += values.size();
+  }
+
+  std::vector<BytePair> items;
+  read_all_data<String, Int>(shuffle_file_path(conf->tmpdir, conf->worker_rank), {1}, items);
+  REQUIRE(n_local + items.size() == n_records);
+  REQUIRE(n_local > 0);
+  REQUIRE(items.size() > 0);
+
   fs::remove_all(tmpdir);
 }
\ No newline at end of file
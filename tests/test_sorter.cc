@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <filesystem>
 #include <map>
 #include <memory>
 #include <string>
@@ -20,6 +21,8 @@ using namespace mapreduce::data;
 using namespace mapreduce::proc;
 using namespace mapreduce::type;
 
+namespace fs = std::filesystem;
+
 template <typename K, typename V>
 void test_sorter(std::vector<K>& keys, std::vector<std::vector<V>>& values) {
   /// Create input value key-value pairs
@@ -173,6 +176,108 @@ TEST_CASE("Sorter with initial data", "[sorter]") {
   }
 }
 
+/** Data loader returning items in the order of key bytes. */
+class SortedTestDataLoader : public TestDataLoader {
+ public:
+  SortedTestDataLoader(std::vector<BytePair>& input) : TestDataLoader(sort_(input)) {}
+
+  bool is_sorted() const override { return true; }
+
+ private:
+  /// Items are taken from the back
+  static std::vector<BytePair>& sort_(std::vector<BytePair>& input) {
+    std::stable_sort(input.begin(), input.end(), [](auto& lhs, auto& rhs) { return lhs.first > rhs.first; });
+    return input;
+  }
+};
+
+template <typename K, typename V>
+void test_sorter_with_sorted_data(std::vector<K>& keys,
+                                  std::vector<std::vector<V>>& values,
+                                  std::map<K, std::vector<V>>& init_data) {
+  std::vector<BytePair> inputs;
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    for (auto& val: values[i])
+      inputs.emplace_back(ByteData{K{keys[i]}}, ByteData{V{val}});
+  }
+
+  /// Initial data is merged in the order of keys
+  for (const auto& [key, vals]: init_data) {
+    auto it = std::find(keys.begin(), keys.end(), key);
+    if (it == keys.end()) {
+      keys.push_back(key);
+      values.push_back(vals);
+    } else {
+      auto idx = it - keys.begin();
+      values[idx].insert(values[idx].end(), vals.begin(), vals.end());
+    }
+  }
+
+  std::unique_ptr<DataLoader> loader =
+      std::make_unique<SortedTestDataLoader>(inputs);
+
+  Sorter<K, V> sorter(std::move(loader));
+  sorter.set_container(std::make_unique<std::map<K, std::vector<V>>>(std::move(init_data)));
+
+  std::vector<K> order;
+  std::map<K, std::vector<V>> res;
+  sorter.run([&](const K& key, const std::vector<V>& vals) {
+    order.push_back(key);
+    res.emplace(key, vals);
+  });
+
+  /// Each key is passed once in ascending order
+  REQUIRE(std::is_sorted(order.begin(), order.end()));
+  REQUIRE(std::adjacent_find(order.begin(), order.end()) == order.end());
+  REQUIRE(check_map_items(res, keys, values));
+}
+
+TEST_CASE("Sorter with sorted data", "[sorter]") {
+
+  SECTION("String/Int") {
+    std::vector<String> keys{"test", "example", "sort"};
+    std::vector<std::vector<Int>> values{
+      {1, -1, 5, 123, -6092},
+      {4500, -53, 22},
+      {-9, -444, -10207}
+    };
+
+    std::map<String, std::vector<Int>> init_data{
+      {"a", {1}},
+      {"sort", {1, 2, 10, 20}},
+      {"mapreduce", {1, 2, 10, 20}},
+      {"zoo", {3}},
+    };
+
+    test_sorter_with_sorted_data<String, Int>(keys, values, init_data);
+  }
+
+  SECTION("Int/Long with negative keys") {
+    std::vector<Int> keys{-100, 1, 10, -1};
+    std::vector<std::vector<Long>> values{
+      {1234567890, -987654321},
+      {301948990, -10240, 2},
+      {-1000},
+      {5, 6}
+    };
+
+    std::map<Int, std::vector<Long>> init_data{
+      {-50, {1000, 2000}},
+      {1, {3000}},
+    };
+
+    test_sorter_with_sorted_data<Int, Long>(keys, values, init_data);
+  }
+
+  SECTION("No initial data") {
+    std::vector<String> keys{"b", "a"};
+    std::vector<std::vector<Int>> values{{1, 2}, {3}};
+    std::map<String, std::vector<Int>> init_data;
+
+    test_sorter_with_sorted_data<String, Int>(keys, values, init_data);
+  }
+}
+
 template <typename K, typename V>
 void test_with_mqdataloader(std::vector<K>& keys, std::vector<std::vector<V>>& values) {
   assert(keys.size() == values.size());
@@ -208,4 +313,353 @@ TEST_CASE("Sorter with MQDataLoader", "[sorter][mq]") {
 
     test_with_mqdataloader<Int, Float>(keys, values);
   }
+}
+
+template <typename K, typename V>
+void test_with_typed_records(std::vector<K>& keys, std::vector<std::vector<V>>& values) {
+  assert(keys.size() == values.size());
+
+  /// Records are sent without encoding as done by TypedMQWriter
+  std::shared_ptr<MessageQueue> mq = std::make_unique<MessageQueue>();
+  RecordBatch batch;
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    for (auto& val: values[i])
+      batch.emplace_back(K{keys[i]}, V{val});
+  }
+  REQUIRE(batch.is_typed());
+  mq->send_batch(std::move(batch));
+  mq->end();
+
+  std::unique_ptr<DataLoader> loader(new MQDataLoader(mq));
+  Sorter<K, V> sorter(std::move(loader));
+  auto res = sorter.run();
+
+  REQUIRE(check_map_items(*res, keys, values));
+}
+
+TEST_CASE("Sorter with typed records", "[sorter][mq][batch]") {
+
+  SECTION("load String/Long data") {
+    std::vector<String> keys{"test", "example"};
+    std::vector<std::vector<Long>> values{{10, 20}, {100, 200, 300}};
+
+    test_with_typed_records<String, Long>(keys, values);
+  }
+
+  SECTION("load Int/Float data") {
+    std::vector<Int> keys{100, 101};
+    std::vector<std::vector<Float>> values{{1.23, -20}, {-5.0, -4.18, 437.55}};
+
+    test_with_typed_records<Int, Float>(keys, values);
+  }
+}
+template <typename K, typename V>
+void test_adding_records(std::vector<K>& keys, std::vector<std::vector<V>>& values) {
+  assert(keys.size() == values.size());
+
+  /// The first value of each key is added in a typed batch, the second in an encoded batch,
+  /// and the rest is read by the loader
+  RecordBatch typed, encoded;
+  std::shared_ptr<MessageQueue> mq = std::make_unique<MessageQueue>();
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    for (unsigned int j = 0; j < values[i].size(); ++j) {
+      if (j == 0)
+        typed.emplace_back(K{keys[i]}, V{values[i][j]});
+      else if (j == 1)
+        encoded.append(ByteData{K{keys[i]}}, ByteData{V{values[i][j]}});
+      else
+        mq->send(ByteData{K{keys[i]}}, ByteData{V{values[i][j]}});
+    }
+  }
+  mq->end();
+
+  std::unique_ptr<DataLoader> loader(new MQDataLoader(mq));
+  Sorter<K, V> sorter(std::move(loader));
+  sorter.add(typed);
+  sorter.add(encoded);
+  auto res = sorter.run();
+
+  REQUIRE(check_map_items(*res, keys, values));
+}
+
+TEST_CASE("Sorter adding records", "[sorter][batch]") {
+
+  SECTION("String/Long") {
+    std::vector<String> keys{"test", "example", "sort"};
+    std::vector<std::vector<Long>> values{{10, 20, 30}, {100, 200, 300, 400}, {-1, -2}};
+
+    test_adding_records<String, Long>(keys, values);
+  }
+
+  SECTION("Int/Float") {
+    std::vector<Int> keys{100, 101};
+    std::vector<std::vector<Float>> values{{1.23, -20, 5.5}, {-5.0, -4.18, 437.55}};
+
+    test_adding_records<Int, Float>(keys, values);
+  }
+}
+
+template <typename K, typename V>
+void test_spilling_sorter(std::vector<K>& keys, std::vector<std::vector<V>>& values, size_t max_bytes,
+                          mapreduce::Grouping grouping = mapreduce::Grouping::sort) {
+  assert(keys.size() == values.size());
+  auto dir = tmpdir / "test_sorter";
+
+  /// Odd values are sent in typed batches of a record, and even values are read by a loader of sorted items
+  std::vector<RecordBatch> batches;
+  std::vector<BytePair> sorted;
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    for (unsigned int j = 0; j < values[i].size(); ++j) {
+      if (j % 2 == 1) {
+        batches.emplace_back();
+        batches.back().emplace_back(K{keys[i]}, V{values[i][j]});
+      } else {
+        sorted.emplace_back(ByteData{K{keys[i]}}, ByteData{V{values[i][j]}});
+      }
+    }
+  }
+
+  std::shared_ptr<MessageQueue> mq = std::make_unique<MessageQueue>();
+  mq->end();
+  std::unique_ptr<DataLoader> loader(new MQDataLoader(mq));
+  Sorter<K, V> sorter(std::move(loader));
+  sorter.set_max_bytes(max_bytes, dir / "spill");
+  sorter.set_grouping(grouping);
+  sorter.add_loader(std::make_unique<SortedTestDataLoader>(sorted));
+  for (auto& batch: batches)
+    sorter.add(batch);
+  REQUIRE(fs::exists(dir / "spill-0"));
+
+  std::vector<ByteData> order;
+  std::map<K, std::vector<V>> res;
+  sorter.run([&](const K& key, const std::vector<V>& vals) {
+    order.emplace_back(K{key});
+    res.emplace(key, vals);
+  });
+
+  /// Each key is passed once in the order of key bytes, and the spill files are removed
+  REQUIRE(std::is_sorted(order.begin(), order.end()));
+  REQUIRE(std::adjacent_find(order.begin(), order.end()) == order.end());
+  REQUIRE(check_map_items(res, keys, values));
+  REQUIRE(fs::is_empty(dir));
+
+  fs::remove_all(tmpdir);
+}
+
+TEST_CASE("Sorter spilling over memory limit", "[sorter][spill]") {
+
+  SECTION("String/Long") {
+    std::vector<String> keys;
+    std::vector<std::vector<Long>> values;
+    for (int i = 0; i < 1000; ++i) {
+      keys.push_back("key" + std::to_string(i * 7919 % 1000));
+      values.push_back({i, i + 1, -i, 2 * i, 3 * i});
+    }
+
+    test_spilling_sorter<String, Long>(keys, values, 4096);
+  }
+
+  SECTION("Int/Float with negative keys") {
+    std::vector<Int> keys;
+    std::vector<std::vector<Float>> values;
+    for (int i = -500; i < 500; ++i) {
+      keys.push_back(i * 31);
+      values.push_back({i * 0.5f, 1.0f, -2.5f});
+    }
+
+    test_spilling_sorter<Int, Float>(keys, values, 1024);
+  }
+
+  SECTION("Spills more than the fan-in of merge") {
+    std::vector<Long> keys{3, -1, 100};
+    std::vector<std::vector<Int>> values(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      for (Int j = 0; j < static_cast<Int>(Sorter<Long, Int>::kMergeFanIn); ++j)
+        values[i].push_back(j);
+    }
+
+    /// Every batch is spilled
+    test_spilling_sorter<Long, Int>(keys, values, 1);
+  }
+
+  SECTION("Grouping by hash") {
+    std::vector<String> keys;
+    std::vector<std::vector<Int>> values;
+    for (int i = 0; i < 500; ++i) {
+      keys.push_back("hash" + std::to_string(i * 7919 % 500));
+      values.push_back({i, -i, 2 * i});
+    }
+
+    /// Groups by hash are merged in the order of keys once spilled
+    test_spilling_sorter<String, Int>(keys, values, 2048, mapreduce::Grouping::hash);
+  }
+
+  SECTION("Negative and positive zero keys") {
+    std::shared_ptr<MessageQueue> mq = std::make_unique<MessageQueue>();
+    mq->end();
+    std::unique_ptr<DataLoader> loader(new MQDataLoader(mq));
+    Sorter<Double, Int> sorter(std::move(loader));
+
+    /// Every batch is spilled, so that zeros are grouped by the spilled bytes
+    sorter.set_max_bytes(1, tmpdir / "test_sorter" / "spill");
+    Int i = 0;
+    for (Double key: {0.0, -0.0, 1.0, -0.0, 0.0}) {
+      RecordBatch batch;
+      batch.emplace_back(Double{key}, Int{i++});
+      sorter.add(batch);
+    }
+
+    std::vector<Double> order;
+    std::vector<size_t> counts;
+    sorter.run([&](const Double& key, const std::vector<Int>& vals) {
+      order.push_back(key);
+      counts.push_back(vals.size());
+    });
+    REQUIRE(order == std::vector<Double>{0.0, 1.0});
+    REQUIRE(counts == std::vector<size_t>{4, 1});
+
+    fs::remove_all(tmpdir);
+  }
+}
+
+template <typename K, typename V>
+void test_streaming_values(std::vector<K>& keys, std::vector<std::vector<V>>& values, size_t max_bytes,
+                           mapreduce::Grouping grouping = mapreduce::Grouping::sort) {
+  assert(keys.size() == values.size());
+  auto dir = tmpdir / "test_sorter";
+
+  /// Odd values are added in typed batches of a record, and even values are read by a loader of sorted items
+  std::vector<RecordBatch> batches;
+  std::vector<BytePair> sorted;
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    for (unsigned int j = 0; j < values[i].size(); ++j) {
+      if (j % 2 == 1) {
+        batches.emplace_back();
+        batches.back().emplace_back(K{keys[i]}, V{values[i][j]});
+      } else {
+        sorted.emplace_back(ByteData{K{keys[i]}}, ByteData{V{values[i][j]}});
+      }
+    }
+  }
+
+  std::shared_ptr<MessageQueue> mq = std::make_unique<MessageQueue>();
+  mq->end();
+  std::unique_ptr<DataLoader> loader(new MQDataLoader(mq));
+  Sorter<K, V> sorter(std::move(loader));
+  sorter.set_max_bytes(max_bytes, dir / "spill");
+  sorter.set_grouping(grouping);
+  sorter.add_loader(std::make_unique<SortedTestDataLoader>(sorted));
+  for (auto& batch: batches)
+    sorter.add(batch);
+
+  /// All values are read for every other key, and only the first value for the others
+  std::map<K, std::vector<V>> res;
+  bool read_all = false;
+  sorter.run([&](const K& key, mapreduce::ValueRange<V> range) {
+    REQUIRE(res.count(key) == 0);
+    auto& group = res[key];
+    read_all = !read_all;
+    for (auto it = range.begin(); it != range.end(); ++it) {
+      group.push_back(std::move(*it));
+      if (!read_all)
+        break;
+    }
+  });
+
+  REQUIRE(res.size() == keys.size());
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    auto& group = res[keys[i]];
+    if (group.size() == 1) {
+      REQUIRE_THAT(values[i], Catch::Matchers::VectorContains(group.front()));
+    } else {
+      REQUIRE_THAT(group, Catch::Matchers::UnorderedEquals(values[i]));
+    }
+  }
+  REQUIRE((!fs::exists(dir) || fs::is_empty(dir)));
+
+  fs::remove_all(tmpdir);
+}
+
+TEST_CASE("Sorter streaming values", "[sorter][stream]") {
+
+  SECTION("String/Long in memory") {
+    std::vector<String> keys{"test", "example", "sort", "stream"};
+    std::vector<std::vector<Long>> values{{10, 20, 30}, {100, 200, 300, 400}, {-1, -2}, {7}};
+
+    test_streaming_values<String, Long>(keys, values, 0);
+  }
+
+  SECTION("Int/Double over memory limit") {
+    std::vector<Int> keys;
+    std::vector<std::vector<Double>> values;
+    for (int i = -300; i < 300; ++i) {
+      keys.push_back(i * 13);
+      values.push_back({i * 0.25, 1.0, -2.5, i * 2.0});
+    }
+
+    /// Values are streamed from the merge of spills, groups in memory and the sorted loader
+    test_streaming_values<Int, Double>(keys, values, 1024);
+  }
+
+  SECTION("Long/Int grouped by hash") {
+    std::vector<Long> keys{1L << 40, -3, 0, 12345};
+    std::vector<std::vector<Int>> values{{1, 2, 3}, {4}, {5, 6}, {7, 8, 9, 10}};
+
+    test_streaming_values<Long, Int>(keys, values, 0, mapreduce::Grouping::hash);
+  }
+}
+
+template <typename K, typename V>
+void test_grouping_by_hash(std::vector<K>& keys, std::vector<std::vector<V>>& values) {
+  assert(keys.size() == values.size());
+
+  /// The first value of each key is added in a typed batch, the second in an encoded batch,
+  /// and the rest is read by the loader
+  RecordBatch typed, encoded;
+  std::shared_ptr<MessageQueue> mq = std::make_unique<MessageQueue>();
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    for (unsigned int j = 0; j < values[i].size(); ++j) {
+      if (j == 0)
+        typed.emplace_back(K{keys[i]}, V{values[i][j]});
+      else if (j == 1)
+        encoded.append(ByteData{K{keys[i]}}, ByteData{V{values[i][j]}});
+      else
+        mq->send(ByteData{K{keys[i]}}, ByteData{V{values[i][j]}});
+    }
+  }
+  mq->end();
+
+  std::unique_ptr<DataLoader> loader(new MQDataLoader(mq));
+  Sorter<K, V> sorter(std::move(loader));
+  sorter.set_grouping(mapreduce::Grouping::hash);
+  sorter.add(typed);
+  sorter.add(encoded);
+
+  std::vector<K> order;
+  std::map<K, std::vector<V>> res;
+  sorter.run([&](const K& key, const std::vector<V>& vals) {
+    order.push_back(key);
+    res.emplace(key, vals);
+  });
+
+  /// Keys grouped in memory are passed once in the order of first appearance
+  REQUIRE(order == keys);
+  REQUIRE(check_map_items(res, keys, values));
+}
+
+TEST_CASE("Sorter grouping by hash", "[sorter][hash]") {
+
+  SECTION("String/Long") {
+    std::vector<String> keys{"test", "example", "sort", "hash"};
+    std::vector<std::vector<Long>> values{{10, 20, 30}, {100, 200, 300, 400}, {-1, -2}, {7}};
+
+    test_grouping_by_hash<String, Long>(keys, values);
+  }
+
+  SECTION("Int/Float") {
+    std::vector<Int> keys{101, -5, 100};
+    std::vector<std::vector<Float>> values{{1.23, -20, 5.5}, {0.5}, {-5.0, -4.18, 437.55}};
+
+    test_grouping_by_hash<Int, Float>(keys, values);
+  }
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include "simplemapreduce/util/thread_pool.h"
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace mapreduce::util;
+
+TEST_CASE("ThreadPool", "[thread][util]") {
+
+  SECTION("Run all tasks") {
+    std::atomic<int> sum{0};
+    std::vector<std::future<void>> futures;
+    {
+      ThreadPool pool(4);
+      REQUIRE(pool.size() == 4);
+      for (int i = 1; i <= 100; ++i)
+        futures.push_back(pool.submit([&sum, i] { sum += i; }));
+      for (auto& future: futures)
+        future.get();
+      REQUIRE(sum == 5050);
+
+      /// Tasks left in the queue are run before the pool is destroyed
+      for (int i = 0; i < 10; ++i)
+        pool.submit([&sum] { sum += 1; });
+    }
+    REQUIRE(sum == 5060);
+  }
+
+  SECTION("Exception in a task") {
+    ThreadPool pool(0);
+    REQUIRE(pool.size() == 1);
+    auto failed = pool.submit([] { throw std::runtime_error("failed"); });
+    auto succeeded = pool.submit([] {});
+    REQUIRE_THROWS_AS(failed.get(), std::runtime_error);
+    REQUIRE_NOTHROW(succeeded.get());
+  }
+}
\ No newline at end of file
@@ -302,6 +302,46 @@ TEST_CASE("BinaryFileWriter", "[writer]") {
     REQUIRE(v.get_data<Double>() == val);
   }
 
+  SECTION("front coding") {
+    fs::path plain_path{tmpdir / "test_writer" / "binout_plain"};
+    {
+      BinaryFileWriter<String, Int> plain(plain_path);
+      BinaryFileWriter<String, Int> coded(fpath, true);
+      for (int i = 0; i < 1000; ++i) {
+        String k{"user/session/" + std::to_string(i % 50)};
+        plain.write(ByteData(String(k)), ByteData(Int{i}));
+        coded.write(ByteData(String(k)), ByteData(Int{i}));
+      }
+    }
+
+    /// Check the header is written and shared prefixes are dropped
+    std::ifstream ifs(fpath, std::ios::binary);
+    std::string magic(kSortedRunsMagicSize, '\0');
+    ifs.read(magic.data(), kSortedRunsMagicSize);
+    REQUIRE(magic == std::string(kSortedRunsMagic, kSortedRunsMagicSize));
+    REQUIRE(fs::file_size(fpath) < fs::file_size(plain_path));
+  }
+
+  SECTION("write beyond buffer size") {
+    /// Records cross several buffer flushes
+    size_t n_records = 3 * BinaryFileWriter<String, Int>::kBufferBytes / 16;
+    {
+      BinaryFileWriter<String, Int> writer(fpath);
+      for (size_t i = 0; i < n_records; ++i)
+        writer.write(ByteData{String{"key"}}, ByteData{Int(i)});
+    }
+
+    BinFileIStream fis(fpath);
+    for (size_t i = 0; i < n_records; ++i) {
+      auto k = read_binary<String>(fis.get_stream());
+      auto v = read_binary<Int32>(fis.get_stream());
+      REQUIRE(k.get_data<String>() == "key");
+      REQUIRE(v.get_data<Int32>() == static_cast<Int32>(i));
+    }
+    fis.get_stream().peek();
+    REQUIRE(fis.get_stream().eof());
+  }
+
   fs::remove_all(tmpdir);
 }
 
@@ -354,6 +394,43 @@ TEST_CASE("MQWriter", "[writer]") {
   }
 }
 
+TEST_CASE("TypedMQWriter", "[writer]") {
+  std::shared_ptr<MessageQueue> mq = std::make_shared<MessageQueue>();
+
+  SECTION("write typed records over batches") {
+    {
+      /// Batches are sent every few records
+      TypedMQWriter<String, Int> writer(mq, 32);
+      for (Int i = 0; i < 10; ++i)
+        writer.write(String("key" + std::to_string(i)), Int(i));
+
+      /// Records in bytes are mixed with typed records in a batch
+      writer.write(ByteData{String{"bytes"}}, ByteData{Int{10}});
+      writer.write(String{"typed"}, Int{11});
+    }
+    mq->end();
+
+    std::vector<std::pair<String, Int>> received;
+    while (true) {
+      auto batch = mq->receive_batch();
+      if (batch.empty())
+        break;
+      if (auto records = batch.typed<String, Int>()) {
+        received.insert(received.end(), records->begin(), records->end());
+      } else {
+        for (size_t i = 0; i < batch.size(); ++i)
+          received.emplace_back(batch.get_key<String>(i), batch.get_value<Int>(i));
+      }
+    }
+
+    REQUIRE(received.size() == 12);
+    for (Int i = 0; i < 10; ++i)
+      REQUIRE(received[i] == std::make_pair(String("key" + std::to_string(i)), Int(i)));
+    REQUIRE(received[10] == std::make_pair(String{"bytes"}, Int{10}));
+    REQUIRE(received[11] == std::make_pair(String{"typed"}, Int{11}));
+  }
+}
+
 TEST_CASE("OutputWriter", "[writer]") {
   fs::path fpath = tmpdir / "writer" / "tmpout";
   fs::create_directories(fpath.parent_path());
@@ -444,4 +521,19 @@ TEST_CASE("OutputWriter", "[writer]") {
   }
 
   fs::remove_all(tmpdir);
+}
+
+TEST_CASE("BufferWriter", "[writer]") {
+
+  SECTION("write encoded and typed String/Long") {
+    BufferWriter<String, Long> writer;
+    writer.write(ByteData{String("encoded")}, ByteData{Long(-5)});
+    writer.write(String("typed"), Long(123456789l));
+
+    /// Records are held in the order written
+    auto& records = writer.records();
+    REQUIRE(records.size() == 2);
+    REQUIRE(records[0] == std::make_pair(String("encoded"), Long(-5)));
+    REQUIRE(records[1] == std::make_pair(String("typed"), Long(123456789l)));
+  }
 }
\ No newline at end of file
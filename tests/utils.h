@@ -82,10 +82,10 @@ bool check_map_items(std::map<K, std::vector<V>>& input,
 /**
  * Read binary data and return as actual data type.
  *
- *  @param ifs  input file stream to read data
+ *  @param ifs  input stream to read data
  */
 template <typename T>
-ByteData read_binary(std::ifstream& ifs) {
+ByteData read_binary(std::istream& ifs) {
   /// Read numeric data
   ByteData bdata;
   if (std::is_arithmetic_v<T>) {